@@ -64,6 +64,11 @@ BlabbleAPI::BlabbleAPI(const FB::BrowserHostPtr& host, const PjsuaManagerPtr& ma
 	registerMethod("getLogNumber", make_method(this, &BlabbleAPI::getLogNumber));
 #endif
 	registerMethod("logSender", make_method(this, &BlabbleAPI::logSender));
+	registerMethod("logSenderIncremental", make_method(this, &BlabbleAPI::logSenderIncremental));
+	registerMethod("cancelLogSender", make_method(this, &BlabbleAPI::cancelLogSender));
+	registerMethod("getLogDropped", make_method(this, &BlabbleAPI::getLogDropped));
+	registerMethod("getCallEventStats", make_method(this, &BlabbleAPI::getCallEventStats));
+	registerMethod("getRecentLog", make_method(this, &BlabbleAPI::getRecentLog));
 	registerMethod("setCodecPriority", make_method(this, &BlabbleAPI::SetCodecPriority));
 	registerMethod("setLogPath", make_method(this, &BlabbleAPI::setLogPath));
 	registerMethod("setRingAudioDevice", make_method(this, &BlabbleAPI::setRingAudioDevice));
@@ -78,8 +83,7 @@ BlabbleAPI::BlabbleAPI(const FB::BrowserHostPtr& host, const PjsuaManagerPtr& ma
 
 BlabbleAPI::~BlabbleAPI()
 {
-	std::string str = "DEBUG:                 +++BlabbleAPI::~BlabbleAPI()+++";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("+++BlabbleAPI::~BlabbleAPI()+++");
 
 	std::vector<BlabbleAccountWeakPtr>::iterator it;
 	for (it = accounts_.begin(); it < accounts_.end(); it++) {
@@ -90,8 +94,7 @@ BlabbleAPI::~BlabbleAPI()
 	}
 	accounts_.clear();
 
-	str = "DEBUG:                 ---BlabbleAPI::~BlabbleAPI()---";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("---BlabbleAPI::~BlabbleAPI()---");
 }
 
 #if 0	// REITEK: Disabled
@@ -123,8 +126,7 @@ BlabbleAccountWeakPtr BlabbleAPI::CreateAccount(const FB::VariantMap &params)
 		{
 			account->set_use_tls(iter->second.cast<bool>());
 
-			const std::string str = "DEBUG:                 " + std::string("useTls: ") + boost::lexical_cast<std::string>(account->use_tls());
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			BLABBLE_LOG_DEBUG("useTls: " << account->use_tls());
 		}
 
 		if ((iter = params.find("identity")) != params.end() &&
@@ -325,12 +327,7 @@ void BlabbleAPI::SetVolume(FB::variant recVolume, FB::variant playVolume)
 		const float recVolumeFloat = (float)recVolumeDouble;
 		const int recVolumeInternal = (int)((recVolumeFloat - 1) * 128);
 
-		const std::string str = "INFO:                  Set recVolume (input device) - received: " +
-								printValue(recVolumeDouble) +
-								" - float: " + printValue(recVolumeFloat) +
-								" - internal: " + boost::lexical_cast<std::string>(recVolumeInternal);
-
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_INFO("Set recVolume (input device) - received: " << printValue(recVolumeDouble) << " - float: " << printValue(recVolumeFloat) << " - internal: " << recVolumeInternal);
 
 		pjsua_conf_adjust_rx_level(0, recVolumeFloat);
 	}
@@ -341,12 +338,7 @@ void BlabbleAPI::SetVolume(FB::variant recVolume, FB::variant playVolume)
 		const float playVolumeFloat = (float)playVolumeDouble;
 		const int playVolumeInternal = (int)((playVolumeFloat - 1) * 128);
 
-		const std::string str = "INFO:                  Set playVolume (playback device) - received: " +
-						printValue(playVolumeDouble) +
-						" - float: " + printValue(playVolumeFloat) +
-						" - internal: " + boost::lexical_cast<std::string>(playVolumeInternal);
-
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_INFO("Set playVolume (playback device) - received: " << printValue(playVolumeDouble) << " - float: " << printValue(playVolumeFloat) << " - internal: " << playVolumeInternal);
 
 		pjsua_conf_adjust_tx_level(0, playVolumeFloat);
 	}
@@ -379,9 +371,24 @@ void BlabbleAPI::getLogAD()
 {
 }
 
-void BlabbleAPI::writeLogAD(std::string data) 
+void BlabbleAPI::writeLogAD(const FB::variant& data) 
 {
-	BlabbleLogging::writeLogAD(data);
+	// REITEK: An array of lines is written with a single call (and queued at once)
+	if (data.is_of_type<FB::JSObjectPtr>() || data.is_of_type<FB::VariantList>())
+	{
+		const FB::VariantList list = data.convert_cast<FB::VariantList>();
+
+		std::vector<std::string> lines;
+		lines.reserve(list.size());
+
+		for (FB::VariantList::const_iterator it = list.begin(); it != list.end(); ++it)
+			lines.push_back(it->convert_cast<std::string>());
+
+		BlabbleLogging::writeLogAD(lines);
+		return;
+	}
+
+	BlabbleLogging::writeLogAD(data.convert_cast<std::string>());
 }
 
 void BlabbleAPI::setLogDimension(int dimension)
@@ -411,9 +418,89 @@ bool BlabbleAPI::setLogPath(std::string logpath)
 	return BlabbleLogging::setLogPath(logpath);
 }
 
-void BlabbleAPI::logSender(std::string url) 
+/**
+*	Build the upload notifications from the onProgress/onComplete functions passed by JS (if any)
+*/
+static BlabbleLogging::LogSenderCallbacks GetLogSenderCallbacks(const boost::optional<FB::VariantMap>& params)
+{
+	BlabbleLogging::LogSenderCallbacks callbacks;
+
+	if (!params)
+		return callbacks;
+
+	FB::VariantMap::const_iterator iter;
+
+	if ((iter = params->find("onProgress")) != params->end() &&
+		iter->second.is_of_type<FB::JSObjectPtr>())
+	{
+		const FB::JSObjectPtr onProgress = iter->second.cast<FB::JSObjectPtr>();
+
+		callbacks.onProgress = [ onProgress ] (unsigned long long sent, unsigned long long total) {
+			onProgress->InvokeAsync("", FB::variant_list_of((double)sent)((double)total));
+		};
+	}
+
+	if ((iter = params->find("onComplete")) != params->end() &&
+		iter->second.is_of_type<FB::JSObjectPtr>())
+	{
+		const FB::JSObjectPtr onComplete = iter->second.cast<FB::JSObjectPtr>();
+
+		callbacks.onComplete = [ onComplete ] (bool success, const std::string& error) {
+			onComplete->InvokeAsync("", FB::variant_list_of(success)(error));
+		};
+	}
+
+	return callbacks;
+}
+
+bool BlabbleAPI::logSender(std::string url, const boost::optional<FB::VariantMap>& params)
+{
+	return BlabbleLogging::logSender(url, GetLogSenderCallbacks(params));
+}
+
+bool BlabbleAPI::logSenderIncremental(std::string url, const boost::optional<FB::VariantMap>& params)
+{
+	return BlabbleLogging::logSenderIncremental(url, GetLogSenderCallbacks(params));
+}
+
+bool BlabbleAPI::cancelLogSender()
+{
+	return BlabbleLogging::cancelLogSender();
+}
+
+FB::VariantMap BlabbleAPI::getLogDropped()
+{
+	FB::VariantMap map;
+	map["sip"] = BlabbleLogging::getDroppedLines(BlabbleLogging::laneSIP);
+	map["ad"] = BlabbleLogging::getDroppedLines(BlabbleLogging::laneAD);
+
+	return map;
+}
+
+FB::VariantMap BlabbleAPI::getCallEventStats()
+{
+	unsigned long events, callInfo, overflowed;
+	PjsuaManager::GetCallEventStats(events, callInfo, overflowed);
+
+	FB::VariantMap map;
+	map["events"] = events;
+	map["callInfo"] = callInfo;
+	map["overflowed"] = overflowed;
+
+	return map;
+}
+
+FB::VariantList BlabbleAPI::getRecentLog(int n, const boost::optional<std::string>& filter)
 {
-	BlabbleLogging::logSender(url);
+	FB::VariantList lines;
+
+	if (n <= 0)
+		return lines;
+
+	const std::vector<std::string> recent = BlabbleLogging::getRecentLog((unsigned int)n, filter.get_value_or(""));
+	lines.assign(recent.begin(), recent.end());
+
+	return lines;
 }
 
 void BlabbleAPI::SetCodecPriority(std::string codec, int value) 
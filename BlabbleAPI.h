@@ -147,7 +147,10 @@ public:
 
 	void getLogAD();
 
-	void writeLogAD(std::string data);
+	/*! @Brief JavaScript function to write into the AD log file.
+	 *  data is either a line or an array of lines (written with a single call).
+	 */
+	void writeLogAD(const FB::variant& data);
 
 	void setLogDimension(int dimension);
 
@@ -155,7 +158,42 @@ public:
 
 	bool setLogPath(std::string logPath);
 
-	void logSender(std::string url);
+	/*! @Brief JavaScript function to upload the log files as a single zip archive (in background).
+	 *  The optional params object may contain onProgress(sent, total) and onComplete(success, error) functions.
+	 *  Returns false if another upload is running.
+	 */
+	bool logSender(std::string url, const boost::optional<FB::VariantMap>& params);
+
+	/*! @Brief JavaScript function to upload the log files not uploaded yet (each one on its own).
+	 *  Each file is PUT to url/<file name>, in 1 MB chunks with a Content-Range header;
+	 *  the list of the current files (name, size and CRC-32) is then PUT to url/manifest.
+	 *  The optional params object is the same as logSender's. Returns false if another upload is running.
+	 */
+	bool logSenderIncremental(std::string url, const boost::optional<FB::VariantMap>& params);
+
+	/*! @Brief JavaScript function to cancel the running upload (its onComplete is called with success false).
+	 *  Returns false if no upload is running.
+	 */
+	bool cancelLogSender();
+
+	/*! @Brief JavaScript function to get the number of log lines dropped because the logging queue was full.
+	 *  This function returns a JavaScript object with "sip" and "ad" properties
+	 *  (lines of the SIP and of the AD log file respectively).
+	 */
+	FB::VariantMap getLogDropped();
+
+	/*! @Brief JavaScript function to get how many PJSIP call events were handled.
+	 *  This function returns a JavaScript object with "events", "callInfo" and "overflowed" properties
+	 *  (PJSIP call callbacks, pjsua_call_get_info calls made to handle them: one per event, and events
+	 *  queued into the overflow list because the event dispatcher thread was late).
+	 */
+	FB::VariantMap getCallEventStats();
+
+	/*! @Brief JavaScript function to get the last n lines of the SIP log file (oldest first).
+	 *  If filter is passed, only the lines containing it are returned.
+	 *  Lines are kept in memory (the last 512 ones): no file is read, even while the logs are being written.
+	 */
+	FB::VariantList getRecentLog(int n, const boost::optional<std::string>& filter);
 
 	void SetCodecPriority(std::string codec, int value);
 
@@ -165,8 +165,7 @@ BlabbleAccount::~BlabbleAccount()
 
 void BlabbleAccount::Destroy()
 {
-	std::string str = "DEBUG:                 +++BlabbleAccount::Destroy()+++";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("+++BlabbleAccount::Destroy()+++");
 
 	//Verify the manager is still around by grabbing it
 	PjsuaManagerPtr manager = pjsua_manager_.lock();
@@ -178,8 +177,7 @@ void BlabbleAccount::Destroy()
 
 			const size_t numCalls = calls_.size();
 
-			str = "DEBUG:                 Iterating at most on " + boost::lexical_cast<std::string>(numCalls) + " calls";
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			BLABBLE_LOG_DEBUG("Iterating at most on " << numCalls << " calls");
 
 			size_t iterNum = 1;
 
@@ -203,8 +201,7 @@ void BlabbleAccount::Destroy()
 		manager->RemoveAccount(id_);
 	}
 
-	str = "DEBUG:                 ---BlabbleAccount::Destroy()---";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("---BlabbleAccount::Destroy()---");
 }
 
 void BlabbleAccount::Unregister()
@@ -212,17 +209,15 @@ void BlabbleAccount::Unregister()
 	pjsua_acc_set_registration(id_, PJ_FALSE);
 }
 
-bool BlabbleAccount::OnIncomingCall(pjsua_call_id call_id, pjsip_rx_data *rdata)
+BlabbleCallPtr BlabbleAccount::OnIncomingCall(pjsua_call_id call_id, const pjsua_call_info &info)
 {
 	if (ringing_call_ > 0) 
 	{
 		//We are busy ringing. Sorry.
 		pjsua_call_hangup(call_id, 486, NULL, NULL);
-		return false;
+		return BlabbleCallPtr();
 	}
 
-	pjsua_call_info info;
-	pjsua_call_get_info(call_id, &info);
 	std::string cid = std::string(info.remote_contact.ptr, info.remote_contact.slen);
 	unsigned int s, e;
 	for (s = 0; s < cid.length() && cid[s] != ':'; s++);
@@ -233,8 +228,22 @@ bool BlabbleAccount::OnIncomingCall(pjsua_call_id call_id, pjsip_rx_data *rdata)
 
 	BlabbleCallPtr call = boost::make_shared<BlabbleCall>(get_shared());
 
+	// REITEK: Only the (lock-free) dispatch table is updated on the PJSIP thread: the call is added to
+	// the account by HandleIncomingCall, on the event dispatcher thread
 	if (!call->RegisterIncomingCall(call_id))
+		return BlabbleCallPtr();
+
+	return call;
+}
+
+bool BlabbleAccount::HandleIncomingCall(pjsua_call_id call_id, unsigned int global_id, bool mustAnswerCall)
+{
+	BlabbleCallPtr call = PjsuaManager::FindCall(call_id, global_id);
+	if (!call)
+	{
+		BLABBLE_LOG_INFO("Received incoming call event for unknown PJSIP call id " << call_id << ", on PJSIP account id " << id_);
 		return false;
+	}
 
 	{
 		boost::recursive_mutex::scoped_lock lock(this->calls_mutex_);
@@ -247,9 +256,14 @@ bool BlabbleAccount::OnIncomingCall(pjsua_call_id call_id, pjsip_rx_data *rdata)
 	if (on_incoming_call_)
 		on_incoming_call_->InvokeAsync("", FB::variant_list_of(BlabbleCallWeakPtr(call))(BlabbleAccountWeakPtr(get_shared())));
 
-	if (!call->HandleIncomingCall(rdata))
+	if (!call->HandleIncomingCall(mustAnswerCall))
 	{
 		//Error occurred
+		if (call->id() == ringing_call_)
+		{
+			ringing_call_ = 0;
+		}
+
 		{
 			boost::recursive_mutex::scoped_lock lock(this->calls_mutex_);
 			calls_.remove(call);
@@ -261,22 +275,6 @@ bool BlabbleAccount::OnIncomingCall(pjsua_call_id call_id, pjsip_rx_data *rdata)
 	return true;
 }
 
-void BlabbleAccount::OnCallState(pjsua_call_id call_id, pjsip_event *e)
-{
-	BlabbleCallPtr call = FindCall(call_id);
-	if (call)
-	{
-		call->OnCallState(call_id, e);
-	} 
-	else
-	{
-		const std::string str = "Received call state change event for unknown PJSIP call id " +
-								boost::lexical_cast<std::string>(call_id) +
-								", on PJSIP account id " + boost::lexical_cast<std::string>(id_);
-		BlabbleLogging::blabbleLog(0,str.c_str(),0);
-	}
-}
-
 #if 0	// REITEK: Disabled
 bool BlabbleAccount::OnCallTransferStatus(pjsua_call_id call_id, int status)
 {
@@ -285,47 +283,13 @@ bool BlabbleAccount::OnCallTransferStatus(pjsua_call_id call_id, int status)
 	{
 		return call->OnCallTransferStatus(status);
 	}
-	const std::string str = "Received call state change event for unknown PJSIP call id " + boost::lexical_cast<std::string>(call_id)+", on PJSIP account id " + boost::lexical_cast<std::string>(id_);
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_INFO("Received call state change event for unknown PJSIP call id " << call_id << ", on PJSIP account id " << id_);
 
 	//Stop getting notifications since we don't even have this call
 	return true;
 }
 #endif
 
-void BlabbleAccount::OnCallMediaState(pjsua_call_id call_id)
-{
-	BlabbleCallPtr call = FindCall(call_id);
-	if (call)
-	{
-		call->OnCallMediaState();
-	}
-	else
-	{
-		const std::string str = "Received call state change event for unknown PJSIP call id " +
-								boost::lexical_cast<std::string>(call_id) +
-								", on PJSIP account id " + boost::lexical_cast<std::string>(id_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
-}
-
-// REITEK: Method to handle transaction state changes
-void BlabbleAccount::OnCallTsxState(pjsua_call_id call_id, pjsip_transaction *tsx, pjsip_event *e)
-{
-	BlabbleCallPtr call = FindCall(call_id);
-	if (call)
-	{
-		call->OnCallTsxState(call_id, tsx, e);
-	}
-	else
-	{
-		const std::string str = "Received call state change event for unknown PJSIP call id " +
-								boost::lexical_cast<std::string>(call_id) +
-								", on PJSIP account id " + boost::lexical_cast<std::string>(id_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
-}
-
 BlabbleCallPtr BlabbleAccount::FindCall(pjsua_call_id call_id)
 {
 	unsigned int *internalId = (unsigned int*)pjsua_call_get_user_data(call_id);
@@ -343,8 +307,7 @@ BlabbleCallPtr BlabbleAccount::FindCall(pjsua_call_id call_id)
 
 void BlabbleAccount::OnCallEnd(pjsua_call_id call_id, const BlabbleCallPtr& call)
 {
-	const std::string str = "OnCallEnd for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + ", global id " + boost::lexical_cast<std::string>(call->id());
-	BlabbleLogging::blabbleLog(0,str.c_str(),0);
+	BLABBLE_LOG_INFO("OnCallEnd for PJSIP call id " << call_id << ", global id " << call->id());
 
 	if (call->id() == ringing_call_)
 	{
@@ -355,7 +318,7 @@ void BlabbleAccount::OnCallEnd(pjsua_call_id call_id, const BlabbleCallPtr& call
 	calls_.remove(call);
 }
 
-void BlabbleAccount::OnCallRingChange(const BlabbleCallPtr& call, const pjsua_call_info& info)
+void BlabbleAccount::OnCallRingChange(const BlabbleCallPtr& call, const CallStateInfo& info)
 {
 	if (info.state == PJSIP_INV_STATE_CALLING)
 	{
@@ -98,26 +98,22 @@ public:
 	 */
 	bool registered();
 
-	/*! @Brief Called from PjsuaManager when a new incoming call arrives for this account.
+	/*! @Brief Called from PjsuaManager (on the PJSIP thread) when a new incoming call arrives for this account.
+	 *  The call is only registered into the dispatch table, and returned (NULL if it is refused): the caller keeps
+	 *  it until HandleIncomingCall adds it to this account.
 	 */
-	bool OnIncomingCall(pjsua_call_id call_id, pjsip_rx_data *rdata);
+	BlabbleCallPtr OnIncomingCall(pjsua_call_id call_id, const pjsua_call_info &info);
+
+	/*! @Brief REITEK: Called by PjsuaManager (on the event dispatcher thread) to add to this account, notify and
+	 *  ring (or auto answer) a call registered by OnIncomingCall.
+	 *  call_id is the PJSIP call id, global_id the id of the call when PJSIP notified the event.
+	 */
+	bool HandleIncomingCall(pjsua_call_id call_id, unsigned int global_id, bool mustAnswerCall);
 	
 	/*! @Brief Called by PjsuManager when the registration state of this account changes.
 	 */
 	void OnRegState();
 	
-	/*! @Brief Called by PjsuaManager when the state of a call in this account changes.
-	 */
-	void OnCallState(pjsua_call_id call_id, pjsip_event *e);
-	
-	/*! @Brief Called by PjsuaManager when the media state of a call in this account changes.
-	 */
-	void OnCallMediaState(pjsua_call_id call_id);
-
-	/*! @Brief Called by PjsuaManager when the state of a transaction within a call in this account changes.
-	*/
-	void OnCallTsxState(pjsua_call_id call_id, pjsip_transaction *tsx, pjsip_event *e);
-
 #if 0	// REITEK: Disabled
 	/*! @Brief Called by PjsuaManager when a call in this account has transfered.
 	 */
@@ -126,7 +122,7 @@ public:
 
 	/*! Brief Called by BlabbleCall when a call begins or ends ringing.
 	 */
-	void OnCallRingChange(const BlabbleCallPtr& call, const pjsua_call_info& info);
+	void OnCallRingChange(const BlabbleCallPtr& call, const CallStateInfo& info);
 	
 	/*! @Brief Called by BlabbleCall when a call is ended by this side.
 	 *  @sa OnRemoteCallEnd
@@ -95,11 +95,7 @@ BlabbleAudioManager::BlabbleAudioManager(Blabble& pluginCore) :
 
 	wav_path_ = path;
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("Audio files path: ") + wav_path_;
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Audio files path: " << wav_path_);
 
 	/**
 	*	!!! NOTE: Using XP_WIN/XP_UNIX defines could be avoided
@@ -113,11 +109,7 @@ BlabbleAudioManager::BlabbleAudioManager(Blabble& pluginCore) :
 	default_ring_file_ = wav_path_ + "/ringtone.wav";
 #endif
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("Default ring file: ") + default_ring_file_;
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Default ring file: " << default_ring_file_);
 
 	// Read optional configuration parameters
 
@@ -129,11 +121,7 @@ BlabbleAudioManager::BlabbleAudioManager(Blabble& pluginCore) :
 	{
 		ring_audio_device_ = std::stoi(*paramStr);
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " INFO:                 " + std::string("Configured custom ring audio device: ") + boost::lexical_cast<std::string>(ring_audio_device_);
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_INFO("Configured custom ring audio device: " << ring_audio_device_);
 	}
 
 	// !!! TODO: Check what happens with an invalid double value
@@ -141,22 +129,14 @@ BlabbleAudioManager::BlabbleAudioManager(Blabble& pluginCore) :
 	{
 		ring_volume_.reset(new double(std::stod(*paramStr)));
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " INFO:                 " + std::string("Configured custom ring volume: ") + boost::lexical_cast<std::string>(*ring_volume_);
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_INFO("Configured custom ring volume: " << *ring_volume_);
 	}
 
 	if (paramStr = pluginCore.getParam("ringSound"))
 	{
 		ring_file_ = *paramStr;
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " INFO:                 " + std::string("Configured custom ring file: ") + ring_file_;
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_INFO("Configured custom ring file: " << ring_file_);
 	}
 
 	try {
@@ -206,11 +186,7 @@ BlabbleAudioManager::BlabbleAudioManager(Blabble& pluginCore) :
 		if (status != PJ_SUCCESS)
 			throw std::runtime_error("Failed ring pjsua_conf_add_port");
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " INFO:                 " + std::string("ring tone slot: ") + boost::lexical_cast<std::string>(ring_slot_);
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_INFO("ring tone slot: " << ring_slot_);
 
 		// Generate "call_wait" tone
 
@@ -237,11 +213,7 @@ BlabbleAudioManager::BlabbleAudioManager(Blabble& pluginCore) :
 		if (status != PJ_SUCCESS)
 			throw std::runtime_error("Failed call_wait pjsua_conf_add_port");
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " INFO:                 " + std::string("call_wait tone slot: ") + boost::lexical_cast<std::string>(call_wait_slot_);
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_INFO("call_wait tone slot: " << call_wait_slot_);
 
 		// Apply ring configuration
 		ApplyRingSound();
@@ -260,11 +232,7 @@ BlabbleAudioManager::~BlabbleAudioManager()
 
 void BlabbleAudioManager::StopRings()
 {
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("StopRings");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("StopRings");
 
 	pjsua_conf_disconnect(ring_slot_, 0);
 	pjmedia_tonegen_rewind(ring_port_);
@@ -299,11 +267,7 @@ void BlabbleAudioManager::StartOutRing()
 
 void BlabbleAudioManager::StartInRing()
 {
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("StartInRing");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("StartInRing");
 
 	// Stop playing the wav file not related to a call
 	StopWav();
@@ -324,35 +288,23 @@ void BlabbleAudioManager::StartInRing()
 				// Change the audio devices only if necessary
 				if (!CompareCurrentAudioDevices(old_capture_dev_, ring_audio_device_))
 				{
-					{
-						// !!! UGLY (should automatically conform to pjsip formatting)
-						const std::string str = "DEBUG:                 " + std::string("pjsua_set_snd_dev");
-						BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-					}
+					BLABBLE_LOG_DEBUG("pjsua_set_snd_dev");
 
 					// !!! CHECK: Do not change the capture device
 					const pj_status_t status = pjsua_set_snd_dev(old_capture_dev_, ring_audio_device_);
 					if (status != PJ_SUCCESS)
 					{
-						// !!! UGLY (should automatically conform to pjsip formatting)
-						const std::string str = " ERROR:                Could not change audio device before ring playback";
-						BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+						BLABBLE_LOG_ERROR("Could not change audio device before ring playback");
 					}
 					else
 					{
-						// !!! UGLY (should automatically conform to pjsip formatting)
-						const std::string str = " INFO:                 " +
-							std::string("Set audio device to ") +
-							boost::lexical_cast<std::string>(ring_audio_device_);
-						BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+						BLABBLE_LOG_INFO("Set audio device to " << ring_audio_device_);
 					}
 				}
 			}
 			else
 			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " ERROR:                Could not save current audio device information: unable to change the audio device for ring playback";
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+				BLABBLE_LOG_ERROR("Could not save current audio device information: unable to change the audio device for ring playback");
 			}
 		}
 
@@ -364,16 +316,12 @@ void BlabbleAudioManager::StartInRing()
 				const pj_status_t status = pjsua_conf_adjust_tx_level(0, (float)playbackVolume);
 				if (status != PJ_SUCCESS)
 				{
-					// !!! UGLY (should automatically conform to pjsip formatting)
-					const std::string str = " ERROR:                Could not change audio volume before ring playback";
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+					BLABBLE_LOG_ERROR("Could not change audio volume before ring playback");
 				}
 			}
 			else
 			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " ERROR:                Could not get current audio volume before ring playback";
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+				BLABBLE_LOG_ERROR("Could not get current audio volume before ring playback");
 			}
 		}
 
@@ -388,11 +336,7 @@ void BlabbleAudioManager::StartInRing()
 */
 static pj_status_t on_playwav_done(pjmedia_port *port, void *usr_data)
 {
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = "DEBUG:                 " + std::string("on_playwav_done callback function");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_DEBUG("on_playwav_done callback function");
 
 	if (usr_data != NULL)
 	{
@@ -401,9 +345,7 @@ static pj_status_t on_playwav_done(pjmedia_port *port, void *usr_data)
 	}
 	else
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " ERROR:                NULL usr_data passed to on_playwav_done callback function";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("NULL usr_data passed to on_playwav_done callback function");
 	}
 
 	/*
@@ -417,20 +359,12 @@ static pj_status_t on_playwav_done(pjmedia_port *port, void *usr_data)
 
 bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 {
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("PlayWav");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("PlayWav");
 
 #if 0	// !!! NOTE: Allow it also during a call
 	if (pjsua_call_get_count() > 0)
 	{
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " WARNING:              " + std::string("At least one call is already active, playWav cannot be started");
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_WARN("At least one call is already active, playWav cannot be started");
 
 		return false;
 	}
@@ -443,13 +377,7 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 	FB::VariantMap::const_iterator iter = playWavParams.find("fileName");
 	if (iter == playWavParams.end() || !iter->second.can_be_type<std::string>())
 	{
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " ERROR:                " +
-				std::string("fileName not specified or not a string");
-
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_ERROR("fileName not specified or not a string");
 
 		return false;
 	}
@@ -459,13 +387,7 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 
 		if (fileName.empty())
 		{
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " ERROR:                " +
-					std::string("Empty fileName specified");
-
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_ERROR("Empty fileName specified");
 
 			return false;
 		}
@@ -482,14 +404,7 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 		{
 			const std::type_info& type = iter->second.get_type();
 
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " WARNING:              " +
-					std::string("Specified audioDevice value cannot be read from a ") +
-					std::string(type.name());
-
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_WARN("Specified audioDevice value cannot be read from a " << type.name());
 		}
 	}
 
@@ -504,14 +419,7 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 		{
 			const std::type_info& type = iter->second.get_type();
 
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " WARNING:              " +
-					std::string("Specified volume value cannot be read from a ") +
-					std::string(type.name());
-
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_WARN("Specified volume value cannot be read from a " << type.name());
 		}
 	}
 
@@ -529,24 +437,13 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 		{
 			const std::type_info& type = iter->second.get_type();
 
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " WARNING:              " +
-					std::string("Specified loop value cannot be read from a ") +
-					std::string(type.name());
-
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_WARN("Specified loop value cannot be read from a " << type.name());
 
 		}
 	}
 //#endif
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("loop: ") + boost::lexical_cast<std::string>(loop);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("loop: " << loop);
 
 #if 0	// REITEK: Allow relative/absolute paths
 	std::string path = 
@@ -587,11 +484,7 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 				RestoreAudioVolume();
 			}
 
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = "DEBUG:                 " + std::string("pjsua_player_set_pos");
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_DEBUG("pjsua_player_set_pos");
 
 			pjsua_player_set_pos(wav_player_, 0);
 		}
@@ -601,11 +494,7 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 	{
 		if (wav_player_ > -1)
 		{
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = "DEBUG:                 " + std::string("pjsua_player_destroy");
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_DEBUG("pjsua_player_destroy");
 
 			pjsua_player_destroy(wav_player_);
 
@@ -615,11 +504,7 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 
 		pj_str_t wav_file = pj_str(const_cast<char*>(wav_file_to_use.c_str()));
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = "DEBUG:                 " + std::string("pjsua_player_create");
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_DEBUG("pjsua_player_create");
 
 		if (pjsua_player_create(&wav_file, loop ? 0 : PJMEDIA_FILE_NO_LOOP, &wav_player_) != PJ_SUCCESS)
 		{
@@ -656,35 +541,23 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 			// Change the audio devices only if necessary
 			if (!CompareCurrentAudioDevices(old_capture_dev_, audioDevice))
 			{
-				{
-					// !!! UGLY (should automatically conform to pjsip formatting)
-					const std::string str = "DEBUG:                 " + std::string("pjsua_set_snd_dev");
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-				}
+				BLABBLE_LOG_DEBUG("pjsua_set_snd_dev");
 
 				// !!! CHECK: Do not change the capture device
 				const pj_status_t status = pjsua_set_snd_dev(old_capture_dev_, audioDevice);
 				if (status != PJ_SUCCESS)
 				{
-					// !!! UGLY (should automatically conform to pjsip formatting)
-					const std::string str = " ERROR:                Could not change audio device before wav playback";
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+					BLABBLE_LOG_ERROR("Could not change audio device before wav playback");
 				}
 				else
 				{
-					// !!! UGLY (should automatically conform to pjsip formatting)
-					const std::string str = " INFO:                 " +
-						std::string("Set audio device to ") +
-						boost::lexical_cast<std::string>(audioDevice);
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+					BLABBLE_LOG_INFO("Set audio device to " << audioDevice);
 				}
 			}
 		}
 		else
 		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " ERROR:                Could not save current audio device information: unable to change the audio device for wav playback";
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			BLABBLE_LOG_ERROR("Could not save current audio device information: unable to change the audio device for wav playback");
 		}
 	}
 
@@ -694,52 +567,34 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 		{
 			const double playbackVolume = *volume;
 
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = "DEBUG:                 " + std::string("pjsua_conf_adjust_tx_level");
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_DEBUG("pjsua_conf_adjust_tx_level");
 
 			const pj_status_t status = pjsua_conf_adjust_tx_level(0, (float)playbackVolume);
 			if (status != PJ_SUCCESS)
 			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " ERROR:                Could not change audio volume before wav playback";
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+				BLABBLE_LOG_ERROR("Could not change audio volume before wav playback");
 			}
 			else
 			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " INFO:                 " +
-					std::string("Set audio volume to ") +
-					boost::lexical_cast<std::string>(playbackVolume);
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+				BLABBLE_LOG_INFO("Set audio volume to " << playbackVolume);
 			}
 		}
 		else
 		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " ERROR:                Could not get current audio volume before wav playback";
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			BLABBLE_LOG_ERROR("Could not get current audio volume before wav playback");
 		}
 	}
 
 	// Always reconnect the wav player to the conference (it is disconnected when stopped)
 
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = "DEBUG:                 " + std::string("pjsua_conf_connect");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("pjsua_conf_connect");
 	}
 
 	// !!! TODO: Error checking !!!
 	pjsua_conf_connect(wav_slot_, 0);
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("PlayWav done");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("PlayWav done");
 
 	used_play_file_ = wav_file_to_use;
 	used_play_loop_ = loop;
@@ -749,19 +604,11 @@ bool BlabbleAudioManager::PlayWav(FB::VariantMap playWavParams)
 
 void BlabbleAudioManager::StopWav()
 {
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("StopWav");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("StopWav");
 
 	if (wav_player_ > -1) 
 	{
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = "DEBUG:                 " + std::string("pjsua_conf_disconnect");
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_DEBUG("pjsua_conf_disconnect");
 
 		pjsua_conf_disconnect(wav_slot_, 0);
 
@@ -780,20 +627,12 @@ void BlabbleAudioManager::StopWav()
 		}
 	}
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("StopWav done");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("StopWav done");
 }
 
 void BlabbleAudioManager::OnWavStopped()
 {
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = "DEBUG:                 " + std::string("OnWavStopped");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_DEBUG("OnWavStopped");
 
 	boost::shared_ptr<BlabbleAudioManager> audiomanagerptr = shared_from_this();
 	pluginCore_.getHost()->ScheduleOnMainThread(audiomanagerptr, boost::bind(&BlabbleAudioManager::StopWav, audiomanagerptr));
@@ -845,11 +684,7 @@ void BlabbleAudioManager::ApplyRingSound()
 				in_ring_slot_ = slot_id;
 				used_ring_file_ = ring_file_to_use;
 
-				{
-					// !!! UGLY (should automatically conform to pjsip formatting)
-					const std::string str = " INFO:                 " + std::string("Using custom ring file ") + used_ring_file_ + std::string(" on slot ") + boost::lexical_cast<std::string>(in_ring_slot_);
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-				}
+				BLABBLE_LOG_INFO("Using custom ring file " << used_ring_file_ << " on slot " << in_ring_slot_);
 
 				return;
 			}
@@ -893,11 +728,7 @@ void BlabbleAudioManager::ApplyRingSound()
 			in_ring_slot_ = slot_id;
 			used_ring_file_ = default_ring_file_;
 
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " INFO:                 " + std::string("Using default ring file ") + used_ring_file_ + std::string(" on slot ") + boost::lexical_cast<std::string>(in_ring_slot_);
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_INFO("Using default ring file " << used_ring_file_ << " on slot " << in_ring_slot_);
 
 			return;
 		}
@@ -933,11 +764,7 @@ void BlabbleAudioManager::ApplyRingSound()
 
 	using_inring_tone_ = true;
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " WARNING:          " + std::string("Using internal inring tone on slot ") + boost::lexical_cast<std::string>(in_ring_slot_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_WARN("Using internal inring tone on slot " << in_ring_slot_);
 }
 
 /*! @Brief Save the current audio device in order to be able restore it later
@@ -946,9 +773,7 @@ bool BlabbleAudioManager::SaveAudioDevice()
 {
 	if (old_playback_dev_ > -1)
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " ERROR:            Current audio device already saved";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("Current audio device already saved");
 
 		return false;
 	}
@@ -958,9 +783,7 @@ bool BlabbleAudioManager::SaveAudioDevice()
 	const pj_status_t status = pjsua_get_snd_dev(&captureId, &playbackId);
 	if (status != PJ_SUCCESS)
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " ERROR:            Could not get current audio device";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("Could not get current audio device");
 
 		return false;
 	}
@@ -968,11 +791,7 @@ bool BlabbleAudioManager::SaveAudioDevice()
 	old_capture_dev_ = captureId;
 	old_playback_dev_ = playbackId;
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 Saved current audio device (" + boost::lexical_cast<std::string>(old_playback_dev_) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Saved current audio device (" << old_playback_dev_ << ")");
 
 	return true;
 }
@@ -983,9 +802,7 @@ bool BlabbleAudioManager::SaveAudioVolume()
 {
 	if (old_playback_volume_.get())
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " ERROR:            Current audio volume already saved";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("Current audio volume already saved");
 
 		return false;
 	}
@@ -994,20 +811,14 @@ bool BlabbleAudioManager::SaveAudioVolume()
 	const pj_status_t status = pjsua_conf_get_port_info(0, &info);
 	if (status != PJ_SUCCESS)
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " ERROR:            Could not get current audio volume";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("Could not get current audio volume");
 
 		return false;
 	}
 
 	old_playback_volume_.reset(new double(info.tx_level_adj));
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 Saved current audio volume (" + boost::lexical_cast<std::string>(info.tx_level_adj) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Saved current audio volume (" << info.tx_level_adj << ")");
 
 	return true;
 }
@@ -1018,9 +829,7 @@ bool BlabbleAudioManager::RestoreAudioDevice()
 {
 	if (old_playback_dev_ == -1)
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " ERROR:            Current audio device not saved";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("Current audio device not saved");
 
 		return false;
 	}
@@ -1028,29 +837,19 @@ bool BlabbleAudioManager::RestoreAudioDevice()
 	// Change the audio devices only if necessary
 	if (!CompareCurrentAudioDevices(old_capture_dev_, old_playback_dev_))
 	{
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = "DEBUG:                 " + std::string("pjsua_set_snd_dev");
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_DEBUG("pjsua_set_snd_dev");
 
 		// !!! CHECK: Do not change the capture device
 		const pj_status_t status = pjsua_set_snd_dev(old_capture_dev_, old_playback_dev_);
 		if (status != PJ_SUCCESS)
 		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " ERROR:            Could not restore the saved audio device";
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			BLABBLE_LOG_ERROR("Could not restore the saved audio device");
 
 			return false;
 		}
 	}
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 Restored the saved audio device (" + boost::lexical_cast<std::string>(old_playback_dev_)+")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Restored the saved audio device (" << old_playback_dev_ << ")");
 
 	old_playback_dev_ = -1;
 
@@ -1063,38 +862,26 @@ bool BlabbleAudioManager::RestoreAudioVolume()
 {
 	if (!old_playback_volume_.get())
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " ERROR:            Current audio volume not saved";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("Current audio volume not saved");
 
 		return false;
 	}
 
 	const double oldPlaybackVolume = *old_playback_volume_;
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = "DEBUG:                 " + std::string("pjsua_conf_adjust_tx_level");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_DEBUG("pjsua_conf_adjust_tx_level");
 
 	const pj_status_t status = pjsua_conf_adjust_tx_level(0, (float)oldPlaybackVolume);
 	if (status != PJ_SUCCESS)
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " ERROR:            Could not restore the saved audio volume";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("Could not restore the saved audio volume");
 
 		return false;
 	}
 
 	old_playback_volume_.reset(NULL);
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 Restored the saved audio volume (" + boost::lexical_cast<std::string>(oldPlaybackVolume)+")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Restored the saved audio volume (" << oldPlaybackVolume << ")");
 
 	return true;
 }
@@ -1109,14 +896,7 @@ bool BlabbleAudioManager::SetRingAudioDevice(FB::variant deviceId)
 		{
 			const std::type_info& type = deviceId.get_type();
 
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " WARNING:              " +
-					std::string("Specified deviceId value cannot be read from a ") +
-					std::string(type.name());
-
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_WARN("Specified deviceId value cannot be read from a " << type.name());
 		}
 		else
 		{
@@ -1128,11 +908,7 @@ bool BlabbleAudioManager::SetRingAudioDevice(FB::variant deviceId)
 	{
 		ring_audio_device_ = deviceIdToSet;
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " INFO:                 " + std::string("Set custom ring audio device: ") + boost::lexical_cast<std::string>(ring_audio_device_);
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_INFO("Set custom ring audio device: " << ring_audio_device_);
 
 		return true;
 	}
@@ -1141,11 +917,7 @@ bool BlabbleAudioManager::SetRingAudioDevice(FB::variant deviceId)
 
 	ring_audio_device_ = -1;
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("Set default ring audio device");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Set default ring audio device");
 
 	return true;
 }
@@ -1163,11 +935,7 @@ bool BlabbleAudioManager::SetRingVolume(FB::variant volume)
 
 		ring_volume_.reset(new double(volumeDouble));
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " INFO:                 " + std::string("Set custom ring volume: ") + boost::lexical_cast<std::string>(*ring_volume_);
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_INFO("Set custom ring volume: " << *ring_volume_);
 
 		return true;
 	}
@@ -1175,26 +943,14 @@ bool BlabbleAudioManager::SetRingVolume(FB::variant volume)
 	{
 		const std::type_info& type = volume.get_type();
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " WARNING:              " +
-				std::string("Unhandled type ") +
-				std::string(type.name()) +
-				std::string(" for Set custom ring volume");
-
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_WARN("Unhandled type " << type.name() << " for Set custom ring volume");
 	}
 
 	// Invalid type passed: restore the default ring volume
 
 	ring_volume_.reset();
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("Set default ring volume");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Set default ring volume");
 
 	return true;
 }
@@ -1223,11 +979,7 @@ bool BlabbleAudioManager::SetRingSound(FB::variant filePath)
 		{
 			ring_file_ = filePathStr;
 
-			{
-				// !!! UGLY (should automatically conform to pjsip formatting)
-				const std::string str = " INFO:                 " + std::string("Set custom ring sound: ") + ring_file_;
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-			}
+			BLABBLE_LOG_INFO("Set custom ring sound: " << ring_file_);
 
 			return true;
 		}
@@ -1236,26 +988,14 @@ bool BlabbleAudioManager::SetRingSound(FB::variant filePath)
 	{
 		const std::type_info& type = filePath.get_type();
 
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " WARNING:              " +
-				std::string("Unhandled type ") +
-				std::string(type.name()) +
-				std::string(" for Set custom ring sound");
-
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_WARN("Unhandled type " << type.name() << " for Set custom ring sound");
 	}
 
 	// Invalid type or empty value passed: restore the default ring file
 
 	ring_file_.clear();
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("Set default ring sound: ") + default_ring_file_;
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Set default ring sound: " << default_ring_file_);
 
 	return true;
 }
@@ -27,8 +27,7 @@ Copyright 2012 Andrew Ofisher
 /* OPTIONS keep-alive timer callback */
 static void options_ka_timer(pj_timer_heap_t *th, pj_timer_entry *e)
 {
-	const std::string str = "OPTIONS keep-alive timer callback (user_data: " + boost::lexical_cast<std::string>(e->user_data) + ")";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_TRACE("OPTIONS keep-alive timer callback (user_data: " << e->user_data << ")");
 
 	BlabbleCall * call = (BlabbleCall *) e->user_data;
 
@@ -38,8 +37,7 @@ static void options_ka_timer(pj_timer_heap_t *th, pj_timer_entry *e)
 /* Periodic event timer callback */
 static void periodic_event_timer(pj_timer_heap_t *th, pj_timer_entry *e)
 {
-	const std::string str = "Periodic event timer callback (user_data: " + boost::lexical_cast<std::string>(e->user_data) + ")";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_TRACE("Periodic event timer callback (user_data: " << e->user_data << ")");
 
 	BlabbleCall * call = (BlabbleCall *) e->user_data;
 
@@ -49,8 +47,7 @@ static void periodic_event_timer(pj_timer_heap_t *th, pj_timer_entry *e)
 /* answer timer callback */
 static void answer_timer(pj_timer_heap_t *th, pj_timer_entry *e)
 {
-	const std::string str = "Answer timer callback (user_data: " + boost::lexical_cast<std::string>(e->user_data) + ")";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_TRACE("Answer timer callback (user_data: " << e->user_data << ")");
 
 	BlabbleCall * call = (BlabbleCall *) e->user_data;
 
@@ -67,7 +64,7 @@ unsigned int BlabbleCall::GetNextId()
 }
 
 BlabbleCall::BlabbleCall(const BlabbleAccountPtr& parent_account)
-	: call_id_(INVALID_CALL), ringing_(false), firstconfirmedstate_(true)
+	: call_id_(INVALID_CALL), ringing_(false), firstconfirmedstate_(true), media_active_(0), table_entry_(NULL)
 {
 	if (parent_account) 
 	{
@@ -88,19 +85,13 @@ BlabbleCall::BlabbleCall(const BlabbleAccountPtr& parent_account)
 	
 	id_ = BlabbleCall::GetNextId();
 
-	{
-		const std::string str = "Created new call with global id " + boost::lexical_cast<std::string>(id_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Created new call with global id " << id_);
 
 	pj_timer_entry_init(&options_ka_timer_, 0, (void *)this, &options_ka_timer);
 	pj_timer_entry_init(&periodic_event_timer_, 1, (void *)this, &periodic_event_timer);
 	pj_timer_entry_init(&answer_timer_, 2, (void *)this, &answer_timer);
 
-	{
-		const std::string str = "Set OPTIONS keep-alive user_data: " + boost::lexical_cast<std::string>(this);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_DEBUG("Set OPTIONS keep-alive user_data: " << this);
 
 	registerMethod("answer", make_method(this, &BlabbleCall::Answer));
 	registerMethod("hangup", make_method(this, &BlabbleCall::LocalEnd));
@@ -157,22 +148,26 @@ void BlabbleCall::StartOutRinging()
 //Ended by us
 void BlabbleCall::LocalEnd()
 {
-	std::string str = "DEBUG:                 +++BlabbleCall::LocalEnd(global id " + boost::lexical_cast<std::string>(id_) + ")+++";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("+++BlabbleCall::LocalEnd(global id " << id_ << ")+++");
 
 	pjsua_call_id old_id = INTERLOCKED_EXCHANGE((volatile long *)&call_id_, (long)INVALID_CALL);
 	if (old_id == INVALID_CALL || 
 		old_id < 0 || old_id >= (long)pjsua_call_get_max_count())
 	{
-		str = "DEBUG:                 old_id not valid: ignored";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("old_id not valid: ignored");
 
-		str = "DEBUG:                 ---BlabbleCall::LocalEnd(global id " + boost::lexical_cast<std::string>(id_) + ")---";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("---BlabbleCall::LocalEnd(global id " << id_ << ")---");
 
 		return;
 	}
 
+	// REITEK: A PJSIP call id reused by a new call must be left alone
+	const bool owned = OwnsCallId(old_id);
+
+	// REITEK: PJSIP events are not dispatched to this call anymore
+	PjsuaManager::UnregisterCall(old_id, table_entry_);
+	table_entry_ = NULL;
+
 	StopOptionsKATimer(old_id);
 
 	StopPeriodicEventTimer(old_id);
@@ -181,21 +176,25 @@ void BlabbleCall::LocalEnd()
 
 	StopRinging();
 
-	pjsua_call_info info;
-	if (pjsua_call_get_info(old_id, &info) == PJ_SUCCESS &&
-		info.conf_slot > 0) 
+	SetMediaActive(false);
+
+	if (owned)
 	{
-		//Kill the audio
-		pjsua_conf_disconnect(info.conf_slot, 0);
-		pjsua_conf_disconnect(0, info.conf_slot);
-	}
+		pjsua_call_info info;
+		if (pjsua_call_get_info(old_id, &info) == PJ_SUCCESS &&
+			info.conf_slot > 0) 
+		{
+			//Kill the audio
+			pjsua_conf_disconnect(info.conf_slot, 0);
+			pjsua_conf_disconnect(0, info.conf_slot);
+		}
 
-	pjsua_call_hangup(old_id, 0, NULL, NULL);
+		pjsua_call_hangup(old_id, 0, NULL, NULL);
+	}
 
 	if (on_call_end_)
 	{
-		str = "Scheduling execution of onCallEnd handler for PJSIP call id " + boost::lexical_cast<std::string>(old_id);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_INFO("Scheduling execution of onCallEnd handler for PJSIP call id " << old_id);
 
 		BlabbleCallPtr call = get_shared();
 
@@ -213,23 +212,16 @@ void BlabbleCall::LocalEnd()
 			p->OnCallEnd(old_id, get_shared());
 	}
 
-	str = "DEBUG:                 ---BlabbleCall::LocalEnd(global id " + boost::lexical_cast<std::string>(id_) + ")---";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("---BlabbleCall::LocalEnd(global id " << id_ << ")---");
 }
 
 void BlabbleCall::CallOnCallEnd(pjsua_call_id call_id, pjsip_status_code status)
 {
-	{
-		const std::string str = "Executing onCallEnd handler for PJSIP call id " + boost::lexical_cast<std::string>(call_id);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Executing onCallEnd handler for PJSIP call id " << call_id);
 
 	on_call_end_->Invoke("", FB::variant_list_of(BlabbleCallWeakPtr(get_shared()))(status));
 
-	{
-		const std::string str = "Executed onCallEnd handler for PJSIP call id " + boost::lexical_cast<std::string>(call_id);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("Executed onCallEnd handler for PJSIP call id " << call_id);
 
 	BlabbleAccountPtr p = parent_.lock();
 	if (p)
@@ -251,24 +243,28 @@ void BlabbleCall::CallOnTransferStatus(int status)
 #endif
 
 //Ended by remote, could be becuase of an error
-void BlabbleCall::RemoteEnd(const pjsua_call_info &info)
+void BlabbleCall::RemoteEnd(const CallStateInfo &info)
 {
-	std::string str = "DEBUG:                 +++BlabbleCall::RemoteEnd(global id " + boost::lexical_cast<std::string>(id_) + ")+++";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("+++BlabbleCall::RemoteEnd(global id " << id_ << ")+++");
 
 	pjsua_call_id old_id = INTERLOCKED_EXCHANGE((volatile long *)&call_id_, (long)INVALID_CALL);
 	if (old_id == INVALID_CALL || 
 		old_id < 0 || old_id >= (long)pjsua_call_get_max_count())
 	{
-		str = "DEBUG:                 old_id not valid: ignored";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("old_id not valid: ignored");
 
-		str = "DEBUG:                 ---BlabbleCall::RemoteEnd(global id " + boost::lexical_cast<std::string>(id_) + ")---";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("---BlabbleCall::RemoteEnd(global id " << id_ << ")---");
 
 		return;
 	}
 
+	// REITEK: A PJSIP call id reused by a new call must be left alone
+	const bool owned = OwnsCallId(old_id);
+
+	// REITEK: PJSIP events are not dispatched to this call anymore
+	PjsuaManager::UnregisterCall(old_id, table_entry_);
+	table_entry_ = NULL;
+
 	StopOptionsKATimer(old_id);
 
 	StopPeriodicEventTimer(old_id);
@@ -277,19 +273,27 @@ void BlabbleCall::RemoteEnd(const pjsua_call_info &info)
 
 	StopRinging();
 
-	//Kill the audio
-	if (info.conf_slot > 0) 
+	SetMediaActive(false);
+
+	/**
+	*	REITEK: A disconnected call has no audio and must not be hung up: the event is handled by the
+	*	event dispatcher thread, and by now PJSIP may have reused the call id for another call
+	*/
+	if (owned && info.state != PJSIP_INV_STATE_DISCONNECTED)
 	{
-		pjsua_conf_disconnect(info.conf_slot, 0);
-		pjsua_conf_disconnect(0, info.conf_slot);
-	}
+		//Kill the audio
+		if (info.conf_slot > 0) 
+		{
+			pjsua_conf_disconnect(info.conf_slot, 0);
+			pjsua_conf_disconnect(0, info.conf_slot);
+		}
 
-	pjsua_call_hangup(old_id, 0, NULL, NULL);
+		pjsua_call_hangup(old_id, 0, NULL, NULL);
+	}
 
 	if (on_call_end_)
 	{
-		const std::string str = "Scheduling execution of onCallEnd handler for PJSIP call id " + boost::lexical_cast<std::string>(old_id);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_INFO("Scheduling execution of onCallEnd handler for PJSIP call id " << old_id);
 
 		BlabbleCallPtr call = get_shared();
 		on_call_end_->getHost()->ScheduleOnMainThread(call, std::bind(&BlabbleCall::CallOnCallEnd, call, old_id, info.last_status));
@@ -303,14 +307,12 @@ void BlabbleCall::RemoteEnd(const pjsua_call_info &info)
 			p->OnCallEnd(old_id, get_shared());
 	}
 
-	str = "DEBUG:                 ---BlabbleCall::RemoteEnd(global id " + boost::lexical_cast<std::string>(id_) + ")---";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("---BlabbleCall::RemoteEnd(global id " << id_ << ")---");
 }
 
 BlabbleCall::~BlabbleCall(void)
 {
-	const std::string str = "Call with global id " + boost::lexical_cast<std::string>(id_) + " deleted";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_INFO("Call with global id " << id_ << " deleted");
 	on_call_end_.reset();
 	LocalEnd();
 }
@@ -326,36 +328,31 @@ bool BlabbleCall::RegisterIncomingCall(pjsua_call_id call_id)
 	{
 		call_id_ = call_id;
 		pjsua_call_set_user_data(call_id, &id_);
-		const std::string str = "PJSIP call id " + boost::lexical_cast<std::string>(call_id)+" associated to call with global id " + boost::lexical_cast<std::string>(id_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		table_entry_ = PjsuaManager::RegisterCall(call_id, get_shared());
+		BLABBLE_LOG_INFO("PJSIP call id " << call_id << " associated to call with global id " << id_);
 
 		return true;
 	}
-	const std::string str = "RegisterIncomingCall called on call with global id " + boost::lexical_cast<std::string>(id_)+" already associated to a PJSIP call, or invalid PJSIP call id specified";
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_INFO("RegisterIncomingCall called on call with global id " << id_ << " already associated to a PJSIP call, or invalid PJSIP call id specified");
 
 	return false;
 }
 
-bool BlabbleCall::HandleIncomingCall(pjsip_rx_data *rdata)
+/**
+*	REITEK: The call events are handled by the event dispatcher thread, after PJSIP queued them: a call
+*	whose disconnection is still queued keeps its PJSIP call id, which PJSIP may have given to a new call.
+*	The new call replaces this one in the dispatch table (OnIncomingCall registers it before queuing any
+*	of its events), so the id must be checked right before each pjsua_call_* call made with it.
+*	!!! NOTE: Between the check and the pjsua_call_* call PJSIP would have to both end this call and
+*	accept a new one with the same id (it hands out the ids of the ended calls in round robin)
+*/
+bool BlabbleCall::OwnsCallId(pjsua_call_id call_id) const
 {
-	BlabbleAccountPtr p = parent_.lock();
-	if (!p)
-		return false;
-
-	if (call_id_ == INVALID_CALL)
-	{
-		const std::string str = "HandleIncomingCall called on call with global id " + boost::lexical_cast<std::string>(id_)+" not associated to a PJSIP call";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-
-		return false;
-	}
-
-	// Start the periodic event timer
-	StartPeriodicEventTimer();
-
-	bool mustAnswerCall	= false;
+	return PjsuaManager::IsRegisteredCall(call_id, table_entry_);
+}
 
+bool BlabbleCall::MustAnswerCall(pjsip_rx_data *rdata)
+{
 	if (rdata != NULL)
 	{
 		const pj_str_t hdrName = { "Call-Info", 9 };
@@ -372,17 +369,42 @@ bool BlabbleCall::HandleIncomingCall(pjsip_rx_data *rdata)
 				const int timeout = atoi(pos);
 				if (timeout == 0)
 				{
-					const std::string str = "PJSIP call id " + boost::lexical_cast<std::string>(call_id_) + ": auto answer header found";
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-
-					mustAnswerCall = true;
+					return true;
 				}
 			}
 		}
 	}
 
+	return false;
+}
+
+bool BlabbleCall::HandleIncomingCall(bool mustAnswerCall)
+{
+	BlabbleAccountPtr p = parent_.lock();
+	if (!p)
+		return false;
+
+	if (call_id_ == INVALID_CALL)
+	{
+		BLABBLE_LOG_INFO("HandleIncomingCall called on call with global id " << id_ << " not associated to a PJSIP call");
+
+		return false;
+	}
+
+	if (!OwnsCallId(call_id_))
+	{
+		BLABBLE_LOG_INFO("HandleIncomingCall called on call with global id " << id_ << " whose PJSIP call id " << call_id_ << " was reused by a new call");
+
+		return false;
+	}
+
+	// Start the periodic event timer
+	StartPeriodicEventTimer();
+
 	if (mustAnswerCall)
 	{
+		BLABBLE_LOG_INFO("PJSIP call id " << call_id_ << ": auto answer header found");
+
 		pjsua_call_answer(call_id_, 180, NULL, NULL);
 
 		//StartInRinging();
@@ -416,8 +438,7 @@ bool BlabbleCall::StartOptionsKATimer()
 {
 	if (optionskatimeout_ > 0)
 	{
-		const std::string str = "Start " + boost::lexical_cast<std::string>(optionskatimeout_) + "s OPTIONS keep-alive timer for PJSIP call id " + boost::lexical_cast<std::string>(call_id_) + " (user_data: " + boost::lexical_cast<std::string>(this) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("Start " << optionskatimeout_ << "s OPTIONS keep-alive timer for PJSIP call id " << call_id_ << " (user_data: " << this << ")");
 
 		pj_time_val delay = { 0 };
 		delay.sec = optionskatimeout_;
@@ -425,9 +446,7 @@ bool BlabbleCall::StartOptionsKATimer()
 		const pj_status_t status = pjsip_endpt_schedule_timer(pjsua_get_pjsip_endpt(), &options_ka_timer_, &delay);
 		if (status != PJ_SUCCESS)
 		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " ERROR:                Could not schedule OPTIONS keep-alive timer";
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			BLABBLE_LOG_ERROR("Could not schedule OPTIONS keep-alive timer");
 
 			return false;
 		}
@@ -440,8 +459,7 @@ bool BlabbleCall::StopOptionsKATimer(pjsua_call_id call_id)
 {
 	if (optionskatimeout_ > 0)
 	{
-		const std::string str = "Stop OPTIONS keep-alive timer for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + " (user_data: " + boost::lexical_cast<std::string>(this) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("Stop OPTIONS keep-alive timer for PJSIP call id " << call_id << " (user_data: " << this << ")");
 
 		pjsip_endpt_cancel_timer(pjsua_get_pjsip_endpt(), &options_ka_timer_);
 	}
@@ -451,17 +469,14 @@ bool BlabbleCall::StopOptionsKATimer(pjsua_call_id call_id)
 
 bool BlabbleCall::SendOptionsKA()
 {
-	std::string str = "Send OPTIONS keep-alive PJSIP call id " + boost::lexical_cast<std::string>(call_id_);
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("Send OPTIONS keep-alive PJSIP call id " << call_id_);
 
 	const pj_str_t SIP_OPTIONS = pj_str("OPTIONS");
 
 	pj_status_t status = pjsua_call_send_request(call_id_, &SIP_OPTIONS, NULL);
 	if (status != PJ_SUCCESS)
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		str = " ERROR:                Could not send OPTIONS keep-alive";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("Could not send OPTIONS keep-alive");
 
 		return false;
 	}
@@ -475,8 +490,7 @@ bool BlabbleCall::StartPeriodicEventTimer()
 {
 	if (periodiceventtimeout_ > 0)
 	{
-		const std::string str = "Start " + boost::lexical_cast<std::string>(periodiceventtimeout_) + "s periodic event timer for PJSIP call id " + boost::lexical_cast<std::string>(call_id_) + " (user_data: " + boost::lexical_cast<std::string>(this) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("Start " << periodiceventtimeout_ << "s periodic event timer for PJSIP call id " << call_id_ << " (user_data: " << this << ")");
 
 		pj_time_val delay = { 0 };
 		delay.sec = periodiceventtimeout_;
@@ -484,9 +498,7 @@ bool BlabbleCall::StartPeriodicEventTimer()
 		const pj_status_t status = pjsip_endpt_schedule_timer(pjsua_get_pjsip_endpt(), &periodic_event_timer_, &delay);
 		if (status != PJ_SUCCESS)
 		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " ERROR:                Could not schedule periodic event timer";
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			BLABBLE_LOG_ERROR("Could not schedule periodic event timer");
 
 			return false;
 		}
@@ -501,8 +513,7 @@ bool BlabbleCall::StopPeriodicEventTimer(pjsua_call_id call_id)
 {
 	if (periodiceventtimeout_ > 0)
 	{
-		const std::string str = "Stop periodic event timer for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + " (user_data: " + boost::lexical_cast<std::string>(this) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("Stop periodic event timer for PJSIP call id " << call_id << " (user_data: " << this << ")");
 
 		pjsip_endpt_cancel_timer(pjsua_get_pjsip_endpt(), &periodic_event_timer_);
 	}
@@ -514,20 +525,17 @@ bool BlabbleCall::StopPeriodicEventTimer(pjsua_call_id call_id)
 */
 bool BlabbleCall::OnPeriodicEventTimer()
 {
-	const std::string str = "Periodic event timer for PJSIP call id " + boost::lexical_cast<std::string>(call_id_);
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("Periodic event timer for PJSIP call id " << call_id_);
 
 	if (on_call_periodic_event_)
 	{
-		const std::string str = "Calling callback function for PJSIP call id " + boost::lexical_cast<std::string>(call_id_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("Calling callback function for PJSIP call id " << call_id_);
 
 		on_call_periodic_event_->InvokeAsync("", { BlabbleCallWeakPtr(get_shared()) });
 	}
 	else
 	{
-		const std::string str = "Callback function not set for PJSIP call id " + boost::lexical_cast<std::string>(call_id_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_INFO("Callback function not set for PJSIP call id " << call_id_);
 	}
 
 	// Restart the periodic event timer
@@ -540,8 +548,7 @@ bool BlabbleCall::StartAnswerTimer()
 {
 	if (answertimeout_ > 0)
 	{
-		const std::string str = "Start " + boost::lexical_cast<std::string>(answertimeout_) + "s answer timer for PJSIP call id " + boost::lexical_cast<std::string>(call_id_) + " (user_data: " + boost::lexical_cast<std::string>(this) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("Start " << answertimeout_ << "s answer timer for PJSIP call id " << call_id_ << " (user_data: " << this << ")");
 
 		pj_time_val delay = { 0 };
 		delay.sec = answertimeout_;
@@ -549,9 +556,7 @@ bool BlabbleCall::StartAnswerTimer()
 		const pj_status_t status = pjsip_endpt_schedule_timer(pjsua_get_pjsip_endpt(), &answer_timer_, &delay);
 		if (status != PJ_SUCCESS)
 		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " ERROR:                Could not schedule answer timer";
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			BLABBLE_LOG_ERROR("Could not schedule answer timer");
 
 			return false;
 		}
@@ -564,8 +569,7 @@ bool BlabbleCall::StopAnswerTimer(pjsua_call_id call_id)
 {
 	if (answertimeout_ > 0)
 	{
-		const std::string str = "Stop answer timer for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + " (user_data: " + boost::lexical_cast<std::string>(this) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_DEBUG("Stop answer timer for PJSIP call id " << call_id << " (user_data: " << this << ")");
 
 		pjsip_endpt_cancel_timer(pjsua_get_pjsip_endpt(), &answer_timer_);
 	}
@@ -575,8 +579,7 @@ bool BlabbleCall::StopAnswerTimer(pjsua_call_id call_id)
 
 bool BlabbleCall::OnAnswerTimer()
 {
-	const std::string str = "Answer timer for PJSIP call id " + boost::lexical_cast<std::string>(call_id_);
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_INFO("Answer timer for PJSIP call id " << call_id_);
 
 	LocalEnd();
 
@@ -630,10 +633,7 @@ pj_status_t BlabbleCall::MakeCall(const std::string& dest, const std::string& id
 
 bool BlabbleCall::Answer()
 {
-	{
-		const std::string str = "answer JS method called for PJSIP call id " + boost::lexical_cast<std::string>(call_id_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("answer JS method called for PJSIP call id " << call_id_);
 
 	BlabbleAccountPtr p = CheckAndGetParent();
 	if (!p)
@@ -647,8 +647,14 @@ bool BlabbleCall::Answer()
 
 	StopRinging();
 
-	const std::string str = "Answering PJSIP call id " + boost::lexical_cast<std::string>(call_id_)+" associated to call with global id " + boost::lexical_cast<std::string>(id_);
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	if (!OwnsCallId(call_id_))
+	{
+		BLABBLE_LOG_INFO("PJSIP call id " << call_id_ << " not answered: reused by a new call");
+
+		return false;
+	}
+
+	BLABBLE_LOG_INFO("Answering PJSIP call id " << call_id_ << " associated to call with global id " << id_);
 
 	pj_status_t status = pjsua_call_answer(call_id_, 200, NULL, NULL);
 
@@ -712,8 +718,7 @@ bool BlabbleCall::SendDTMF(const std::string& dtmf)
 
 	if (invalid_digits.length() > 0)
 	{
-		const std::string str = "WARNING: Discarded characters not valid for SendDTMF: " + invalid_digits;
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_WARN("Discarded characters not valid for SendDTMF: " << invalid_digits);
 	}
 
 	pj_str_t digits;
@@ -868,8 +873,7 @@ FB::VariantMap BlabbleCall::status()
 
 const std::string BlabbleCall::statistics()
 {
-	const std::string str = "statistics JS method called for PJSIP call id " + boost::lexical_cast<std::string>(call_id_);
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_DEBUG("statistics JS method called for PJSIP call id " << call_id_);
 
 	if (call_id_ == INVALID_CALL)
 	{
@@ -885,22 +889,14 @@ const std::string BlabbleCall::statistics()
 	return stats_buf;
 }
 
-void BlabbleCall::OnCallMediaState()
+void BlabbleCall::OnCallMediaState(const CallStateInfo &info)
 {
 	if (call_id_ == INVALID_CALL)
 		return;
 
-	pjsua_call_info info;
-	pj_status_t status;
-	if ((status = pjsua_call_get_info(call_id_, &info)) != PJ_SUCCESS) {
-		const std::string str = "Unable to get call info. PJSIP call id " + boost::lexical_cast<std::string>(call_id_) + ", global id " + boost::lexical_cast<std::string>(id_)+", pjsua_call_get_info returned " + boost::lexical_cast<std::string>(status);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_INFO("PJSIP call id " << call_id_ << ": media state: " << info.media_status);
 
-		StopRinging();
-		return;
-	}
-	const std::string str = "PJSIP call id " + boost::lexical_cast<std::string>(call_id_)+": media state: " + boost::lexical_cast<std::string>(info.media_status);
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	SetMediaActive(info.media_status == PJSUA_CALL_MEDIA_ACTIVE);
 
 	if (info.media_status == PJSUA_CALL_MEDIA_ACTIVE) 
 	{
@@ -912,215 +908,220 @@ void BlabbleCall::OnCallMediaState()
 	}
 }
 
-void BlabbleCall::OnCallState(pjsua_call_id call_id, pjsip_event *e)
+// REITEK: Let the log uploads know how many calls have active media
+void BlabbleCall::SetMediaActive(bool active)
 {
-	pjsua_call_info info;
-	if (pjsua_call_get_info(call_id, &info) == PJ_SUCCESS)
-	{
-		const std::string str = "PJSIP call id " + boost::lexical_cast<std::string>(call_id) +
-						": call state: " + boost::lexical_cast<std::string>(info.state) +
-						" (" + std::string(pjsip_inv_state_name(info.state)) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	const long value = active ? 1 : 0;
 
-		if (info.state == PJSIP_INV_STATE_DISCONNECTED) 
-		{
-#if 0	// !!! REMOVE ME
-			/**
-			*	ENGHOUSE: !!! CHECK: This is not reliable anymore, because it is made after media is already deinitialised;
-			*	anyway, pjsip automatically dumps statistics before that happens
-			*/
+	if (INTERLOCKED_EXCHANGE(&media_active_, value) != value)
+		BlabbleLogging::setCallMediaActive(active);
+}
 
-			// REITEK: Dump call statistics
+void BlabbleCall::OnCallState(pjsua_call_id call_id, const CallStateInfo &info)
+{
+	BLABBLE_LOG_INFO("PJSIP call id " << call_id << ": call state: " << info.state << " (" << pjsip_inv_state_name(info.state) << ")");
 
-			const std::string dbgstr = "Dumping statistics for PJSIP call id " + boost::lexical_cast<std::string>(call_id);
-			BlabbleLogging::blabbleLog(0, dbgstr.c_str(), 0);
+	if (info.state == PJSIP_INV_STATE_DISCONNECTED) 
+	{
+#if 0	// !!! REMOVE ME
+		/**
+		*	ENGHOUSE: !!! CHECK: This is not reliable anymore, because it is made after media is already deinitialised;
+		*	anyway, pjsip automatically dumps statistics before that happens
+		*/
 
-			char stats_buf[STATS_BUF_SIZE];
-			memset(stats_buf, 0, STATS_BUF_SIZE);
+		// REITEK: Dump call statistics
 
-			pjsua_call_dump(call_id, PJ_TRUE, stats_buf, STATS_BUF_SIZE, "  ");
-			stats_buf[STATS_BUF_SIZE - 1] = '\0';
+		BLABBLE_LOG_DEBUG("Dumping statistics for PJSIP call id " << call_id);
 
-			BlabbleLogging::blabbleLog(0, stats_buf, 0);
+		char stats_buf[STATS_BUF_SIZE];
+		memset(stats_buf, 0, STATS_BUF_SIZE);
 
-			if (on_call_end_statistics_)
-			{
-				BlabbleCallPtr call = get_shared();
-				on_call_end_statistics_->getHost()->ScheduleOnMainThread(call, boost::bind(&BlabbleCall::CallOnCallEndStatistics, call, stats_buf));
-			}
-#endif
+		pjsua_call_dump(call_id, PJ_TRUE, stats_buf, STATS_BUF_SIZE, "  ");
+		stats_buf[STATS_BUF_SIZE - 1] = '\0';
 
-			RemoteEnd(info);
-		}
-		else if (info.state == PJSIP_INV_STATE_CALLING)
-		{
-			if (on_call_ringing_)
-				on_call_ringing_->InvokeAsync("", FB::variant_list_of(BlabbleCallWeakPtr(get_shared())));
+		BLABBLE_LOG_DEBUG(stats_buf);
 
-			BlabbleAccountPtr p = parent_.lock();
-			if (p)
-				p->OnCallRingChange(get_shared(), info);
-		}
-		else if (info.state == PJSIP_INV_STATE_EARLY)
+		if (on_call_end_statistics_)
 		{
-			// ENGHOUSE: Start the answer timer
-			StartAnswerTimer();
-		}
-		else if (info.state == PJSIP_INV_STATE_CONNECTING)
-		{
-			// ENGHOUSE: Stop the answer timer
-			StopAnswerTimer(call_id_);
+			BlabbleCallPtr call = get_shared();
+			on_call_end_statistics_->getHost()->ScheduleOnMainThread(call, boost::bind(&BlabbleCall::CallOnCallEndStatistics, call, stats_buf));
 		}
-		else if (info.state == PJSIP_INV_STATE_CONFIRMED)
-		{
-			if (on_call_connected_)
-				on_call_connected_->InvokeAsync("", FB::variant_list_of(BlabbleCallWeakPtr(get_shared())));
+#endif
 
-			BlabbleAccountPtr p = parent_.lock();
-			if (p)
-				p->OnCallRingChange(get_shared(), info);
+		RemoteEnd(info);
+	}
+	else if (info.state == PJSIP_INV_STATE_CALLING)
+	{
+		if (on_call_ringing_)
+			on_call_ringing_->InvokeAsync("", FB::variant_list_of(BlabbleCallWeakPtr(get_shared())));
 
-			// ENGHOUSE: If this is the first ACK, schedule the OPTIONS keep-alive timer
-			if (firstconfirmedstate_)
-			{
-				firstconfirmedstate_ = false;
+		BlabbleAccountPtr p = parent_.lock();
+		if (p)
+			p->OnCallRingChange(get_shared(), info);
+	}
+	else if (info.state == PJSIP_INV_STATE_EARLY)
+	{
+		// ENGHOUSE: Start the answer timer
+		StartAnswerTimer();
+	}
+	else if (info.state == PJSIP_INV_STATE_CONNECTING)
+	{
+		// ENGHOUSE: Stop the answer timer
+		StopAnswerTimer(call_id_);
+	}
+	else if (info.state == PJSIP_INV_STATE_CONFIRMED)
+	{
+		if (on_call_connected_)
+			on_call_connected_->InvokeAsync("", FB::variant_list_of(BlabbleCallWeakPtr(get_shared())));
 
-				const std::string str = "PJSIP call id " + boost::lexical_cast<std::string>(call_id) + ": first ACK";
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BlabbleAccountPtr p = parent_.lock();
+		if (p)
+			p->OnCallRingChange(get_shared(), info);
 
-				StartOptionsKATimer();
-			}
+		// ENGHOUSE: If this is the first ACK, schedule the OPTIONS keep-alive timer
+		if (firstconfirmedstate_)
+		{
+			firstconfirmedstate_ = false;
+
+			BLABBLE_LOG_INFO("PJSIP call id " << call_id << ": first ACK");
 
-			// ENGHOUSE: Stop the answer timer
-			StopAnswerTimer(call_id_);
+			StartOptionsKATimer();
 		}
+
+		// ENGHOUSE: Stop the answer timer
+		StopAnswerTimer(call_id_);
 	}
 }
 
 // REITEK: Method to handle transaction state changes
-void BlabbleCall::OnCallTsxState(pjsua_call_id call_id, pjsip_transaction *tsx, pjsip_event *e)
+//Static
+CallTsxEvent BlabbleCall::OnCallTsxState(pjsua_call_id call_id, pjsip_transaction *tsx, pjsip_event *e, int *status_code)
 {
-	pjsua_call_info info;
-	if (pjsua_call_get_info(call_id, &info) == PJ_SUCCESS)
+	if (pjsip_method_cmp(&tsx->method, &pjsip_options_method) == 0)
 	{
-		if (pjsip_method_cmp(&tsx->method, &pjsip_options_method) == 0)
+		/*
+		* Handle incoming OPTIONS request
+		*/
+		if (tsx->role == PJSIP_ROLE_UAS && tsx->state == PJSIP_TSX_STATE_TRYING)
 		{
-			/*
-			* Handle incoming OPTIONS request
-			*/
-			if (tsx->role == PJSIP_ROLE_UAS && tsx->state == PJSIP_TSX_STATE_TRYING)
+			/* Answer incoming OPTIONS request with 200 OK */
+			pjsip_rx_data *rdata;
+			pjsip_tx_data *tdata;
+			pj_status_t status;
+
+			rdata = e->body.tsx_state.src.rdata;
+
+			status = pjsip_endpt_create_response(tsx->endpt, rdata, 200, NULL, &tdata);
+			if (status == PJ_SUCCESS)
 			{
-				/* Answer incoming OPTIONS request with 200 OK */
-				pjsip_rx_data *rdata;
-				pjsip_tx_data *tdata;
-				pj_status_t status;
+				status = pjsip_tsx_send_msg(tsx, tdata);
+			}
 
-				rdata = e->body.tsx_state.src.rdata;
+			if (status == PJ_SUCCESS)
+			{
+				BLABBLE_LOG_DEBUG("Incoming OPTIONS keep-alive for PJSIP call id " << call_id << " answered");
+			}
+			else
+			{
+				BLABBLE_LOG_ERROR("Incoming OPTIONS keep-alive for PJSIP call id " << call_id << " not answered");
+			}
+		}
+		else if ((tsx->role == PJSIP_ROLE_UAC) && (tsx->state == PJSIP_TSX_STATE_COMPLETED))
+		{
+			// Final response for sent OPTIONS keep-alive request
 
-				status = pjsip_endpt_create_response(tsx->endpt, rdata, 200, NULL, &tdata);
-				if (status == PJ_SUCCESS)
-				{
-					status = pjsip_tsx_send_msg(tsx, tdata);
-				}
+			BLABBLE_LOG_DEBUG("Final response for sent OPTIONS keep-alive request for PJSIP call id " << call_id << " received");
 
-				if (status == PJ_SUCCESS)
-				{
-					const std::string str = "Incoming OPTIONS keep-alive for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + " answered";
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-				}
-				else
-				{
-					// !!! UGLY (should automatically conform to pjsip formatting)
-					const std::string str = " ERROR:                Incoming OPTIONS keep-alive for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + " not answered";
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-				}
+			pjsip_msg *msg = e->body.tsx_state.src.rdata->msg_info.msg;
+			if (msg->type == PJSIP_RESPONSE_MSG)
+			{
+				*status_code = msg->line.status.code;
+
+				return TSX_EVENT_OPTIONS_KA_RESPONSE;
 			}
-			else if ((tsx->role == PJSIP_ROLE_UAC) && (tsx->state == PJSIP_TSX_STATE_COMPLETED))
+			else
 			{
-				// Final response for sent OPTIONS keep-alive request
+				BLABBLE_LOG_ERROR("Message is not a SIP response !!!???");
+			}
+		}
+	}
+	else if (pjsip_method_cmp(&tsx->method, &pjsip_notify_method) == 0)
+	{
+		/*
+		* Handle incoming NOTIFY request
+		*/
+		if (tsx->role == PJSIP_ROLE_UAS && tsx->state == PJSIP_TSX_STATE_TRYING)
+		{
+			// !!! FIXME: The incoming NOTIFY request must always be answered
 
-				const std::string str = "Final response for sent OPTIONS keep-alive request for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + " received";
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			/* Answer incoming NOTIFY request with 200 OK if it contains the Event: talk */
+			pjsip_rx_data *rdata;
+			pjsip_tx_data *tdata;
+			pj_status_t status;
 
-				pjsip_msg *msg = e->body.tsx_state.src.rdata->msg_info.msg;
-				if (msg->type == PJSIP_RESPONSE_MSG)
+			rdata = e->body.tsx_state.src.rdata;
+
+			const pj_str_t hdrName = { "Event", 5 };
+			pjsip_generic_string_hdr* hdr = (pjsip_generic_string_hdr*)pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, &hdrName, NULL);
+			if (hdr != NULL)
+			{
+				const char* hdrValue = "talk";
+				hdr->hvalue.ptr[hdr->hvalue.slen] = '\0';
+
+				if (strcmp(hdr->hvalue.ptr, hdrValue) == 0)
 				{
-					if (msg->line.status.code == PJSIP_SC_OK)
+					status = pjsip_endpt_create_response(tsx->endpt, rdata, 200, NULL, &tdata);
+					if (status == PJ_SUCCESS)
 					{
-						const std::string str = "Final response for sent OPTIONS keep-alive request for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + " status code: 200";
-						BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+						status = pjsip_tsx_send_msg(tsx, tdata);
+					}
 
-						// Restart the OPTIONS keep-alive timer
-						StartOptionsKATimer();
+					if (status == PJ_SUCCESS)
+					{
+						BLABBLE_LOG_INFO("Incoming NOTIFY (Event:Talk) for PJSIP call id " << call_id << " answered");
 					}
 					else
 					{
-						// !!! UGLY (should automatically conform to pjsip formatting)
-						const std::string str = " ERROR:                Final response for sent OPTIONS keep-alive request for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + " status code: " + boost::lexical_cast<std::string>(msg->line.status.code);
-						BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-
-						// Must hangup the call
-
-						LocalEnd();
+						BLABBLE_LOG_ERROR("Incoming NOTIFY (Event:Talk) for PJSIP call id " << call_id << " not answered");
 					}
-				}
-				else
-				{
-					// !!! UGLY (should automatically conform to pjsip formatting)
-					const std::string str = " ERROR:                Message is not a SIP response !!!???";
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+
+					return TSX_EVENT_NOTIFY_TALK;
 				}
 			}
 		}
-		else if (pjsip_method_cmp(&tsx->method, &pjsip_notify_method) == 0)
-		{
-			/*
-			* Handle incoming NOTIFY request
-			*/
-			if (tsx->role == PJSIP_ROLE_UAS && tsx->state == PJSIP_TSX_STATE_TRYING)
-			{
-				// !!! FIXME: The incoming NOTIFY request must always be answered
+	}
 
-				/* Answer incoming NOTIFY request with 200 OK if it contains the Event: talk */
-				pjsip_rx_data *rdata;
-				pjsip_tx_data *tdata;
-				pj_status_t status;
+	return TSX_EVENT_NONE;
+}
 
-				rdata = e->body.tsx_state.src.rdata;
+// REITEK: Method to handle what OnCallTsxState returned
+void BlabbleCall::HandleCallTsxEvent(CallTsxEvent tsx_event, int status_code)
+{
+	if (call_id_ == INVALID_CALL)
+		return;
 
-				const pj_str_t hdrName = { "Event", 5 };
-				pjsip_generic_string_hdr* hdr = (pjsip_generic_string_hdr*)pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, &hdrName, NULL);
-				if (hdr != NULL)
-				{
-					const char* hdrValue = "talk";
-					hdr->hvalue.ptr[hdr->hvalue.slen] = '\0';
+	if (tsx_event == TSX_EVENT_OPTIONS_KA_RESPONSE)
+	{
+		if (status_code == PJSIP_SC_OK)
+		{
+			BLABBLE_LOG_DEBUG("Final response for sent OPTIONS keep-alive request for PJSIP call id " << call_id_ << " status code: 200");
 
-					if (strcmp(hdr->hvalue.ptr, hdrValue) == 0)
-					{
-						status = pjsip_endpt_create_response(tsx->endpt, rdata, 200, NULL, &tdata);
-						if (status == PJ_SUCCESS)
-						{
-							status = pjsip_tsx_send_msg(tsx, tdata);
-						}
-
-						if (status == PJ_SUCCESS)
-						{
-							const std::string str = "Incoming NOTIFY (Event:Talk) for PJSIP call id " + boost::lexical_cast<std::string>(call_id)+" answered";
-							BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-						}
-						else
-						{
-							// !!! UGLY (should automatically conform to pjsip formatting)
-							const std::string str = " ERROR:                Incoming NOTIFY (Event:Talk) for PJSIP call id " + boost::lexical_cast<std::string>(call_id) + " not answered";
-							BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-						}
-
-						Answer();
-					}
-				}
-			}
+			// Restart the OPTIONS keep-alive timer
+			StartOptionsKATimer();
+		}
+		else
+		{
+			BLABBLE_LOG_ERROR("Final response for sent OPTIONS keep-alive request for PJSIP call id " << call_id_ << " status code: " << status_code);
+
+			// Must hangup the call
+
+			LocalEnd();
 		}
 	}
+	else if (tsx_event == TSX_EVENT_NOTIFY_TALK)
+	{
+		Answer();
+	}
 }
 
 #if 0	// REITEK: Disabled
@@ -37,6 +37,8 @@ FB_FORWARD_PTR(BlabbleAccount);
 FB_FORWARD_PTR(BlabbleAudioManager);
 FB_FORWARD_PTR(BlabbleCall);
 
+struct CallTableEntry;
+
 #define INVALID_CALL -1
 
 enum CallState
@@ -51,6 +53,26 @@ enum CallState
 	CALL_ERROR_DISCONNECTED = 6 //603
 };
 
+/*! @Brief REITEK: What a call must do after a transaction state change (see BlabbleCall::OnCallTsxState)
+ */
+enum CallTsxEvent
+{
+	TSX_EVENT_NONE = 0,
+	TSX_EVENT_OPTIONS_KA_RESPONSE = 1, //Final response for the sent OPTIONS keep-alive
+	TSX_EVENT_NOTIFY_TALK = 2 //Incoming NOTIFY (Event: talk) answered
+};
+
+/*! @Brief REITEK: The state of a call read by the handlers of the PJSIP call events
+ *  (copied from the pjsua_call_info taken by the PJSIP callback, see PjsuaManager::CallEvent)
+ */
+struct CallStateInfo
+{
+	pjsip_inv_state state;
+	pjsua_call_media_status media_status;
+	pjsip_status_code last_status;
+	pjsua_conf_port_id conf_slot;
+};
+
 class BlabbleCall : public FB::JSAPIAuto
 {
 	public:
@@ -152,17 +174,26 @@ class BlabbleCall : public FB::JSAPIAuto
 		 */
 		std::string destination() const { return destination_; }
 
-		/*! @Brief Called by BlabbleAccount when PJSIP notifies us of a change in the media state.
+		/*! @Brief Called by PjsuaManager when PJSIP notifies us of a change in the media state.
+		 *  info is the state of the call when PJSIP notified the change
 		 */
-		void OnCallMediaState();
+		void OnCallMediaState(const CallStateInfo &info);
 		
-		/*! @Brief Called by BlabbleAccount when PJSIP notifies us of a change in the call state.
+		/*! @Brief Called by PjsuaManager when PJSIP notifies us of a change in the call state.
+		 *  info is the state of the call when PJSIP notified the change
 		 */
-		void OnCallState(pjsua_call_id call_id, pjsip_event *e);
+		void OnCallState(pjsua_call_id call_id, const CallStateInfo &info);
 
-		/*! @Brief Called by BlabbleAccount when PJSIP notifies us of a transaction state change.
-		*/
-		void OnCallTsxState(pjsua_call_id call_id, pjsip_transaction *tsx, pjsip_event *e);
+		/*! @Brief REITEK: Called by PjsuaManager (on the PJSIP thread) when PJSIP notifies a transaction state change.
+		 *  Incoming OPTIONS and NOTIFY (Event: talk) requests are answered here, without waiting for the
+		 *  event dispatcher thread: what the call must do next is returned (status_code is set for
+		 *  TSX_EVENT_OPTIONS_KA_RESPONSE), see HandleCallTsxEvent
+		 */
+		static CallTsxEvent OnCallTsxState(pjsua_call_id call_id, pjsip_transaction *tsx, pjsip_event *e, int *status_code);
+
+		/*! @Brief REITEK: Called by PjsuaManager to handle what OnCallTsxState returned.
+		 */
+		void HandleCallTsxEvent(CallTsxEvent tsx_event, int status_code);
 
 #if 0	// REITEK: Disabled
 		/*! @Brief Called by BlabbleAccount when PJSIP notifies us of the status of a transfer.
@@ -182,7 +213,11 @@ class BlabbleCall : public FB::JSAPIAuto
 
 		/*! @Brief REITEK: Called by BlabbleAccount to handle an incoming call.
 		 */
-		bool HandleIncomingCall(pjsip_rx_data *rdata);		
+		bool HandleIncomingCall(bool mustAnswerCall);
+
+		/*! @Brief REITEK: Called by PjsuaManager (on the PJSIP thread) to know if an incoming call must be auto answered.
+		 */
+		static bool MustAnswerCall(pjsip_rx_data *rdata);
 
 		/*! @Brief A globally unique id for this call. 
 		 *
@@ -235,6 +270,10 @@ class BlabbleCall : public FB::JSAPIAuto
 		bool ringing_;
 		// ENGHOUSE: Flag to know if first ACK or not
 		bool firstconfirmedstate_;
+		// REITEK: Whether media is active (log uploads slow down while any call has active media)
+		volatile long media_active_;
+		// REITEK: Entry of this call in the dispatch table of the PJSIP call events
+		CallTableEntry* table_entry_;
 		// ENGHOUSE: PJSIP timer for sending OPTIONS keep-alive requests during this call
 		pj_timer_entry options_ka_timer_;
 		// ENGHOUSE: OPTIONS keep-alive timeout
@@ -262,13 +301,18 @@ class BlabbleCall : public FB::JSAPIAuto
 		FB::JSObjectPtr on_transfer_status_;
 #endif
 
+		void SetMediaActive(bool active);
+
+		// REITEK: Whether the PJSIP call id still belongs to this call (see OwnsCallId in BlabbleCall.cpp)
+		bool OwnsCallId(pjsua_call_id call_id) const;
+
 		void StopRinging();
 		void StartInRinging();
 		void StartOutRinging();
 
 		BlabbleAccountPtr CheckAndGetParent();
 		//Ended by system
-		void RemoteEnd(const pjsua_call_info &info);
+		void RemoteEnd(const CallStateInfo &info);
 		BlabbleCallPtr get_shared() { return boost::static_pointer_cast<BlabbleCall>(this->shared_from_this()); }
 		
 	private:
@@ -0,0 +1,58 @@
+/**********************************************************\
+Original Author: Andrew Ofisher (zaltar)
+
+License:    GNU General Public License, version 3.0
+            http://www.gnu.org/licenses/gpl-3.0.txt
+
+Copyright 2012 Andrew Ofisher
+\**********************************************************/
+
+/**
+*	REITEK: Compression of the rotated log files (the only part of the logging that uses ZipLib,
+*	so that BlabbleLogging.cpp can be built and tested without it)
+*/
+
+#include "BlabbleLogging.h"
+
+#include "ZipFile.h"
+#include "ZipArchive.h"
+#include "ZipArchiveEntry.h"
+#include "methods/Bzip2Method.h"
+#include "methods/DeflateMethod.h"
+#include "methods/StoreMethod.h"
+
+namespace BlabbleLogging {
+
+	static ICompressionMethod::Ptr createCompressionMethod(LogCompression compression, int level)
+	{
+		switch (compression)
+		{
+		case compressionStore:
+			return StoreMethod::Create();
+		case compressionBzip2:
+			return Bzip2Method::Create();
+		default:
+			{
+				DeflateMethod::Ptr method = DeflateMethod::Create();
+				method->SetCompressionLevel((DeflateMethod::CompressionLevel)level);
+				return method;
+			}
+		}
+	}
+}
+
+bool BlabbleLogging::zipLogFile(const std::string& zipPath, const std::string& logPath, const std::string& name,
+	LogCompression compression, int level, std::string& error)
+{
+	// !!! NOTE: ZipFile::AddEncryptedFile adds to an existing archive
+	try {
+		ZipFile::AddEncryptedFile(zipPath, logPath, name, std::string(), createCompressionMethod(compression, level));
+	}
+	catch (std::exception& e) {
+		error = e.what();
+
+		return false;
+	}
+
+	return true;
+}
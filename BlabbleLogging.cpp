@@ -5,6 +5,13 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 //#include "boost/thread.hpp"
 #include "boost/filesystem.hpp"
@@ -14,11 +21,6 @@
 #include "boost/lexical_cast.hpp"
 #include "boost/iterator/filter_iterator.hpp"
 #include "boost/date_time/posix_time/posix_time.hpp"
-#include "ZipFile.h"
-#include "ZipArchive.h"
-#include "ZipArchiveEntry.h"
-#include "streams/memstream.h"
-#include "methods/Bzip2Method.h"
 #ifdef WIN32
 #include "curl.h"
 #else
@@ -26,10 +28,20 @@
 #endif
 #include <fstream>
 #include <cstdio>
+#include <cstring>
+#include <ctime>
 //#include <time.h>
 
 #ifdef WIN32
 #include <Windows.h>
+#else
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
 #endif
 
 #include "simple_thread_safe_queue.h"
@@ -45,6 +57,56 @@ namespace BlabbleLogging {
 
 	static const std::string logSIP = "PluginSIP" + extensionLOG;
 	static const std::string logAD = "AgentDesktop" + extensionLOG;
+	static const std::string logCrash = "PluginCrash" + extensionLOG;
+
+	/**
+	*	Header sent with the logSender archive: version 2 holds a zip for each compressed log file (see README.md),
+	*	while the flat archive of the .log files sent before has no such header
+	*/
+	static const std::string logArchiveFormatHeader = "X-Log-Archive-Format: 2";
+
+	/**
+	*	Amount of buffered data that forces a write to the log file
+	*/
+	static const std::size_t logFlushSize = 64 * 1024;
+
+	/**
+	*	Maximum time buffered data is kept in memory before being written to the log file
+	*/
+	static const int logFlushIntervalMs = 1000;
+
+	/**
+	*	A write to a log file taking longer than this means that the disk is stalling
+	*	(network profile folders, antivirus scanners, ...)
+	*/
+	static const int logStallWriteMs = 250;
+
+	/**
+	*	While the disk is stalling, data is kept in memory and written again only after logStallRetryMs
+	*	or when it grows over logStallBufferSize
+	*/
+	static const int logStallRetryMs = 5000;
+	static const std::size_t logStallBufferSize = 4 * 1024 * 1024;
+
+	/**
+	*	Default capacity (in lines) of each queue of the LogHandler thread
+	*/
+	static const unsigned int logQueueCapacity = 16384;
+
+	/**
+	*	Slots of the lock-free ring of each queue of the LogHandler thread: lines over it
+	*	(with a larger or unbounded capacity) are queued taking the lock of the queue
+	*/
+	static const std::size_t logQueueRingSize = logQueueCapacity;
+
+	/**
+	*	Number of threads compressing the rotated log files
+	*
+	*	!!! NOTE: test/LogCompressorBench (10 files of 10 MB) on a single core: 1 to 4 threads take the
+	*	same wall clock time as compressLogs (within 10%). More threads have no measured gain: keep one
+	*	until LogCompressorBench on a multi-core agent PC shows otherwise
+	*/
+	static const unsigned int logCompressorThreads = 1;
 
 	/**
 	*	!!! NOTE: Using XP_WIN/XP_UNIX defines could be avoided
@@ -89,6 +151,14 @@ namespace BlabbleLogging {
 	*/
 	static std::string filepathAD;
 
+	/**
+	*	Filename of the file the crash handler writes into (!!! NOTE: It is set by the setFilePaths function)
+	*
+	*	!!! NOTE: The crash handler can't use a std::string, so it is kept into a preallocated buffer
+	*/
+	static std::string filepathCrash;
+	static char crashPath[4096];
+
 	/**
 	*	!!! CHECK: This is an atomic type because it is directly modified by the JS API
 	*	(no task within the shared queue is used to modify it)
@@ -102,613 +172,3729 @@ namespace BlabbleLogging {
 	static std::atomic_uint logNumber(3);
 
 	/**
-	*	Set SIP and AD log file paths according to the logdir variable
+	*	Codec used to compress the rotated log files
+	*
+	*	!!! NOTE: Deflate level 6 by default. test/LogCompressionBench on 10 MB of PJSIP level 5 log (ratio, CPU time):
+	*	deflate 1 6.6x 0.08 s, deflate 6 9.8x 0.16 s, deflate 9 10.3x 0.22 s, bzip2 11.5x 1.45 s. Level 6 uploads a
+	*	third less than level 1 for 0.08 s more of a background thread per rotation; bzip2 costs 9 times its CPU
 	*/
-	static void setFilePaths()
-	{
-		/**
-		*	!!! NOTE: Using XP_WIN/XP_UNIX defines could be avoided
-		*
-		*	(See: boost::filesystem::path::preferred_separator)
-		*/
-
-#if defined(XP_WIN)
-		filepathSIP = logdir + "\\" + logSIP;
-		filepathAD = logdir + "\\" + logAD;
-#elif defined(XP_UNIX)
-		filepathSIP = logdir + "/" + logSIP;
-		filepathAD = logdir + "/" + logAD;
-#endif
-	}
+	static std::atomic_int logCompression(compressionDeflate);
+	static std::atomic_int logCompressionLevel(6);
 
-	static std::string createDateLog(const std::string& pfx)
-	{
-		std::string tmp = pfx;
-		const boost::posix_time::ptime now = boost::posix_time::second_clock::local_time();
-		const boost::posix_time::time_facet *facet = new boost::posix_time::time_facet("%Y-%m-%d_%H%M%S");
+	/**
+	*	Maximum log upload rate (bytes/s, 0 means unlimited)
+	*/
+	static std::atomic_ulong logUploadRate(0);
 
-		std::ostringstream stream;
-		stream.imbue(std::locale(stream.getloc(), facet));
-		stream << now;
+	/**
+	*	Log upload rate while any call has active media (bytes/s, 0 means no slowdown)
+	*
+	*	!!! NOTE: CURLOPT_MAX_SEND_SPEED_LARGE can't be changed during a transfer, so this one
+	*	is applied by the read callbacks (see LogUpload::pace)
+	*/
+	static std::atomic_ulong logUploadRateCall(16 * 1024);
 
-		tmp.append(stream.str());
+	/**
+	*	Position of the sender within the PJSIP log lines (after the level text, see the decoration set by PjsuaManager)
+	*
+	*	!!! NOTE: It is right aligned to PJ_LOG_SENDER_WIDTH (which depends on the PJSIP build),
+	*	so it is found by skipping the spaces and it ends at the next one
+	*/
+	static const std::size_t pjsipSenderOffset = 7;
 
-		return tmp;
-	}
+	/**
+	*	Maximum length of the senders (PJSIP truncates longer ones to PJ_LOG_SENDER_WIDTH anyway)
+	*/
+	static const std::size_t pjsipSenderMax = 32;
 
-	static std::string createDateLogSIP()
+	/**
+	*	Level of the PJSIP lines of a sender (see setSenderLogLevel)
+	*/
+	struct SenderLogLevel
 	{
-		return createDateLog(nameSIP);
-	}
+		char name[pjsipSenderMax + 1];
+		std::size_t len;
+		bool prefix;
+		std::atomic_int level;
+	};
 
-	static std::string createDateLogAD()
-	{
-		return createDateLog(nameAD);
-	}
+	/**
+	*	Senders are only added, so pjsipLog reads them without locking: an entry is filled in
+	*	before senderLogLevelsCount includes it (the mutex only serializes the writers)
+	*/
+	static const std::size_t senderLogLevelsMax = 32;
+	static SenderLogLevel senderLogLevels[senderLogLevelsMax];
+	static std::atomic_size_t senderLogLevelsCount(0);
+	static std::mutex senderLogLevels_mutex_;
 
-	static std::string createDateLogZIP()
-	{
-		return createDateLog(nameZIP);
-	}
+	/**
+	*	Level of the PJSIP lines of the senders without their own level (PJSIP already filters them by its own level)
+	*/
+	static std::atomic_int senderDefaultLogLevel(levelTrace);
 
-	static std::string createDateTime() 
-	{
-		const boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
-		const boost::posix_time::time_facet *facet = new boost::posix_time::time_facet("%d/%m/%Y - %H:%M:%S.%f");
+	/**
+	*	Identical consecutive lines are written once, followed by "previous message repeated N times"
+	*	when a different line is logged or when they have been repeating for this time (seconds, 0 disables it)
+	*/
+	static std::atomic_uint logRepeatInterval(60);
 
-		std::ostringstream stream;
-		stream.imbue(std::locale(stream.getloc(), facet));
-		stream << now;
-	
-		/* Taglio la frazione al millisecondo */
-		return stream.str().substr(0,25);
-	}
+	/**
+	*	Time window (seconds) of the per call site limit of the BLABBLE_LOG_* macros (see LogSite)
+	*/
+	static std::atomic_uint logSiteInterval(60);
 
 	/**
-	*	Write the passed data into the SIP log file
+	*	Number of calls with active media (see setCallMediaActive)
+	*/
+	static std::atomic_int callsMediaActive(0);
+
+	/**
+	*	When true, each line is written to disk as soon as it is logged
+	*	(there is no LogHandler thread to periodically flush the buffered data)
+	*/
+	static std::atomic_bool logging_sync(true);
+
+	/**
+	*	Capacity and overflow policy of the SIP and AD queues of the LogHandler thread
+	*	(indexed by LogLane)
 	*
-	*	Forward declaration that makes easier to use it into functions defined within the namespace
-	*	before its definition
+	*	!!! CHECK: These are atomic types because they are set (see setQueueLimits) without holding any lock
 	*/
-	void writeLogSIPInternal(int level, const char* data, int /* len */);
+	static std::atomic_uint logQueueCapacities[2] = { { logQueueCapacity }, { logQueueCapacity } };
+	static std::atomic_int logQueuePolicies[2] = { { overflowDropNewest }, { overflowDropNewest } };
 
 	/**
-	*	Write the passed data into the AD log file
+	*	Number of lines dropped because their queue was full, since logging was initialised
+	*	(indexed by LogLane)
+	*/
+	static std::atomic_ulong logDropped[2] = { { 0 }, { 0 } };
+
+	/**
+	*	Log file kept open between writes
 	*
-	*	The suppressCheckLogAD parameter is useful to avoid checking log size
-	*	and rotating logs doing logging caused by internal operations (e.g. uploading logs)
+	*	Lines are accumulated into an in-memory buffer which is written to the file
+	*	when it grows over logFlushSize, when it is older than logFlushIntervalMs,
+	*	or before the file is closed/rotated.
+	*	The file is (re)opened lazily on the first write after being closed.
 	*
-	*	Forward declaration that makes easier to use it into functions defined within the namespace
-	*	before its definition
+	*	The size of the file is tracked in memory (it is read from disk only when
+	*	the path is set), so that checking it for rotation requires no syscalls.
+	*
+	*	When a write takes longer than logStallWriteMs the file is considered stalled:
+	*	lines are then kept in memory (up to logStallBufferSize) and the write is retried
+	*	after logStallRetryMs, so that the LogHandler thread keeps draining its queues.
 	*/
-	void writeLogADInternal(const std::string& data, bool suppressCheckLogAD = true);
-
-	bool setLogPathInternal(const std::string &logpath)
+	class LogFile
 	{
-		/**
-		*	Don't allow an empty logpath
-		*/
-
-		if (logpath.length() <= 0)
+	public:
+		LogFile()
+			: size_(0), lastflush_(std::chrono::steady_clock::now()), stalled_(false)
 		{
-			writeLogADInternal(" [PLUGIN] Log Path indicato vuoto. Attuale Log Path non modificato: (" + logdir + ")");
+			buffer_.reserve(logFlushSize);
+		}
 
-			return false;
+		~LogFile()
+		{
+			close();
 		}
 
 		/**
-		*	Check if logdir is the same as logpath (XP_WIN: case insensitive)
+		*	Set the path of the file (the current one, if any, is flushed and closed)
 		*/
-
-		#if defined(XP_WIN)
-		// strcasecmp is only defined by POSIX, so this one must be used instead
-		if (_stricmp(logdir.c_str(), logpath.c_str()) == 0)
-		{
-			writeLogADInternal(" [PLUGIN] Log Path indicato identico. Attuale Log Path non modificato (" + logdir + ")");
-
-			return false;
-		}
-		#elif defined(XP_UNIX)
-		if (logdir.compare(logpath) == 0)
+		void setPath(const std::string& filepath)
 		{
-			writeLogADInternal(" [PLUGIN] Log Path indicato identico. Attuale Log Path non modificato (" + logdir + ")");
+			std::lock_guard<std::mutex> lock(mutex_);
 
-			return false;
-		}
-		#endif
+			closeInternal();
 
-		//logging_initialised = false;
+			filepath_ = filepath;
+			stalled_ = false;
 
-		writeLogADInternal(" [PLUGIN] Log Path modificato: (" + logpath + ")");
+			boost::system::error_code ec;
+			const boost::uintmax_t size = boost::filesystem::file_size(filepath_, ec);
+			size_ = ec ? 0 : size;
+		}
 
 		/**
-		*	Update logdir
+		*	Size of the file, including the data not yet written
 		*/
+		boost::uintmax_t size()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
 
-		logdir = logpath;
+			return size_;
+		}
 
 		/**
-		*	Set new file paths
+		*	Append one or more complete (newline terminated) lines to the file
 		*/
+		void write(const std::string& lines)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
 
-		setFilePaths();
-
-		return true;
-	}
-
-	/**
-	*	Ensure creation of the directory pointed by the logdir variable 
-	*/
-	static void makeLogDir()
-	{
-		boost::filesystem::create_directories(logdir);
-	}
-
-	static bool existsFile(const std::string &filepath)
-	{
-		const std::fstream fs = std::fstream(filepath, std::ios::in);
-		const bool open = fs.is_open();
-		//fs.flush();
-		// !!! CHECK: Try not to close the stream and rely on the destructor to do it
-		//fs.close();
-		return open;
-	}
+			buffer_.append(lines);
 
-	static std::ofstream createFile(const std::string &filepath)
-	{
-		return std::ofstream(filepath, std::ios::app);
-	}
+			size_ += lines.size();
 
-	static std::vector<std::string> countLog(const std::string& regex)
-	{
-		const boost::regex my_filter(regex /*"^AgentDesktop_.*\\.log$"*/ );
-		std::vector<std::string> all_matching_files;
+			if (stalled_)
+			{
+				if ((buffer_.size() >= logStallBufferSize) || (std::chrono::steady_clock::now() >= retry_))
+					flushInternal();
+			}
+			else if (logging_sync.load() ||
+				(buffer_.size() >= logFlushSize) ||
+				(std::chrono::steady_clock::now() - lastflush_ >= std::chrono::milliseconds(logFlushIntervalMs)))
+			{
+				flushInternal();
+			}
+		}
 
-		boost::filesystem::directory_iterator end_itr; // Default ctor yields past-the-end
-		for (boost::filesystem::directory_iterator i(logdir); i != end_itr; ++i)
+		/**
+		*	Write the buffered data to the file (unless it is stalled and it is not yet time to retry)
+		*/
+		void flush()
 		{
-			// Skip if not a file
-			if (!boost::filesystem::is_regular_file(i->status())) continue;
+			std::lock_guard<std::mutex> lock(mutex_);
 
-			// Skip if no match
-			if (!boost::regex_match(i->path().filename().string(), my_filter)) continue;
-
-			// File matches, store it
-			all_matching_files.push_back(i->path().filename().string());
+			if (!stalled_ || (std::chrono::steady_clock::now() >= retry_))
+				flushInternal();
 		}
 
-		return all_matching_files;
-	}
-
-	static std::vector<std::string> countLogSIP()
-	{
-		return countLog("^PluginSIP_.*\\.log$");
-	}
-
-	static std::vector<std::string> countLogAD()
-	{
-		return countLog("^AgentDesktop_.*\\.log$");
-	}
+		/**
+		*	Write the buffered data to the file and close it
+		*/
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
 
-	static void checkHistoricalLog(const std::vector<std::string>& logFiles)
-	{
-		/* Check Storico */
-		int count = logFiles.size();
+			closeInternal();
+		}
 
-		for (int i = 0; logNumber < count; ++i)
+		/**
+		*	Write the buffered data to the file, close it and rename it to newpath
+		*
+		*	The file is reopened (with its original path) on the next write
+		*/
+		bool rotate(const std::string& newpath)
 		{
-			writeLogADInternal(" [PLUGIN] Next file: " + logFiles.at(i));
-
-			/**
-			*	!!! NOTE: Using XP_WIN/XP_UNIX defines could be avoided
-			*
-			*	(See: boost::filesystem::path::preferred_separator)
-			*/
+			std::lock_guard<std::mutex> lock(mutex_);
 
-#if (XP_WIN)
-			std::string path = logdir + "\\" + logFiles.at(i);
-#elif (XP_UNIX)
-			std::string path = logdir + "/" + logFiles.at(i);
-#endif
+			closeInternal();
 
-			writeLogADInternal(" [PLUGIN] Removed: " + path);
+			boost::system::error_code ec;
+			boost::filesystem::rename(filepath_, newpath, ec);
 
-			std::remove(path.c_str());
+			// !!! NOTE: The counter is reset even on failure, to avoid retrying the rename for each line
+			size_ = 0;
 
-			count--;
+			return !ec;
 		}
-		//counter.clear();
-	}
 
-	static void checkHistoricalLogSIP() {
-		writeLogADInternal(" [PLUGIN] Check Historical Log SIP");
+	private:
+		void flushInternal()
+		{
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-		checkHistoricalLog(countLogSIP());
-	}
+			lastflush_ = start;
 
-	static void checkHistoricalLogAD()
-	{
-		writeLogADInternal(" [PLUGIN] Check Historical Log AD");
+			if (buffer_.empty())
+				return;
 
-		checkHistoricalLog(countLogAD());
-	}
+			if (!fs_.is_open())
+			{
+				open();
+			}
 
-	static void checkLogSIP()
-	{
-		/*
-		*	Controllo della presenza del SIP log file e della sua dimensione;
-		*	se ha superato quella massima, viene rinominato e viene effettuata l'archiviazione
-		*/
-		if (existsFile(filepathSIP))
-		{
-			if (boost::filesystem::file_size(filepathSIP) >= (logDimension * 1024 * 1024))
+			if (fs_.is_open())
 			{
-				const std::string logPath = logdir + createDateLogSIP() + extensionLOG;
+				fs_.write(buffer_.data(), buffer_.size());
+				fs_.flush();
 
-				// !!! CHECK: This should be useless
-				//logging_started = false;
+				if (!fs_.good())
+				{
+					// Try reopening the file on the next flush
+					fs_.close();
+					fs_.clear();
+				}
+			}
 
-				boost::filesystem::rename(filepathSIP, logPath.c_str());
+			lastflush_ = std::chrono::steady_clock::now();
 
-				// !!! CHECK: This should be useless
-				//initLogging();
+			stalled_ = (lastflush_ - start >= std::chrono::milliseconds(logStallWriteMs));
+			if (stalled_)
+				retry_ = lastflush_ + std::chrono::milliseconds(logStallRetryMs);
 
-				/* Check Storico */
-				checkHistoricalLogSIP();
+			// !!! NOTE: Data is discarded if the file cannot be written
+			if (!stalled_ && (buffer_.capacity() > 2 * logFlushSize))
+			{
+				// Give back the memory used while the file was stalled
+				std::string().swap(buffer_);
+				buffer_.reserve(logFlushSize);
+			}
+			else
+			{
+				buffer_.clear();
 			}
 		}
-	}
 
-	static void checkLogAD()
-	{
-		/*
-		*	Controllo della presenza del AD log file e della sua dimensione;
-		*	se ha superato quella massima, viene rinominato e viene effettuata l'archiviazione
-		*/
-		if (existsFile(filepathAD))
+		void open()
 		{
-			if (boost::filesystem::file_size(filepathAD) >= (logDimension * 1024 * 1024))
+			// The buffering is already done by this class
+			fs_.rdbuf()->pubsetbuf(0, 0);
+			fs_.open(filepath_, std::ios::app);
+
+			if (!fs_.is_open())
 			{
-				const std::string logPath = logdir + createDateLogAD() + extensionLOG;
-				boost::filesystem::rename(filepathAD, logPath);
+				// The log directory is only created upon initialization: it may have been removed since then
+				fs_.clear();
 
-				/* Check Storico */
-				checkHistoricalLogAD();
+				boost::system::error_code ec;
+				boost::filesystem::create_directories(boost::filesystem::path(filepath_).parent_path(), ec);
+
+				fs_.rdbuf()->pubsetbuf(0, 0);
+				fs_.open(filepath_, std::ios::app);
 			}
 		}
-	}
 
-	static std::string createZIP()
-	{
-		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Inizio createZIP");
+		void closeInternal()
+		{
+			flushInternal();
 
-		/*
-		 * Creazione del percorso completo del file zip
-		 */
+			if (fs_.is_open())
+				fs_.close();
+
+			fs_.clear();
+		}
+
+		std::mutex mutex_;
+		std::string filepath_;
+		std::string buffer_;
+		std::ofstream fs_;
+		boost::uintmax_t size_;
+		std::chrono::steady_clock::time_point lastflush_;
+		bool stalled_;
+		std::chrono::steady_clock::time_point retry_;
+	};
+
+	/**
+	*	SIP log file (!!! NOTE: Its path is set by the setFilePaths function)
+	*/
+	static LogFile logFileSIP;
+
+	/**
+	*	AD log file (!!! NOTE: Its path is set by the setFilePaths function)
+	*/
+	static LogFile logFileAD;
 
+	/**
+	*	Set SIP and AD log file paths according to the logdir variable
+	*/
+	static void setFilePaths()
+	{
 		/**
 		*	!!! NOTE: Using XP_WIN/XP_UNIX defines could be avoided
 		*
 		*	(See: boost::filesystem::path::preferred_separator)
 		*/
 
-#if (XP_WIN)
-		std::string filepathZIP = logdir + "\\" + createDateLogZIP() + extensionZIP;
-#elif (XP_UNIX)
-		std::string filepathZIP = logdir + "/" + createDateLogZIP() + extensionZIP;
+#if defined(XP_WIN)
+		filepathSIP = logdir + "\\" + logSIP;
+		filepathAD = logdir + "\\" + logAD;
+		filepathCrash = logdir + "\\" + logCrash;
+#elif defined(XP_UNIX)
+		filepathSIP = logdir + "/" + logSIP;
+		filepathAD = logdir + "/" + logAD;
+		filepathCrash = logdir + "/" + logCrash;
 #endif
-	
+
+		logFileSIP.setPath(filepathSIP);
+		logFileAD.setPath(filepathAD);
+
+		// A path too long for the buffer is not used (better no crash file than a wrong one)
+		if (filepathCrash.size() < sizeof(crashPath))
+			memcpy(crashPath, filepathCrash.c_str(), filepathCrash.size() + 1);
+		else
+			crashPath[0] = '\0';
+	}
+
+	/**
+	*	Convert t to the local time (thread safe)
+	*/
+	static void localTime(std::time_t t, std::tm& tm)
+	{
+#ifdef WIN32
+		localtime_s(&tm, &t);
+#else
+		localtime_r(&t, &tm);
+#endif
+	}
+
+	static std::string createDateLog(const std::string& pfx)
+	{
+		std::tm tm;
+		localTime(std::time(NULL), tm);
+
+		char buf[32];
+		const std::size_t len = strftime(buf, sizeof(buf), "%Y-%m-%d_%H%M%S", &tm);
+
+		return pfx + std::string(buf, len);
+	}
+
+	static std::string createDateLogSIP()
+	{
+		return createDateLog(nameSIP);
+	}
+
+	static std::string createDateLogAD()
+	{
+		return createDateLog(nameAD);
+	}
+
+	static std::string createDateLogZIP()
+	{
+		return createDateLog(nameZIP);
+	}
+
+	/**
+	*	Formatter of the timestamp of log lines ("dd/mm/YYYY - HH:MM:SS.mmm")
+	*
+	*	The date and time up to the seconds are cached and only formatted again
+	*	when the second changes: usually just the milliseconds are written.
+	*	An instance must only be used by one thread at a time.
+	*/
+	class LogTimestamp
+	{
+	public:
+		static const std::size_t length = 25;
+
+		LogTimestamp()
+			: second_(-1)
+		{
+		}
+
+		/**
+		*	Write the current timestamp into buf, which must have room for (at least) length chars
+		*
+		*	!!! NOTE: The timestamp is not NUL terminated
+		*/
+		void format(char* buf)
+		{
+			const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+			const std::time_t second = (std::time_t)(ms / 1000);
+			const int millis = (int)(ms % 1000);
+
+			if (second != second_)
+			{
+				std::tm tm;
+				localTime(second, tm);
+
+				// !!! NOTE: Each field is clamped to its width, so that the prefix can't be truncated
+				snprintf(prefix_, sizeof(prefix_), "%02u/%02u/%04u - %02u:%02u:%02u.",
+					(unsigned)tm.tm_mday % 100, (unsigned)(tm.tm_mon + 1) % 100, (unsigned)(tm.tm_year + 1900) % 10000,
+					(unsigned)tm.tm_hour % 100, (unsigned)tm.tm_min % 100, (unsigned)tm.tm_sec % 100);
+
+				second_ = second;
+			}
+
+			memcpy(buf, prefix_, prefixLength);
+
+			/* Taglio la frazione al millisecondo */
+			buf[prefixLength] = (char)('0' + millis / 100);
+			buf[prefixLength + 1] = (char)('0' + (millis / 10) % 10);
+			buf[prefixLength + 2] = (char)('0' + millis % 10);
+		}
+
+	private:
+		static const std::size_t prefixLength = length - 3;
+
+		std::time_t second_;
+		char prefix_[prefixLength + 1];
+	};
+
+	/**
+	*	Append the current timestamp to the passed batch
+	*/
+	static void appendDateTime(std::string& batch)
+	{
+		static thread_local LogTimestamp timestamp;
+
+		const std::size_t pos = batch.size();
+		batch.resize(pos + LogTimestamp::length);
+		timestamp.format(&batch[pos]);
+	}
+
+	/**
+	*	Append a line for the SIP log file to the passed batch
+	*/
+	static void formatLogSIP(std::string& batch, const char* data, std::size_t len)
+	{
+		appendDateTime(batch);
+		batch.push_back(' ');
+		batch.append(data, len);
+		batch.push_back('\n');
+	}
+
+	/**
+	*	Append a line for the AD log file to the passed batch
+	*/
+	static void formatLogAD(std::string& batch, const char* data, std::size_t len)
+	{
+		appendDateTime(batch);
+		batch.append(data, len);
+		batch.push_back('\n');
+	}
+
+	/**
+	*	Collapse identical consecutive lines of a log file (timers and PJSIP media lines repeat a lot)
+	*
+	*	A repeated line is only counted: the count is written (with the format function of the log file)
+	*	before the next different line, or once the line has been repeating for logRepeatInterval.
+	*	It is used by whichever thread formats the lines (the LogHandler one, or the logging threads
+	*	when logging is synchronous), hence the mutex.
+	*/
+	class LogRepeatFilter
+	{
+	public:
+		typedef void (*Format)(std::string& batch, const char* data, std::size_t len);
+
+		explicit LogRepeatFilter(Format format)
+			: format_(format), repeated_(0)
+		{
+		}
+
+		/**
+		*	Return true if data is the same as the previous line (so it must not be written):
+		*	otherwise the pending count (if any) is appended to batch, and data must be written
+		*/
+		bool filter(std::string& batch, const char* data, std::size_t len)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			const unsigned int interval = logRepeatInterval.load();
+
+			if ((interval > 0) && (len == last_.size()) && (memcmp(data, last_.data(), len) == 0))
+			{
+				const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+				if (repeated_++ == 0)
+					first_ = now;
+				else if (now - first_ >= std::chrono::seconds(interval))
+					appendRepeated(batch);
+
+				return true;
+			}
+
+			appendRepeated(batch);
+
+			if (interval > 0)
+				last_.assign(data, len);
+			else
+				last_.clear();
+
+			return false;
+		}
+
+		/**
+		*	Append the pending count to batch if the line has been repeating for logRepeatInterval
+		*	(called when nothing has been logged for a while)
+		*/
+		void flushExpired(std::string& batch)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			if ((repeated_ > 0) &&
+				(std::chrono::steady_clock::now() - first_ >= std::chrono::seconds(logRepeatInterval.load())))
+				appendRepeated(batch);
+		}
+
+		/**
+		*	Append the pending count (if any) to batch
+		*/
+		void flush(std::string& batch)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			appendRepeated(batch);
+		}
+
+	private:
+		void appendRepeated(std::string& batch)
+		{
+			if (repeated_ == 0)
+				return;
+
+			const std::string str = " [PLUGIN] previous message repeated " + boost::lexical_cast<std::string>(repeated_) + " times";
+			format_(batch, str.data(), str.size());
+
+			repeated_ = 0;
+		}
+
+		std::mutex mutex_;
+		Format format_;
+		std::string last_;
+		unsigned long repeated_;
+		std::chrono::steady_clock::time_point first_;
+	};
+
+	static LogRepeatFilter logrepeatSIP_(formatLogSIP);
+	static LogRepeatFilter logrepeatAD_(formatLogAD);
+
+	/**
+	*	Write the pending counts of repeated lines into the log files (before they are closed or moved)
+	*/
+	static void flushRepeated()
+	{
+		std::string str;
+
+		logrepeatAD_.flush(str);
+		if (!str.empty())
+			logFileAD.write(str);
+
+		str.clear();
+
+		logrepeatSIP_.flush(str);
+		if (!str.empty())
+			logFileSIP.write(str);
+	}
+
+	/**
+	*	Ring of the last lines of the SIP log file, kept in memory to be read from the JS API
+	*
+	*	Lines are copied into it by the logging threads themselves (not by the LogHandler one),
+	*	so it can be read even while the LogHandler thread is busy writing the log files.
+	*	Neither writers nor readers take locks: each record has a sequence number, which is odd
+	*	while the record is being written, and readers discard the records changed while copying them.
+	*/
+	class LogRecentRing
+	{
+	public:
+		/**
+		*	Number of records (lines) kept
+		*/
+		static const std::size_t records = 512;
+
+		/**
+		*	Size of each record (longer lines are truncated)
+		*/
+		static const std::size_t recordSize = 1024;
+
+		void push(const char* data, std::size_t len)
+		{
+			const unsigned long long ticket = next_.fetch_add(1, std::memory_order_relaxed);
+			Record& record = records_[ticket % records];
+
+			// The record is skipped if another thread is still writing into the same slot
+			// (the ring wrapped around meanwhile) or if it already holds a newer line
+			unsigned long long seq = record.seq.load(std::memory_order_relaxed);
+			if ((seq & 1) || (seq > 2 * ticket) ||
+				!record.seq.compare_exchange_strong(seq, 2 * ticket + 1, std::memory_order_acquire))
+				return;
+
+			if (len > recordSize)
+				len = recordSize;
+
+			record.time.store(std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+			record.len.store(len, std::memory_order_relaxed);
+			memcpy(record.data, data, len);
+
+			record.seq.store(2 * ticket + 2, std::memory_order_release);
+		}
+
+		/**
+		*	Write all the lines into file, oldest first (times are UTC)
+		*
+		*	!!! NOTE: It is called by the crash handler: it doesn't allocate nor lock anything,
+		*	and only uses the passed buffer (which must have room for a formatted record)
+		*/
+		template <class File>
+		void dump(File& file, char* buf) const
+		{
+			const unsigned long long next = next_.load(std::memory_order_acquire);
+			const unsigned long long first = (next > records) ? next - records : 0;
+
+			for (unsigned long long ticket = first; ticket < next; ++ticket)
+			{
+				const Record& record = records_[ticket % records];
+				const unsigned long long seq = 2 * ticket + 2;
+
+				if (record.seq.load(std::memory_order_acquire) != seq)
+					continue;
+
+				const long long time = record.time.load(std::memory_order_relaxed);
+				const std::size_t len = record.len.load(std::memory_order_relaxed);
+				memcpy(buf + LogTimestamp::length + 1, record.data, len);
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (record.seq.load(std::memory_order_relaxed) != seq)
+					continue;
+
+				formatTimeUTC(time, buf);
+				buf[LogTimestamp::length] = ' ';
+				buf[LogTimestamp::length + 1 + len] = '\n';
+
+				file.write(buf, LogTimestamp::length + 1 + len + 1);
+			}
+		}
+
+		/**
+		*	Size of the buffer needed by dump
+		*/
+		static const std::size_t dumpBufferSize = LogTimestamp::length + 1 + recordSize + 1;
+
+		/**
+		*	Get the last count lines containing filter (all of them if it is empty), oldest first
+		*/
+		std::vector<std::string> get(std::size_t count, const std::string& filter) const
+		{
+			std::vector<std::string> lines;
+
+			const unsigned long long next = next_.load(std::memory_order_acquire);
+			const unsigned long long first = (next > records) ? next - records : 0;
+
+			char data[LogTimestamp::length + 1 + recordSize];
+
+			for (unsigned long long ticket = next; (ticket > first) && (lines.size() < count); --ticket)
+			{
+				const Record& record = records_[(ticket - 1) % records];
+				const unsigned long long seq = 2 * (ticket - 1) + 2;
+
+				if (record.seq.load(std::memory_order_acquire) != seq)
+					continue;
+
+				const long long time = record.time.load(std::memory_order_relaxed);
+				const std::size_t len = record.len.load(std::memory_order_relaxed);
+				memcpy(data + LogTimestamp::length + 1, record.data, len);
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (record.seq.load(std::memory_order_relaxed) != seq)
+					continue;
+
+				if (!filter.empty() &&
+					(std::search(data + LogTimestamp::length + 1, data + LogTimestamp::length + 1 + len,
+						filter.begin(), filter.end()) == data + LogTimestamp::length + 1 + len))
+					continue;
+
+				formatTime(time, data);
+				data[LogTimestamp::length] = ' ';
+
+				lines.push_back(std::string(data, LogTimestamp::length + 1 + len));
+			}
+
+			std::reverse(lines.begin(), lines.end());
+
+			return lines;
+		}
+
+	private:
+		/**
+		*	!!! NOTE: time and len are atomic (relaxed), as readers may load them while a writer stores
+		*	them: a torn len would make the copy overflow. The seq check discards such records anyway
+		*/
+		struct Record
+		{
+			std::atomic_ullong seq;
+			std::atomic_llong time;
+			std::atomic<std::size_t> len;
+			char data[recordSize];
+		};
+
+		/**
+		*	Same format of LogTimestamp (but for the passed time)
+		*/
+		static void formatTime(long long ms, char* buf)
+		{
+			std::tm tm;
+			localTime((std::time_t)(ms / 1000), tm);
+
+			// !!! NOTE: Each field is clamped to its width, as in LogTimestamp::format
+			char str[LogTimestamp::length + 1];
+			snprintf(str, sizeof(str), "%02u/%02u/%04u - %02u:%02u:%02u.%03u",
+				(unsigned)tm.tm_mday % 100, (unsigned)(tm.tm_mon + 1) % 100, (unsigned)(tm.tm_year + 1900) % 10000,
+				(unsigned)tm.tm_hour % 100, (unsigned)tm.tm_min % 100, (unsigned)tm.tm_sec % 100, (unsigned)(ms % 1000) % 1000);
+
+			memcpy(buf, str, LogTimestamp::length);
+		}
+
+		/**
+		*	Same format of LogTimestamp (but UTC): only arithmetic is used, so that it can be called by the crash handler
+		*/
+		static void formatTimeUTC(long long ms, char* buf)
+		{
+			const long long seconds = (ms >= 0) ? ms / 1000 : 0;
+			const long long days = seconds / 86400;
+			const int secs = (int)(seconds % 86400);
+
+			// Days since 1970-01-01 to civil date (see http://howardhinnant.github.io/date_algorithms.html)
+			const long long z = days + 719468;
+			const long long era = z / 146097;
+			const unsigned int doe = (unsigned int)(z - era * 146097);
+			const unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+			const unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+			const unsigned int mp = (5 * doy + 2) / 153;
+			const unsigned int day = doy - (153 * mp + 2) / 5 + 1;
+			const unsigned int month = (mp < 10) ? mp + 3 : mp - 9;
+			const unsigned int year = (unsigned int)(yoe + era * 400) + ((month <= 2) ? 1 : 0);
+
+			formatDigits(buf, day, 2);
+			buf[2] = '/';
+			formatDigits(buf + 3, month, 2);
+			buf[5] = '/';
+			formatDigits(buf + 6, year, 4);
+			memcpy(buf + 10, " - ", 3);
+			formatDigits(buf + 13, secs / 3600, 2);
+			buf[15] = ':';
+			formatDigits(buf + 16, (secs / 60) % 60, 2);
+			buf[18] = ':';
+			formatDigits(buf + 19, secs % 60, 2);
+			buf[21] = '.';
+			formatDigits(buf + 22, (unsigned int)(ms % 1000), 3);
+		}
+
+		static void formatDigits(char* buf, unsigned int n, int width)
+		{
+			for (int i = width - 1; i >= 0; --i, n /= 10)
+				buf[i] = (char)('0' + n % 10);
+		}
+
+		std::atomic_ullong next_;
+		Record records_[records];
+	};
+
+	/**
+	*	!!! NOTE: It is static (zero initialised) so that it can be used before init and after deinit
+	*/
+	static LogRecentRing logrecent_;
+
+	/**
+	*	Last lines of the AD log file (only dumped by the crash handler)
+	*/
+	static LogRecentRing logrecentAD_;
+
+	/**
+	*	File the crash handler dumps the last log lines into (they would be lost otherwise,
+	*	together with the lines still queued for the LogHandler thread)
+	*
+	*	!!! NOTE: Only calls that are safe within a signal handler are used
+	*/
+	class CrashFile
+	{
+	public:
+		bool open(const char* path)
+		{
+#ifdef WIN32
+			handle_ = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+			return handle_ != INVALID_HANDLE_VALUE;
+#else
+			fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			return fd_ >= 0;
+#endif
+		}
+
+		void write(const char* data, std::size_t len)
+		{
+#ifdef WIN32
+			DWORD written;
+			WriteFile(handle_, data, (DWORD)len, &written, NULL);
+#else
+			while (len > 0)
+			{
+				const ssize_t written = ::write(fd_, data, len);
+				if (written <= 0)
+					return;
+
+				data += written;
+				len -= (std::size_t)written;
+			}
+#endif
+		}
+
+		void write(const char* str)
+		{
+			write(str, strlen(str));
+		}
+
+		void close()
+		{
+#ifdef WIN32
+			CloseHandle(handle_);
+#else
+			::close(fd_);
+#endif
+		}
+
+	private:
+#ifdef WIN32
+		HANDLE handle_;
+#else
+		int fd_;
+#endif
+	};
+
+	/**
+	*	Buffer used by the crash handler to format the lines (it must not allocate)
+	*/
+	static char crashBuffer[LogRecentRing::dumpBufferSize];
+
+	static std::atomic_flag crashDumping = ATOMIC_FLAG_INIT;
+
+	/**
+	*	Dump the last lines of both log files into the crash file (what is the code of the signal/exception)
+	*/
+	static void dumpCrash(const char* what, unsigned long code)
+	{
+		// Only the first crashing thread writes the file
+		if (crashDumping.test_and_set() || (crashPath[0] == '\0'))
+			return;
+
+		CrashFile file;
+		if (!file.open(crashPath))
+			return;
+
+		char hex[2 + 2 * sizeof(code) + 1];
+		hex[0] = '0';
+		hex[1] = 'x';
+		for (std::size_t i = 0; i < 2 * sizeof(code); ++i)
+			hex[2 + i] = "0123456789ABCDEF"[(code >> (4 * (2 * sizeof(code) - 1 - i))) & 0xF];
+		hex[sizeof(hex) - 1] = '\0';
+
+		file.write("Plugin crash (");
+		file.write(what);
+		file.write(" ");
+		file.write(hex);
+		file.write("), times are UTC\n\n");
+
+		file.write("*** ");
+		file.write(logSIP.c_str());
+		file.write("\n");
+		logrecent_.dump(file, crashBuffer);
+
+		file.write("\n*** ");
+		file.write(logAD.c_str());
+		file.write("\n");
+		logrecentAD_.dump(file, crashBuffer);
+
+		file.close();
+	}
+
+#ifdef WIN32
+	static LPTOP_LEVEL_EXCEPTION_FILTER crashPreviousFilter = NULL;
+
+	static LONG WINAPI crashExceptionFilter(EXCEPTION_POINTERS* info)
+	{
+		dumpCrash("exception", (info != NULL) ? info->ExceptionRecord->ExceptionCode : 0);
+
+		// The previous filter (e.g. the browser crash reporter) goes on handling the exception
+		if (crashPreviousFilter != NULL)
+			return crashPreviousFilter(info);
+
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+#else
+	static const int crashSignals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+	static const std::size_t crashSignalCount = sizeof(crashSignals) / sizeof(crashSignals[0]);
+	static struct sigaction crashPreviousActions[crashSignalCount];
+
+	static void crashSignalHandler(int sig, siginfo_t* info, void* /* context */)
+	{
+		dumpCrash("signal", (unsigned long)sig);
+
+		// The previous handler (e.g. the browser crash reporter) goes on handling the signal:
+		// a fault happens again as soon as the handler returns, other signals are raised again
+		for (std::size_t i = 0; i < crashSignalCount; ++i)
+		{
+			if (crashSignals[i] == sig)
+				sigaction(sig, &crashPreviousActions[i], NULL);
+		}
+
+		if ((info == NULL) || (info->si_code <= 0))
+			raise(sig);
+	}
+#endif
+
+	static bool crashHandlerInstalled = false;
+
+	/**
+	*	Install the crash handler (the previous one is called after dumping the crash file)
+	*/
+	static void installCrashHandler()
+	{
+		if (crashHandlerInstalled)
+			return;
+
+#ifdef WIN32
+		crashPreviousFilter = SetUnhandledExceptionFilter(crashExceptionFilter);
+#else
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = crashSignalHandler;
+		action.sa_flags = SA_SIGINFO;
+		sigemptyset(&action.sa_mask);
+
+		for (std::size_t i = 0; i < crashSignalCount; ++i)
+			sigaction(crashSignals[i], &action, &crashPreviousActions[i]);
+#endif
+
+		crashHandlerInstalled = true;
+	}
+
+	/**
+	*	Restore the previous crash handler (the plugin may be unloaded)
+	*
+	*	!!! NOTE: Only where ours is still installed: a handler installed after ours (which may be
+	*	calling ours in turn) is left in place
+	*/
+	static void uninstallCrashHandler()
+	{
+		if (!crashHandlerInstalled)
+			return;
+
+#ifdef WIN32
+		LPTOP_LEVEL_EXCEPTION_FILTER current = SetUnhandledExceptionFilter(crashPreviousFilter);
+		if (current != crashExceptionFilter)
+			SetUnhandledExceptionFilter(current);
+#else
+		for (std::size_t i = 0; i < crashSignalCount; ++i)
+		{
+			struct sigaction current;
+			if (sigaction(crashSignals[i], NULL, &current) != 0)
+				continue;
+
+			if ((current.sa_flags & SA_SIGINFO) && (current.sa_sigaction == crashSignalHandler))
+				sigaction(crashSignals[i], &crashPreviousActions[i], NULL);
+		}
+#endif
+
+		crashHandlerInstalled = false;
+	}
+
+	/**
+	*	Write the passed data into the SIP log file
+	*
+	*	Forward declaration that makes easier to use it into functions defined within the namespace
+	*	before its definition
+	*/
+	void writeLogSIPInternal(const char* data, int len);
+
+	/**
+	*	Write the passed data into the AD log file
+	*
+	*	The suppressCheckLogAD parameter is useful to avoid checking log size
+	*	and rotating logs doing logging caused by internal operations (e.g. uploading logs)
+	*
+	*	Forward declaration that makes easier to use it into functions defined within the namespace
+	*	before its definition
+	*/
+	void writeLogADInternal(const std::string& data, bool suppressCheckLogAD = true);
+
+	/**
+	*	Write a batch of lines formatted by formatLogSIP into the SIP log file
+	*
+	*	Forward declaration that makes easier to use it into functions defined within the namespace
+	*	before its definition
+	*/
+	void writeBatchSIPInternal(const std::string& batch);
+
+	/**
+	*	Write a batch of lines formatted by formatLogAD into the AD log file
+	*
+	*	Forward declaration that makes easier to use it into functions defined within the namespace
+	*	before its definition
+	*/
+	void writeBatchADInternal(const std::string& batch);
+
+	/**
+	*	Build the index of the rotated log files of logdir and queue the uncompressed ones
+	*	to the LogCompressor threads
+	*
+	*	Forward declaration that makes easier to use it into functions defined within the namespace
+	*	before its definition
+	*/
+	static void indexLogs();
+
+	/**
+	*	Ensure creation of the directory pointed by the logdir variable
+	*
+	*	!!! NOTE: This is only done when logdir is set, not for each written line
+	*/
+	static void makeLogDir()
+	{
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(logdir, ec);
+	}
+
+	bool setLogPathInternal(const std::string &logpath)
+	{
+		// The pending counts of repeated lines belong to the current log files
+		flushRepeated();
+
+		/**
+		*	Don't allow an empty logpath
+		*/
+
+		if (logpath.length() <= 0)
+		{
+			writeLogADInternal(" [PLUGIN] Log Path indicato vuoto. Attuale Log Path non modificato: (" + logdir + ")");
+
+			return false;
+		}
+
+		/**
+		*	Check if logdir is the same as logpath (XP_WIN: case insensitive)
+		*/
+
+		#if defined(XP_WIN)
+		// strcasecmp is only defined by POSIX, so this one must be used instead
+		if (_stricmp(logdir.c_str(), logpath.c_str()) == 0)
+		{
+			writeLogADInternal(" [PLUGIN] Log Path indicato identico. Attuale Log Path non modificato (" + logdir + ")");
+
+			return false;
+		}
+		#elif defined(XP_UNIX)
+		if (logdir.compare(logpath) == 0)
+		{
+			writeLogADInternal(" [PLUGIN] Log Path indicato identico. Attuale Log Path non modificato (" + logdir + ")");
+
+			return false;
+		}
+		#endif
+
+		//logging_initialised = false;
+
+		writeLogADInternal(" [PLUGIN] Log Path modificato: (" + logpath + ")");
+
+		/**
+		*	Update logdir
+		*/
+
+		logdir = logpath;
+
+		/**
+		*	Set new file paths
+		*/
+
+		setFilePaths();
+
+		makeLogDir();
+
+		indexLogs();
+
+		return true;
+	}
+
+	static bool existsFile(const std::string &filepath)
+	{
+		const std::fstream fs = std::fstream(filepath, std::ios::in);
+		const bool open = fs.is_open();
+		//fs.flush();
+		// !!! CHECK: Try not to close the stream and rely on the destructor to do it
+		//fs.close();
+		return open;
+	}
+
+	/**
+	*	Index of the rotated log files (full paths, oldest first)
+	*
+	*	logdir is scanned once (see indexLogs, called by init and setLogPath), then the index is kept
+	*	up to date when log files are rotated, compressed and removed: rotating never scans logdir.
+	*
+	*	!!! NOTE: The timestamp within the names makes the alphabetical order the chronological one
+	*/
+	class LogSegmentIndex
+	{
+	public:
+		/**
+		*	Replace the index with the rotated log files found in dir
+		*/
+		void rebuild(const std::string& dir)
+		{
+			static const boost::regex filter("^(PluginSIP|AgentDesktop)_.*\\.(log|zip)$");
+
+			Segments found[2];
+
+			boost::system::error_code ec;
+			boost::filesystem::directory_iterator end_itr; // Default ctor yields past-the-end
+			for (boost::filesystem::directory_iterator i(dir, ec); !ec && (i != end_itr); i.increment(ec))
+			{
+				// Skip if not a file
+				if (!boost::filesystem::is_regular_file(i->status())) continue;
+
+				const std::string name = i->path().filename().string();
+
+				// Skip if no match
+				boost::smatch match;
+				if (!boost::regex_match(name, match, filter)) continue;
+
+				// File matches, store it
+				Segments& segments = found[(match[1] == "PluginSIP") ? laneSIP : laneAD];
+				((match[2] == "zip") ? segments.compressed : segments.uncompressed).insert(i->path().string());
+			}
+
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			for (int lane = laneSIP; lane <= laneAD; ++lane)
+			{
+				segments_[lane].compressed.swap(found[lane].compressed);
+				segments_[lane].uncompressed.swap(found[lane].uncompressed);
+			}
+		}
+
+		/**
+		*	A log file was rotated
+		*/
+		void addUncompressed(bool sip, const std::string& path)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			segments_[sip ? laneSIP : laneAD].uncompressed.insert(path);
+		}
+
+		/**
+		*	A rotated log file was compressed (and removed)
+		*/
+		void setCompressed(bool sip, const std::string& logPath, const std::string& zipPath)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			Segments& segments = segments_[sip ? laneSIP : laneAD];
+
+			segments.uncompressed.erase(logPath);
+			segments.claimed.erase(logPath);
+			segments.compressed.insert(zipPath);
+		}
+
+		/**
+		*	Claim a rotated log file to compress it
+		*
+		*	False if it was already compressed, or is being compressed (by a LogCompressor thread or
+		*	by prepareZIP): the claim lasts until setCompressed, or release if compressing fails.
+		*/
+		bool claim(bool sip, const std::string& logPath)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			Segments& segments = segments_[sip ? laneSIP : laneAD];
+
+			if (segments.uncompressed.find(logPath) == segments.uncompressed.end())
+				return false;
+
+			return segments.claimed.insert(logPath).second;
+		}
+
+		void release(bool sip, const std::string& logPath)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			segments_[sip ? laneSIP : laneAD].claimed.erase(logPath);
+		}
+
+		/**
+		*	The oldest rotated log file, compressed or not (e.g. it failed to), if there are more than keep of them
+		*
+		*	It stays in the index until remove; an uncompressed one is also claimed meanwhile (so that no
+		*	LogCompressor thread starts compressing it), release it if it can't be removed. False if the
+		*	oldest one is being compressed: it is found by a later check, once compressed.
+		*/
+		bool oldest(bool sip, std::size_t keep, std::string& path)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			Segments& segments = segments_[sip ? laneSIP : laneAD];
+
+			if (segments.compressed.size() + segments.uncompressed.size() <= keep)
+				return false;
+
+			if (!segments.uncompressed.empty() &&
+				(segments.compressed.empty() || (*segments.uncompressed.begin() < *segments.compressed.begin())))
+			{
+				if (!segments.claimed.insert(*segments.uncompressed.begin()).second)
+					return false;
+
+				path = *segments.uncompressed.begin();
+			}
+			else
+			{
+				path = *segments.compressed.begin();
+			}
+
+			return true;
+		}
+
+		/**
+		*	A rotated log file was removed
+		*/
+		void remove(bool sip, const std::string& path)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			Segments& segments = segments_[sip ? laneSIP : laneAD];
+
+			segments.compressed.erase(path);
+			segments.uncompressed.erase(path);
+			segments.claimed.erase(path);
+		}
+
+		std::vector<std::string> compressed(bool sip)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			const std::set<std::string>& compressed = segments_[sip ? laneSIP : laneAD].compressed;
+
+			return std::vector<std::string>(compressed.begin(), compressed.end());
+		}
+
+		std::vector<std::string> uncompressed(bool sip)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			const std::set<std::string>& uncompressed = segments_[sip ? laneSIP : laneAD].uncompressed;
+
+			return std::vector<std::string>(uncompressed.begin(), uncompressed.end());
+		}
+
+	private:
+		// Ordered sets: the oldest file is the first one, finding and removing any file is O(log n)
+		struct Segments
+		{
+			std::set<std::string> compressed;
+			std::set<std::string> uncompressed;
+
+			// Uncompressed log files being compressed (or removed)
+			std::set<std::string> claimed;
+		};
+
+		std::mutex mutex_;
+
+		// Indexed by LogLane
+		Segments segments_[2];
+	};
+
+	static LogSegmentIndex logsegments_;
+
+	static void checkHistoricalLog(bool sip)
+	{
+		/* Check Storico */
+		std::string path;
+		boost::system::error_code ec;
+
+		while (logsegments_.oldest(sip, logNumber, path))
+		{
+			if (std::remove(path.c_str()) == 0)
+			{
+				writeLogADInternal(" [PLUGIN] Removed: " + path);
+			}
+			else if (boost::filesystem::exists(path, ec) || ec)
+			{
+				// !!! NOTE: A file that can't be removed now (e.g. being uploaded) stays in the index: the next check retries
+				writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile rimuovere il file " + path);
+				logsegments_.release(sip, path);
+				break;
+			}
+
+			logsegments_.remove(sip, path);
+		}
+	}
+
+	static void checkHistoricalLogSIP() {
+		writeLogADInternal(" [PLUGIN] Check Historical Log SIP");
+
+		checkHistoricalLog(true);
+	}
+
+	static void checkHistoricalLogAD()
+	{
+		writeLogADInternal(" [PLUGIN] Check Historical Log AD");
+
+		checkHistoricalLog(false);
+	}
+
+	/**
+	*	Compress a rotated log file into a zip file with the same name, then remove it
+	*
+	*	The zip file is written under a temporary name, so that a partially written one is never
+	*	counted (or uploaded) as a compressed log file.
+	*
+	*	!!! NOTE: The caller must have claimed logPath (see LogSegmentIndex::claim)
+	*/
+	static bool compressLog(const std::string& logPath, bool sip)
+	{
+		const std::string zipPath = logPath.substr(0, logPath.size() - extensionLOG.size()) + extensionZIP;
+		const std::string tmpPath = zipPath + ".tmp";
+		const std::string name = boost::filesystem::path(logPath).filename().string();
+
+		// A partially written one may be left by a previous run
+		std::remove(tmpPath.c_str());
+
+		std::string error;
+		if (!zipLogFile(tmpPath, logPath, name, (LogCompression)logCompression.load(), logCompressionLevel.load(), error))
+		{
+			writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile comprimere il file " + logPath + ": " + error);
+
+			std::remove(tmpPath.c_str());
+			logsegments_.release(sip, logPath);
+
+			return false;
+		}
+
+		boost::system::error_code ec;
+		boost::filesystem::rename(tmpPath, zipPath, ec);
+		if (ec)
+		{
+			writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile rinominare il file " + tmpPath + ": " + ec.message());
+
+			std::remove(tmpPath.c_str());
+			logsegments_.release(sip, logPath);
+
+			return false;
+		}
+
+		std::remove(logPath.c_str());
+
+		logsegments_.setCompressed(sip, logPath, zipPath);
+
+		return true;
+	}
+
+	/**
+	*	Threads compressing the rotated log files as soon as they are rotated
+	*
+	*	They run with a low priority, so that compressing never competes with the calls
+	*	and the logging thread. Log files still uncompressed when the threads stop are
+	*	compressed the next time they start (see ScheduleUncompressed).
+	*
+	*	logCompressorThreads files are compressed at the same time (see test/LogCompressorBench).
+	*/
+	class LogCompressor
+	{
+	public:
+		~LogCompressor()
+		{
+			Stop();
+		}
+
+		// Start the threads
+		bool Start()
+		{
+			return Start(logCompressorThreads);
+		}
+
+		// Start count threads (see test/LogCompressorBench)
+		bool Start(unsigned int count)
+		{
+			std::lock_guard<std::mutex> lock(general_mutex_);
+
+			if (!threads_.empty()) {
+				return false;
+			}
+
+			{
+				std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+
+				stop_flag_ = false;
+				busy_ = 0;
+			}
+
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				threads_.push_back(std::unique_ptr<std::thread>(new std::thread(
+					[ this ] {
+					LogCompressorThread();
+				})));
+			}
+
+			return true;
+		}
+
+		// Stop the threads after the log files being compressed (if any) and wait for their termination
+		void Stop()
+		{
+			std::lock_guard<std::mutex> lock(general_mutex_);
+
+			if (!threads_.empty()) {
+				{
+					std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+
+					stop_flag_ = true;
+					queue_.clear();
+				}
+				condvar_.notify_all();
+
+				for (std::size_t i = 0; i < threads_.size(); ++i)
+					threads_[i]->join();
+				threads_.clear();
+			}
+		}
+
+		/**
+		*	Queue a rotated log file to be compressed
+		*
+		*	Return false if the threads are not running
+		*/
+		bool Push(const std::string& logPath, bool sip)
+		{
+			{
+				std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+
+				if (stop_flag_)
+					return false;
+
+				queue_.push_back(Segment(logPath, sip));
+			}
+			condvar_.notify_all();
+
+			return true;
+		}
+
+		/**
+		*	Queue the indexed log files still uncompressed
+		*	(left by a previous run, or found in a new logdir)
+		*/
+		void ScheduleUncompressed()
+		{
+			const std::vector<std::string>& logSIP = logsegments_.uncompressed(true);
+			for (std::size_t i = 0; i < logSIP.size(); ++i)
+				Push(logSIP[i], true);
+
+			const std::vector<std::string>& logAD = logsegments_.uncompressed(false);
+			for (std::size_t i = 0; i < logAD.size(); ++i)
+				Push(logAD[i], false);
+		}
+
+		/**
+		*	Wait until all the queued log files are compressed
+		*
+		*	Return false if the threads are not running
+		*/
+		bool WaitIdle()
+		{
+			std::unique_lock<std::mutex> queue_lock(queue_mutex_);
+
+			if (stop_flag_)
+				return false;
+
+			condvar_.wait(queue_lock, [ this ] { return stop_flag_ || (queue_.empty() && (busy_ == 0)); });
+
+			return !stop_flag_;
+		}
+
+	private:
+		struct Segment
+		{
+			Segment(const std::string& path, bool sip) : path(path), sip(sip) {}
+
+			std::string path;
+			bool sip;
+		};
+
+		// Private function that runs in a separate thread
+		void LogCompressorThread()
+		{
+			#if defined(WIN32)
+			// Lowers the I/O priority too
+			SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+			#elif defined(__linux__)
+			setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+			#endif
+
+			std::unique_lock<std::mutex> queue_lock(queue_mutex_);
+
+			for (;;)
+			{
+				condvar_.wait(queue_lock, [ this ] { return stop_flag_ || !queue_.empty(); });
+
+				if (stop_flag_)
+					break;
+
+				const Segment segment = queue_.front();
+				queue_.pop_front();
+				++busy_;
+
+				queue_lock.unlock();
+
+				// Skipped if prepareZIP (or another thread, if it was queued twice) is compressing it
+				if (logsegments_.claim(segment.sip, segment.path) && compressLog(segment.path, segment.sip))
+				{
+					// Only compressed log files are counted (one thread at a time removes the exceeding ones)
+					std::lock_guard<std::mutex> historical_lock(historical_mutex_);
+
+					if (segment.sip)
+						checkHistoricalLogSIP();
+					else
+						checkHistoricalLogAD();
+				}
+
+				queue_lock.lock();
+
+				--busy_;
+
+				// Wake up WaitIdle
+				condvar_.notify_all();
+			}
+		}
+
+		/**
+		*	Mutex to serialize access to the threads_ member
+		*/
+		std::mutex general_mutex_;
+
+		/**
+		*	Mutex to serialize the removal of the exceeding compressed log files
+		*/
+		std::mutex historical_mutex_;
+
+		/**
+		*	Mutex protecting the following members
+		*/
+		std::mutex queue_mutex_;
+		std::condition_variable condvar_;
+		std::deque<Segment> queue_;
+		bool stop_flag_ = true;
+
+		// Number of files being compressed
+		unsigned int busy_ = 0;
+
+		std::vector<std::unique_ptr<std::thread> > threads_;
+	};
+
+	static LogCompressor logcompressor_;
+
+	static void indexLogs()
+	{
+		logsegments_.rebuild(logdir);
+
+		logcompressor_.ScheduleUncompressed();
+	}
+
+	/**
+	*	Path to rotate a log file to (name is the prefix followed by the date)
+	*
+	*	A file rotated within the same second as the previous one gets a numbered name,
+	*	else it would overwrite it (or its zip file, if it has already been compressed)
+	*/
+	static std::string rotatedLogPath(const std::string& name)
+	{
+		std::string path = logdir + name;
+
+		boost::system::error_code ec;
+		for (int i = 1; boost::filesystem::exists(path + extensionLOG, ec) || boost::filesystem::exists(path + extensionZIP, ec); ++i)
+			path = logdir + name + "_" + boost::lexical_cast<std::string>(i);
+
+		return path + extensionLOG;
+	}
+
+	/**
+	*	Hand a just rotated log file to the LogCompressor threads
+	*/
+	static void scheduleCompression(const std::string& logPath, bool sip)
+	{
+		logsegments_.addUncompressed(sip, logPath);
+
+		if (!logcompressor_.Push(logPath, sip))
+		{
+			// It will be compressed when the LogCompressor threads start again
+			if (sip)
+				checkHistoricalLogSIP();
+			else
+				checkHistoricalLogAD();
+		}
+	}
+
+	static void checkLogSIP()
+	{
+		/*
+		*	Controllo della dimensione del SIP log file (tenuta in memoria);
+		*	se ha superato quella massima, viene rinominato e viene effettuata l'archiviazione
+		*/
+		if (logFileSIP.size() >= (static_cast<boost::uintmax_t>(logDimension) * 1024 * 1024))
+		{
+			const std::string logPath = rotatedLogPath(createDateLogSIP());
+
+			/* Compressione e Check Storico */
+			if (logFileSIP.rotate(logPath))
+				scheduleCompression(logPath, true);
+		}
+	}
+
+	static void checkLogAD()
+	{
+		/*
+		*	Controllo della dimensione del AD log file (tenuta in memoria);
+		*	se ha superato quella massima, viene rinominato e viene effettuata l'archiviazione
+		*/
+		if (logFileAD.size() >= (static_cast<boost::uintmax_t>(logDimension) * 1024 * 1024))
+		{
+			const std::string logPath = rotatedLogPath(createDateLogAD());
+			/* Compressione e Check Storico */
+			if (logFileAD.rotate(logPath))
+				scheduleCompression(logPath, false);
+		}
+	}
+
+	/**
+	*	Compress the indexed log files still uncompressed
+	*
+	*	Return the ones that can't be compressed (the ones a LogCompressor thread is compressing
+	*	meanwhile, e.g. just rotated by the logging thread, are skipped: they are not uploaded now)
+	*/
+	static std::vector<std::string> compressLogs(bool sip)
+	{
+		const std::vector<std::string>& files = logsegments_.uncompressed(sip);
+		std::vector<std::string> failed;
+
+		for (std::size_t i = 0; i < files.size(); ++i)
+		{
+			if (!logsegments_.claim(sip, files[i]))
+				continue;
+
+			if (!compressLog(files[i], sip))
+				failed.push_back(files[i]);
+		}
+
+		return failed;
+	}
+
+	/**
+	*	Rotate the current log files and wait for all the rotated ones to be compressed
+	*
+	*	Return the (full paths of the) files to be uploaded
+	*/
+	static std::vector<std::string> prepareZIP()
+	{
+		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Inizio prepareZIP");
+
+		/*
+		 * Rename del file di log corrente
+		 */
+
+		/**
+		*	Use a common timestamp for all files
+		*/
+		std::string thisDateLog = createDateLog("");
+
+		/* Log PluginSIP */
+		if (existsFile(filepathSIP))
+		{
+			const std::string logPathSIP = rotatedLogPath(nameSIP + thisDateLog /* createDateLogSIP() */);
+
+			if (logFileSIP.rotate(logPathSIP))
+			{
+				logsegments_.addUncompressed(true, logPathSIP);
+				logcompressor_.Push(logPathSIP, true);
+			}
+		}
+
+		/* Log AD */
+		if (existsFile(filepathAD))
+		{
+			const std::string logPathAD = rotatedLogPath(nameAD + thisDateLog /* createDateLogAD() */);
+
+			if (logFileAD.rotate(logPathAD))
+			{
+				logsegments_.addUncompressed(false, logPathAD);
+				logcompressor_.Push(logPathAD, false);
+			}
+		}
+
+		/*
+		 * Compressione dei file di log ruotati
+		 *
+		 * !!! NOTE: Normally the LogCompressor threads already did it; what is left (the threads
+		 * are not running or failed) is compressed here, or uploaded as it is
+		 */
+
+		writeLogADInternal(" [PLUGIN] Attesa compressione file di log");
+
+		logcompressor_.WaitIdle();
+
+		const std::vector<std::string>& uncompressedSIP = compressLogs(true);
+		const std::vector<std::string>& uncompressedAD = compressLogs(false);
+
+		/*
+		 * Costruzione dell'elenco dei file da zippare
+		 */
+
+		std::vector<std::string> files = logsegments_.compressed(true);
+
+		const std::vector<std::string>& logAD = logsegments_.compressed(false);
+		files.insert(files.end(), logAD.begin(), logAD.end());
+		files.insert(files.end(), uncompressedSIP.begin(), uncompressedSIP.end());
+		files.insert(files.end(), uncompressedAD.begin(), uncompressedAD.end());
+
+		// The crash file (if the plugin crashed) is uploaded as it is
+		if (existsFile(filepathCrash))
+			files.push_back(filepathCrash);
+
+		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Fine prepareZIP");
+
+		return files;
+	}
+
+	/**
+	*	State of the running upload (there is at most one: see startUpload)
+	*
+	*	It is only used by the upload thread, except for cancel.
+	*/
+	class LogUpload
+	{
+	public:
+		LogUpload()
+			: cancel_(false), total_(0), base_(0), tokens_(0), pacing_(false)
+		{
+		}
+
+		void begin(const LogSenderCallbacks& callbacks)
+		{
+			callbacks_ = callbacks;
+			cancel_.store(false);
+			total_ = 0;
+			base_ = 0;
+			reported_ = std::chrono::steady_clock::time_point();
+			pacing_ = false;
+		}
+
+		/**
+		*	Return the callbacks of the upload (to notify its completion), forgetting them
+		*/
+		LogSenderCallbacks end()
+		{
+			LogSenderCallbacks callbacks;
+			std::swap(callbacks, callbacks_);
+			return callbacks;
+		}
+
+		// Bytes to be sent by the whole upload
+		void setTotal(boost::uintmax_t total)
+		{
+			total_ = total;
+		}
+
+		// Bytes sent by a completed request (an incremental upload sends one request per chunk)
+		void addSent(boost::uintmax_t sent)
+		{
+			base_ += sent;
+		}
+
+		void cancel()
+		{
+			cancel_.store(true);
+		}
+
+		bool cancelled() const
+		{
+			return cancel_.load();
+		}
+
+		/**
+		*	How many of len bytes a read callback may send now
+		*
+		*	While any call has active media, wait to keep the data within logUploadRateCall
+		*	(at most 100 ms of data at a time, so that curl doesn't send it in bursts).
+		*	Return 0 if the upload is cancelled.
+		*/
+		std::size_t pace(std::size_t len)
+		{
+			while (!cancelled())
+			{
+				const unsigned long rate = logUploadRateCall.load();
+
+				if ((rate == 0) || (callsMediaActive.load() <= 0))
+				{
+					pacing_ = false;
+					return len;
+				}
+
+				const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				const double burst = std::max(rate / 10.0, 1.0);
+
+				if (!pacing_)
+				{
+					pacing_ = true;
+					tokens_ = burst;
+				}
+				else
+				{
+					tokens_ = std::min(burst, tokens_ + rate * std::chrono::duration<double>(now - paced_).count());
+				}
+
+				paced_ = now;
+
+				if (tokens_ >= 1.0)
+				{
+					const std::size_t n = std::min(len, (std::size_t)tokens_);
+					tokens_ -= n;
+					return n;
+				}
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			}
+
+			return 0;
+		}
+
+		/**
+		*	CURLOPT_XFERINFOFUNCTION callback (userdata is the LogUpload)
+		*
+		*	Report the progress (at most every 500 ms) and abort the transfer if the upload is cancelled
+		*/
+		static int curlProgress(void* userdata, curl_off_t /* dltotal */, curl_off_t /* dlnow */, curl_off_t /* ultotal */, curl_off_t ulnow)
+		{
+			LogUpload* upload = static_cast<LogUpload*>(userdata);
+
+			if (upload->cancelled())
+				return 1;
+
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+			if (upload->callbacks_.onProgress && (now - upload->reported_ >= std::chrono::milliseconds(500)))
+			{
+				upload->reported_ = now;
+				upload->callbacks_.onProgress(upload->base_ + ulnow, upload->total_);
+			}
+
+			return 0;
+		}
+
+	private:
+		LogSenderCallbacks callbacks_;
+		std::atomic_bool cancel_;
+
+		boost::uintmax_t total_;
+		boost::uintmax_t base_;
+		std::chrono::steady_clock::time_point reported_;
+
+		// Bytes that can be sent right now while pacing (refilled at logUploadRateCall)
+		double tokens_;
+		bool pacing_;
+		std::chrono::steady_clock::time_point paced_;
+	};
+
+	static LogUpload logupload_;
+
+	/**
+	*	Options common to all the upload requests: progress, cancel and rate cap
+	*/
+	static void setUploadOptions(CURL* easyhandle)
+	{
+		curl_easy_setopt(easyhandle, CURLOPT_NOPROGRESS, 0L);
+		curl_easy_setopt(easyhandle, CURLOPT_XFERINFOFUNCTION, LogUpload::curlProgress);
+		curl_easy_setopt(easyhandle, CURLOPT_XFERINFODATA, &logupload_);
+
+		const unsigned long rate = logUploadRate.load();
+		if (rate > 0)
+			curl_easy_setopt(easyhandle, CURLOPT_MAX_SEND_SPEED_LARGE, (curl_off_t)rate);
+	}
+
+	/**
+	*	CRC-32 (as used by zip files) of data, continuing the one of the preceding data
+	*/
+	static unsigned long crc32Update(unsigned long crc, const unsigned char* data, std::size_t len)
+	{
+		static const struct Table
+		{
+			Table()
+			{
+				for (unsigned long i = 0; i < 256; ++i)
+				{
+					unsigned long c = i;
+					for (int k = 0; k < 8; ++k)
+						c = (c & 1) ? (0xEDB88320UL ^ (c >> 1)) : (c >> 1);
+					values[i] = c;
+				}
+			}
+
+			unsigned long values[256];
+		} table;
+
+		crc = crc ^ 0xFFFFFFFFUL;
+		while (len-- > 0)
+			crc = table.values[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+		return crc ^ 0xFFFFFFFFUL;
+	}
+
+	/**
+	*	Move to offset from the beginning of file (!!! NOTE: fseek takes a long, 32 bits on Windows)
+	*/
+	static bool seekFile(FILE* file, boost::uintmax_t offset)
+	{
+		#if defined(WIN32)
+		return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+		#else
+		return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+		#endif
+	}
+
+	/**
+	*	Size and CRC-32 of the whole file, leaving it positioned at its beginning
+	*/
+	static bool fileCrc32(FILE* file, boost::uintmax_t& size, unsigned long& crc)
+	{
+		std::vector<unsigned char> buffer(64 * 1024);
+		std::size_t n;
+
+		size = 0;
+		crc = 0;
+
+		while ((n = fread(&buffer[0], 1, buffer.size(), file)) > 0)
+		{
+			crc = crc32Update(crc, &buffer[0], n);
+			size += n;
+		}
+
+		return !ferror(file) && (fseek(file, 0, SEEK_SET) == 0);
+	}
+
+	/**
+	*	Zip archive of log files, produced while it is uploaded (see sendZip)
+	*
+	*	Files are stored as they are (the rotated log files are already compressed), so the size
+	*	of the archive is known in advance and just the headers of one file at a time are kept
+	*	in memory. Each file is opened by add and kept open until the archive is destroyed,
+	*	so that removing it meanwhile doesn't change the archive.
+	*
+	*	ZIP64 records are only written where the zip fields can't hold a size or an offset
+	*	(4 GB or more), or the number of entries (65535 or more): smaller archives are
+	*	the same as before.
+	*/
+	class LogArchiveStream
+	{
+	public:
+		LogArchiveStream()
+			: offset_(0), centralSize_(0), entry_(0), dataLeft_(0), pendingPos_(0), finished_(false), failed_(false)
+		{
+		}
+
+		~LogArchiveStream()
+		{
+			for (std::size_t i = 0; i < entries_.size(); ++i)
+				fclose(entries_[i].file);
+		}
+
+		/**
+		*	Add a file to the archive (to be called before reading it)
+		*/
+		bool add(const std::string& path, const std::string& name)
+		{
+			Entry entry;
+			entry.name = name;
+			entry.size = 0;
+			entry.crc = 0;
+			entry.offset = offset_;
+
+			entry.file = fopen(path.c_str(), "rb");
+			if (entry.file == NULL)
+				return false;
+
+			// The CRC goes into the header that precedes the data
+			if (!fileCrc32(entry.file, entry.size, entry.crc) || (name.size() > 0xFFFF))
+			{
+				fclose(entry.file);
+				return false;
+			}
+
+			const boost::uintmax_t localSize = localHeaderSize + name.size() + localExtraSize(entry) + entry.size;
+			const boost::uintmax_t centralSize = centralHeaderSize + name.size() + centralExtraSize(entry);
+
+			boost::system::error_code ec;
+			std::time_t t = boost::filesystem::last_write_time(path, ec);
+			if (ec)
+				t = std::time(NULL);
+
+			std::tm tm;
+			localTime(t, tm);
+
+			entry.dosTime = (unsigned int)((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+			entry.dosDate = (unsigned int)(((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+
+			offset_ += localSize;
+			centralSize_ += centralSize;
+
+			entries_.push_back(entry);
+
+			return true;
+		}
+
+		/**
+		*	Total size of the archive
+		*/
+		boost::uintmax_t size() const
+		{
+			return offset_ + centralSize_ + (zip64End() ? zip64EndHeaderSize + zip64LocatorSize : 0) + endHeaderSize;
+		}
+
+		/**
+		*	Copy the next part of the archive into buffer
+		*
+		*	Return 0 at the end of the archive (or if a file can't be read anymore: see failed)
+		*/
+		std::size_t read(char* buffer, std::size_t len)
+		{
+			std::size_t done = 0;
+
+			while ((done < len) && !failed_)
+			{
+				if (pendingPos_ < pending_.size())
+				{
+					const std::size_t n = std::min(len - done, pending_.size() - pendingPos_);
+					memcpy(buffer + done, pending_.data() + pendingPos_, n);
+					pendingPos_ += n;
+					done += n;
+				}
+				else if (dataLeft_ > 0)
+				{
+					const std::size_t n = fread(buffer + done, 1, (std::size_t)std::min<boost::uintmax_t>(len - done, dataLeft_), entries_[entry_ - 1].file);
+					if (n == 0)
+					{
+						failed_ = true;
+						break;
+					}
+
+					dataLeft_ -= n;
+					done += n;
+				}
+				else if (entry_ < entries_.size())
+				{
+					pending_.clear();
+					pendingPos_ = 0;
+
+					appendLocalHeader(entries_[entry_]);
+					dataLeft_ = entries_[entry_].size;
+					++entry_;
+				}
+				else if (!finished_)
+				{
+					pending_.clear();
+					pendingPos_ = 0;
+
+					appendCentralDirectory();
+					finished_ = true;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			return done;
+		}
+
+		bool failed() const
+		{
+			return failed_;
+		}
+
+		/**
+		*	CURLOPT_READFUNCTION callback (userdata is the LogArchiveStream)
+		*/
+		static size_t curlRead(char* buffer, size_t size, size_t nitems, void* userdata)
+		{
+			LogArchiveStream* archive = static_cast<LogArchiveStream*>(userdata);
+
+			const std::size_t len = logupload_.pace(size * nitems);
+			if (len == 0)
+				return CURL_READFUNC_ABORT;
+
+			const std::size_t n = archive->read(buffer, len);
+
+			return archive->failed() ? CURL_READFUNC_ABORT : n;
+		}
+
+	private:
+		static const std::size_t localHeaderSize = 30;
+		static const std::size_t centralHeaderSize = 46;
+		static const std::size_t endHeaderSize = 22;
+		static const std::size_t zip64EndHeaderSize = 56;
+		static const std::size_t zip64LocatorSize = 20;
+
+		/**
+		*	Values from these on are stored into the ZIP64 records (the zip field is set to the maximum)
+		*/
+		static const boost::uintmax_t max16 = 0xFFFF;
+		static const boost::uintmax_t max32 = 0xFFFFFFFF;
+
+		struct Entry
+		{
+			FILE* file;
+			std::string name;
+			boost::uintmax_t size;
+			boost::uintmax_t offset;
+			unsigned long crc;
+			unsigned int dosTime;
+			unsigned int dosDate;
+		};
+
+		void put16(unsigned long value)
+		{
+			pending_.push_back((char)(value & 0xFF));
+			pending_.push_back((char)((value >> 8) & 0xFF));
+		}
+
+		void put32(unsigned long value)
+		{
+			put16(value & 0xFFFF);
+			put16((value >> 16) & 0xFFFF);
+		}
+
+		void put64(boost::uintmax_t value)
+		{
+			put32((unsigned long)(value & 0xFFFFFFFF));
+			put32((unsigned long)((value >> 32) & 0xFFFFFFFF));
+		}
+
+		/**
+		*	The 16 (32) bits value, or the maximum if it goes into a ZIP64 record
+		*/
+		void put16Or64(boost::uintmax_t value)
+		{
+			put16((unsigned long)std::min<boost::uintmax_t>(value, max16));
+		}
+
+		void put32Or64(boost::uintmax_t value)
+		{
+			put32((unsigned long)std::min<boost::uintmax_t>(value, max32));
+		}
+
+		/**
+		*	Size of the ZIP64 extra field of the local header: both sizes, if the entry needs it
+		*/
+		static std::size_t localExtraSize(const Entry& entry)
+		{
+			return (entry.size >= max32) ? 4 + 16 : 0;
+		}
+
+		/**
+		*	Size of the ZIP64 extra field of the central header: just the values that don't fit
+		*/
+		static std::size_t centralExtraSize(const Entry& entry)
+		{
+			const std::size_t values = ((entry.size >= max32) ? 2 : 0) + ((entry.offset >= max32) ? 1 : 0);
+
+			return (values > 0) ? 4 + 8 * values : 0;
+		}
+
+		/**
+		*	Whether the ZIP64 end of central directory record (and its locator) is needed
+		*/
+		bool zip64End() const
+		{
+			return (entries_.size() >= max16) || (centralSize_ >= max32) || (offset_ >= max32);
+		}
+
+		void appendLocalHeader(const Entry& entry)
+		{
+			const std::size_t extraSize = localExtraSize(entry);
+
+			put32(0x04034b50);					// Signature
+			put16((extraSize > 0) ? 45 : 10);	// Version needed to extract (4.5 for ZIP64, else 1.0)
+			put16(0);							// Flags
+			put16(0);							// Compression method (stored)
+			put16(entry.dosTime);
+			put16(entry.dosDate);
+			put32(entry.crc);
+			put32Or64(entry.size);				// Compressed size
+			put32Or64(entry.size);				// Uncompressed size
+			put16((unsigned long)entry.name.size());
+			put16((unsigned long)extraSize);	// Extra field length
+			pending_.append(entry.name);
+
+			if (extraSize > 0)
+			{
+				put16(0x0001);					// ZIP64 extended information
+				put16(16);
+				put64(entry.size);				// Uncompressed size
+				put64(entry.size);				// Compressed size
+			}
+		}
+
+		void appendCentralDirectory()
+		{
+			for (std::size_t i = 0; i < entries_.size(); ++i)
+			{
+				const Entry& entry = entries_[i];
+				const std::size_t extraSize = centralExtraSize(entry);
+
+				put32(0x02014b50);					// Signature
+				put16((extraSize > 0) ? 45 : 20);	// Version made by (MS-DOS, 4.5 for ZIP64, else 2.0)
+				put16((extraSize > 0) ? 45 : 10);	// Version needed to extract (4.5 for ZIP64, else 1.0)
+				put16(0);							// Flags
+				put16(0);							// Compression method (stored)
+				put16(entry.dosTime);
+				put16(entry.dosDate);
+				put32(entry.crc);
+				put32Or64(entry.size);				// Compressed size
+				put32Or64(entry.size);				// Uncompressed size
+				put16((unsigned long)entry.name.size());
+				put16((unsigned long)extraSize);	// Extra field length
+				put16(0);							// File comment length
+				put16(0);							// Disk number start
+				put16(0);							// Internal file attributes
+				put32(0);							// External file attributes
+				put32Or64(entry.offset);			// Offset of the local header
+				pending_.append(entry.name);
+
+				if (extraSize > 0)
+				{
+					// Only the values set to the maximum above, in this order
+					put16(0x0001);					// ZIP64 extended information
+					put16((unsigned long)(extraSize - 4));
+
+					if (entry.size >= max32)
+					{
+						put64(entry.size);			// Uncompressed size
+						put64(entry.size);			// Compressed size
+					}
+
+					if (entry.offset >= max32)
+						put64(entry.offset);		// Offset of the local header
+				}
+			}
+
+			if (zip64End())
+			{
+				put32(0x06064b50);					// ZIP64 end of central directory signature
+				put64(zip64EndHeaderSize - 12);		// Size of the rest of the record
+				put16(45);							// Version made by (MS-DOS, 4.5)
+				put16(45);							// Version needed to extract (4.5)
+				put32(0);							// Number of this disk
+				put32(0);							// Disk where the central directory starts
+				put64(entries_.size());				// Entries on this disk
+				put64(entries_.size());				// Total entries
+				put64(centralSize_);				// Size of the central directory
+				put64(offset_);						// Offset of the central directory
+
+				put32(0x07064b50);					// ZIP64 end of central directory locator signature
+				put32(0);							// Disk where the ZIP64 end record is
+				put64(offset_ + centralSize_);		// Offset of the ZIP64 end record
+				put32(1);							// Total number of disks
+			}
+
+			put32(0x06054b50);						// Signature
+			put16(0);								// Number of this disk
+			put16(0);								// Disk where the central directory starts
+			put16Or64(entries_.size());				// Entries on this disk
+			put16Or64(entries_.size());				// Total entries
+			put32Or64(centralSize_);				// Size of the central directory
+			put32Or64(offset_);						// Offset of the central directory
+			put16(0);								// Comment length
+		}
+
+		std::vector<Entry> entries_;
+
+		// Offset of the central directory (the size of the local headers and data)
+		boost::uintmax_t offset_;
+		boost::uintmax_t centralSize_;
+
+		// Next entry to be read
+		std::size_t entry_;
+
+		// Data of the current entry not yet read
+		boost::uintmax_t dataLeft_;
+
+		// Header(s) being read
+		std::string pending_;
+		std::size_t pendingPos_;
+
+		bool finished_;
+		bool failed_;
+	};
+
+	/**
+	*	CURLOPT_WRITEFUNCTION callback ignoring the response body
+	*/
+	static size_t discardResponse(char* /* buffer */, size_t size, size_t nitems, void* /* userdata */)
+	{
+		return size * nitems;
+	}
+
+	/**
+	*	Log the error (if any) of an upload request and describe it in error
+	*/
+	static bool checkUploadResult(const std::string& url, CURLcode result, long status, std::string& error)
+	{
+		if (result != CURLE_OK)
+		{
+			error = logupload_.cancelled() ? std::string("cancelled") : std::string(curl_easy_strerror(result));
+
+			writeLogADInternal(" [PLUGIN] [ERROR] Errore nell'upload di " + url + ": " + boost::lexical_cast<std::string>(result) + " " + curl_easy_strerror(result));
+
+			return false;
+		}
+
+		if ((status < 200) || (status > 299))
+		{
+			error = "HTTP " + boost::lexical_cast<std::string>(status);
+
+			writeLogADInternal(" [PLUGIN] [ERROR] Errore nell'upload di " + url + ": HTTP " + boost::lexical_cast<std::string>(status));
+
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	*	Upload all the log files to url as a single zip archive
+	*
+	*	Return false (and the reason in error) if the upload fails or is cancelled
+	*/
+	static bool sendZip(const std::string& url, std::string& error)
+	{
+		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Inizio sendZip");
+
+		writeLogADInternal(" [PLUGIN] Upload URL: " + url);
+
+		/* Preparazione dei file da uplodare */
+		const std::vector<std::string>& files = prepareZIP();
+
+		bool ok = false;
+
+		/*
+		 * Creazione dello stream per l'invio dei file
+		 *
+		 * !!! NOTE: The zip archive is produced while it is uploaded (no temporary file)
+		 */
+		writeLogADInternal(" [PLUGIN] Creazione dello stream per l'upload dei file");
+
+		{
+			LogArchiveStream archive;
+
+			for (std::size_t i = 0; i < files.size(); ++i)
+			{
+				if (!archive.add(files[i], boost::filesystem::path(files[i]).filename().string()))
+				{
+					writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile aggiungere il file " + files[i] + " all'upload");
+				}
+			}
+
+			logupload_.setTotal(archive.size());
+
+			/* Preparazione del file da inviare */
+			writeLogADInternal(" [PLUGIN] Preparazione del file da inviare (" + boost::lexical_cast<std::string>(archive.size()) + " bytes)");
+
+			struct curl_slist *headers = NULL;
+
+			CURL *easyhandle = curl_easy_init();
+			if (easyhandle != NULL)
+			{
+				/* Progress, cancel e limite di banda */
+				setUploadOptions(easyhandle);
+
+				/* Abilito Upload (PUT) */
+				curl_easy_setopt(easyhandle, CURLOPT_UPLOAD, 1L);
+
+				/* URL */
+				curl_easy_setopt(easyhandle, CURLOPT_URL, url.c_str());
+
+				/* Set Content Type Header */
+				headers = curl_slist_append(headers, "Content-Type: application/zip");
+
+				/* Set the name the zip file had when it was written to disk */
+				const std::string disposition = "Content-Disposition: attachment; filename=\"" + createDateLogZIP().substr(1) + extensionZIP + "\"";
+				headers = curl_slist_append(headers, disposition.c_str());
+
+				/* Layout of the archive */
+				headers = curl_slist_append(headers, logArchiveFormatHeader.c_str());
+
+				curl_easy_setopt(easyhandle, CURLOPT_HTTPHEADER, headers);
+
+				/* Lo zip viene prodotto durante l'invio */
+				curl_easy_setopt(easyhandle, CURLOPT_READFUNCTION, LogArchiveStream::curlRead);
+				curl_easy_setopt(easyhandle, CURLOPT_READDATA, &archive);
+
+				/* Indico dimensione del file (nota in anticipo) */
+				curl_easy_setopt(easyhandle, CURLOPT_INFILESIZE_LARGE, (curl_off_t)archive.size());
+
+				/* Ignore the response body */
+				curl_easy_setopt(easyhandle, CURLOPT_WRITEFUNCTION, discardResponse);
+
+				/* Disable SSL certificates checking */
+				curl_easy_setopt(easyhandle, CURLOPT_SSL_VERIFYPEER, 0L);
+			}
+			else
+			{
+				writeLogADInternal(" [PLUGIN] [ERROR] curl_easy_init fallita");
+
+				writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Fine sendZip");
+
+				error = "curl_easy_init failed";
+
+				return false;
+			}
+
+			/* Invio File */
+			writeLogADInternal(" [PLUGIN] Upload File @ " + url);
+
+			CURLcode result = curl_easy_perform(easyhandle);
+
+			long status = 0;
+			curl_easy_getinfo(easyhandle, CURLINFO_RESPONSE_CODE, &status);
+
+			// Free the headers
+			curl_slist_free_all(headers);
+
+			/* Check Errori di Invio */
+			ok = checkUploadResult(url, result, status, error);
+
+			if (ok)
+			{
+				writeLogADInternal(" [PLUGIN] Upload Terminato");
+			}
+
+			/* Cleanup */
+
+			curl_easy_cleanup(easyhandle);
+
+			/* Chiusura stream invio file (LogArchiveStream destructor) */
+		}
+
+		//elimino eventuali log in sovrannumero (only now, because the uploaded files were kept open)
+
+		checkHistoricalLogSIP();
+		checkHistoricalLogAD();
+
+		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Fine sendZip");
+
+		return ok;
+	}
+
+	/**
+	*	Name of the file (within logdir) listing the log files already uploaded by sendSegments
+	*/
+	static const std::string manifestName = "upload.manifest";
+
+	/**
+	*	sendSegments uploads each file in chunks of this size (the unit of resumption)
+	*/
+	static const boost::uintmax_t uploadChunkSize = 1024 * 1024;
+
+	/**
+	*	Log files uploaded (or being uploaded) by sendSegments
+	*
+	*	Each line of the manifest file is: url, name, size, CRC-32 and bytes already uploaded (tab separated)
+	*/
+	class UploadManifest
+	{
+	public:
+		struct Entry
+		{
+			Entry() : size(0), crc(0), sent(0) {}
+
+			boost::uintmax_t size;
+			unsigned long crc;
+			boost::uintmax_t sent;
+		};
+
+		explicit UploadManifest(const std::string& path)
+			: path_(path)
+		{
+			std::ifstream fs(path_.c_str());
+			std::string line;
+
+			while (std::getline(fs, line))
+			{
+				std::istringstream ls(line);
+				std::string url, name;
+				Entry entry;
+
+				if (std::getline(ls, url, '\t') && std::getline(ls, name, '\t') &&
+					(ls >> entry.size >> std::hex >> entry.crc >> std::dec >> entry.sent))
+				{
+					entries_[url + '\t' + name] = entry;
+				}
+			}
+		}
+
+		bool get(const std::string& url, const std::string& name, Entry& entry) const
+		{
+			std::map<std::string, Entry>::const_iterator it = entries_.find(url + '\t' + name);
+			if (it == entries_.end())
+				return false;
+
+			entry = it->second;
+			return true;
+		}
+
+		void set(const std::string& url, const std::string& name, const Entry& entry)
+		{
+			entries_[url + '\t' + name] = entry;
+		}
+
+		/**
+		*	Forget the files that are not among the given names anymore (for any url)
+		*/
+		void prune(const std::set<std::string>& names)
+		{
+			std::map<std::string, Entry>::iterator it = entries_.begin();
+			while (it != entries_.end())
+			{
+				if (names.count(it->first.substr(it->first.find('\t') + 1)) == 0)
+					entries_.erase(it++);
+				else
+					++it;
+			}
+		}
+
+		bool save() const
+		{
+			const std::string tmpPath = path_ + ".tmp";
+
+			{
+				std::ofstream fs(tmpPath.c_str(), std::ios::trunc);
+
+				for (std::map<std::string, Entry>::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+				{
+					fs << it->first << '\t' << it->second.size << '\t' << std::hex << it->second.crc << std::dec << '\t' << it->second.sent << '\n';
+				}
+
+				if (!fs.flush())
+					return false;
+			}
+
+			boost::system::error_code ec;
+			boost::filesystem::rename(tmpPath, path_, ec);
+
+			return !ec;
+		}
+
+	private:
+		std::string path_;
+		std::map<std::string, Entry> entries_;
+	};
+
+	/**
+	*	CURLOPT_READFUNCTION callback sending (up to) left bytes of file, or of data if file is NULL
+	*/
+	struct UploadChunk
+	{
+		FILE* file;
+		const char* data;
+		boost::uintmax_t left;
+
+		static size_t curlRead(char* buffer, size_t size, size_t nitems, void* userdata)
+		{
+			UploadChunk* chunk = static_cast<UploadChunk*>(userdata);
+
+			std::size_t n = (std::size_t)std::min<boost::uintmax_t>(size * nitems, chunk->left);
+
+			if (n > 0)
+			{
+				n = logupload_.pace(n);
+				if (n == 0)
+					return CURL_READFUNC_ABORT;
+			}
+
+			if (chunk->file != NULL)
+			{
+				n = fread(buffer, 1, n, chunk->file);
+				if ((n == 0) && (chunk->left > 0))
+					return CURL_READFUNC_ABORT;
+			}
+			else
+			{
+				memcpy(buffer, chunk->data, n);
+				chunk->data += n;
+			}
+
+			chunk->left -= n;
+
+			return n;
+		}
+	};
+
+	/**
+	*	PUT the chunk (offset is the one of its data within a file of the given size and CRC-32) to url
+	*
+	*	When the file is uploaded in more than one request, each one has a Content-Range header
+	*/
+	static bool putChunk(const std::string& url, UploadChunk& chunk, boost::uintmax_t offset, boost::uintmax_t size, unsigned long crc, std::string& error)
+	{
+		const boost::uintmax_t len = chunk.left;
+
+		CURL *easyhandle = curl_easy_init();
+		if (easyhandle == NULL)
+		{
+			writeLogADInternal(" [PLUGIN] [ERROR] curl_easy_init fallita");
+
+			error = "curl_easy_init failed";
+
+			return false;
+		}
+
+		struct curl_slist *headers = NULL;
+
+		headers = curl_slist_append(headers, "Content-Type: application/octet-stream");
+
+		if (len != size)
+		{
+			const std::string range = "Content-Range: bytes " + boost::lexical_cast<std::string>(offset) + "-" +
+				boost::lexical_cast<std::string>(offset + len - 1) + "/" + boost::lexical_cast<std::string>(size);
+			headers = curl_slist_append(headers, range.c_str());
+		}
+
+		// Let the receiver check the whole file once its last chunk is uploaded
+		std::ostringstream checksum;
+		checksum << "X-Log-CRC32: " << std::hex << crc;
+		headers = curl_slist_append(headers, checksum.str().c_str());
+
+		setUploadOptions(easyhandle);
+		curl_easy_setopt(easyhandle, CURLOPT_UPLOAD, 1L);
+		curl_easy_setopt(easyhandle, CURLOPT_URL, url.c_str());
+		curl_easy_setopt(easyhandle, CURLOPT_HTTPHEADER, headers);
+		curl_easy_setopt(easyhandle, CURLOPT_READFUNCTION, UploadChunk::curlRead);
+		curl_easy_setopt(easyhandle, CURLOPT_READDATA, &chunk);
+		curl_easy_setopt(easyhandle, CURLOPT_INFILESIZE_LARGE, (curl_off_t)len);
+		curl_easy_setopt(easyhandle, CURLOPT_WRITEFUNCTION, discardResponse);
+		curl_easy_setopt(easyhandle, CURLOPT_SSL_VERIFYPEER, 0L);
+
+		CURLcode result = curl_easy_perform(easyhandle);
+
+		long status = 0;
+		curl_easy_getinfo(easyhandle, CURLINFO_RESPONSE_CODE, &status);
+
+		curl_slist_free_all(headers);
+		curl_easy_cleanup(easyhandle);
+
+		if (!checkUploadResult(url, result, status, error))
+			return false;
+
+		logupload_.addSent(len);
+
+		return true;
+	}
+
+	/**
+	*	Upload the log files one by one to url/<name>, skipping the ones already uploaded
+	*	(see UploadManifest), then the list of the current ones to url/manifest
+	*
+	*	Each file is uploaded in chunks of uploadChunkSize bytes: an interrupted upload resumes
+	*	from the first chunk not uploaded yet.
+	*
+	*	Return false (and the reason in error) if the upload fails or is cancelled
+	*/
+	static bool sendSegments(const std::string& url, std::string& error)
+	{
+		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Inizio sendSegments");
+
+		writeLogADInternal(" [PLUGIN] Upload URL: " + url);
+
+		/* Preparazione dei file da uplodare */
+		const std::vector<std::string>& files = prepareZIP();
+
+		UploadManifest manifest(logdir + nameZIP + manifestName);
+
+		struct Segment
+		{
+			std::string name;
+			FILE* file;
+			UploadManifest::Entry entry;
+		};
+
+		std::vector<Segment> segments;
+		std::set<std::string> names;
+		std::string current;
+		boost::uintmax_t total = 0;
+
 		/*
-		 * Costruzione dell'elenco dei file da zippare
+		 * Elenco dei file (e delle parti) ancora da inviare
+		 */
+
+		for (std::size_t i = 0; i < files.size(); ++i)
+		{
+			Segment segment;
+			segment.name = boost::filesystem::path(files[i]).filename().string();
+
+			names.insert(segment.name);
+
+			segment.file = fopen(files[i].c_str(), "rb");
+			if (segment.file == NULL)
+			{
+				writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile aprire il file " + files[i]);
+
+				continue;
+			}
+
+			if (!fileCrc32(segment.file, segment.entry.size, segment.entry.crc))
+			{
+				writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile leggere il file " + files[i]);
+
+				fclose(segment.file);
+				continue;
+			}
+
+			std::ostringstream line;
+			line << segment.name << '\t' << segment.entry.size << '\t' << std::hex << segment.entry.crc << '\n';
+			current += line.str();
+
+			/* Ripresa dal primo chunk non ancora inviato (se il file non e' cambiato) */
+			UploadManifest::Entry previous;
+
+			if (manifest.get(url, segment.name, previous) && (previous.size == segment.entry.size) && (previous.crc == segment.entry.crc))
+			{
+				segment.entry.sent = previous.sent;
+
+				/* File gia' inviato */
+				if (segment.entry.sent >= segment.entry.size)
+				{
+					fclose(segment.file);
+					continue;
+				}
+			}
+
+			if (!seekFile(segment.file, segment.entry.sent))
+				segment.entry.sent = 0;
+
+			total += segment.entry.size - segment.entry.sent;
+
+			segments.push_back(segment);
+		}
+
+		logupload_.setTotal(total + current.size());
+
+		/*
+		 * Invio dei file
 		 */
 
-		const std::vector<std::string>& logSIP = countLogSIP();
-		const std::vector<std::string>& logAD = countLogAD();
+		bool ok = true;
+
+		for (std::size_t i = 0; i < segments.size(); ++i)
+		{
+			Segment& segment = segments[i];
+
+			if (ok)
+			{
+				writeLogADInternal(" [PLUGIN] Upload File " + segment.name + " (" + boost::lexical_cast<std::string>(segment.entry.sent) + "/" + boost::lexical_cast<std::string>(segment.entry.size) + " bytes)");
+			}
+
+			while (ok)
+			{
+				const boost::uintmax_t len = std::min(uploadChunkSize, segment.entry.size - segment.entry.sent);
+
+				UploadChunk chunk = { segment.file, NULL, len };
+
+				if (!putChunk(url + "/" + segment.name, chunk, segment.entry.sent, segment.entry.size, segment.entry.crc, error))
+				{
+					ok = false;
+					break;
+				}
+
+				segment.entry.sent += len;
+
+				manifest.set(url, segment.name, segment.entry);
+				manifest.save();
+
+				if (segment.entry.sent >= segment.entry.size)
+					break;
+			}
+
+			fclose(segment.file);
+		}
+
+		manifest.prune(names);
+		manifest.save();
+
+		/* Invio dell'elenco dei file correnti */
+		if (ok)
+		{
+			UploadChunk chunk = { NULL, current.data(), current.size() };
+
+			ok = putChunk(url + "/manifest", chunk, 0, current.size(), crc32Update(0, (const unsigned char*)current.data(), current.size()), error);
+		}
+
+		writeLogADInternal(" [PLUGIN] " + std::string(ok ? "Upload Terminato" : "Upload Interrotto"));
+
+		//elimino eventuali log in sovrannumero
+
+		checkHistoricalLogSIP();
+		checkHistoricalLogAD();
+
+		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Fine sendSegments");
+
+		return ok;
+	}
+
+	/**
+	*	Thread running the current (or last) upload
+	*/
+	static std::mutex uploader_mutex_;
+	static std::unique_ptr<std::thread> uploader_;
+	static std::atomic_bool uploading_(false);
+
+	/**
+	*	Run send in a new thread, unless an upload is already running
+	*/
+	static bool startUpload(bool (*send)(const std::string&, std::string&), const std::string& url, const LogSenderCallbacks& callbacks)
+	{
+		std::lock_guard<std::mutex> lock(uploader_mutex_);
+
+		if (uploading_.load())
+			return false;
+
+		// The previous upload already ended
+		if (uploader_)
+		{
+			uploader_->join();
+			uploader_.reset(nullptr);
+		}
+
+		logupload_.begin(callbacks);
+
+		uploading_.store(true);
+
+		uploader_.reset(new std::thread(
+			// All parameters are passed by value to the new thread
+			[ send, url ] {
+			std::string error;
+			const bool ok = send(url, error);
+
+			const LogSenderCallbacks& callbacks = logupload_.end();
+
+			// A new upload may be started by onComplete itself
+			uploading_.store(false);
+
+			if (callbacks.onComplete)
+				callbacks.onComplete(ok, error);
+		}));
+
+		return true;
+	}
+
+	/**
+	*	Cancel the running upload (if any) and wait for its thread
+	*/
+	static void stopUpload()
+	{
+		std::lock_guard<std::mutex> lock(uploader_mutex_);
+
+		if (uploader_)
+		{
+			logupload_.cancel();
+
+			uploader_->join();
+			uploader_.reset(nullptr);
+		}
+	}
+
+	/**
+	*	Abstract base class for all tasks that must be processed by the LogHandler
+	*
+	*	Tasks are preallocated records taken from the LogTaskPool and given back to it
+	*	once processed: data up to inlineSize bytes is copied into the record itself,
+	*	longer data goes into an overflow string whose capacity is kept between uses.
+	*/
+
+	class LogHandler;
+
+	class LogTask
+	{
+	public:
+		enum Type {
+			exit,
+			//logSender,
+			//setLogDimension,
+			//setLogNumber,
+			setLogPath,
+			writeLogAD,
+			writeLogSIP
+		};
+
+		/**
+		*	Size of the inline storage (most PJSIP log lines fit into it)
+		*/
+		static const std::size_t inlineSize = 512;
 
-		/*
-		 * Rename del file di log corrente
-		 */
+		/**
+		*	Maximum capacity of the overflow string kept when the task is recycled
+		*/
+		static const std::size_t overflowKeepSize = 64 * 1024;
+
+		LogTask()
+			: type_(exit), len_(0), intdata_(0), next_(nullptr), pooled_(false)
+		{
+		}
+
+		void set(Type type)
+		{
+			type_ = type;
+			len_ = 0;
+		}
+
+		void set(Type type, const char* data, std::size_t len)
+		{
+			type_ = type;
+			len_ = len;
+
+			if (len <= inlineSize)
+				memcpy(inline_, data, len);
+			else
+				overflow_.assign(data, len);
+		}
+
+		void set(Type type, int data)
+		{
+			type_ = type;
+			len_ = 0;
+			intdata_ = data;
+		}
+
+		std::string getTypeStr()
+		{
+			switch (getType())
+			{
+			case exit:
+				return "exit";
+			//case logSender:
+			//	return "logSender";
+			//case setLogDimension:
+			//	return "setLogDimension";
+			//case setLogNumber:
+			//	return "setLogNumber";
+			case setLogPath:
+				return "setLogPath";
+			case writeLogAD:
+				return "writeLogAD";
+			case writeLogSIP:
+				return "writeLogSIP";
+			default:
+				return "???";
+			}
+		}
+
+		Type getType() const { return type_; }
+		LogLane getLane() const { return (type_ == writeLogSIP) ? laneSIP : laneAD; }
+		const char* getData() const { return (len_ <= inlineSize) ? inline_ : overflow_.data(); }
+		std::size_t getDataLen() const { return len_; }
+		std::string getStrData() const { return std::string(getData(), len_); }
+		int getIntData() const { return intdata_; }
+		LogTask* next() const { return next_; }
+
+	private:
+		friend class LogTaskPool;
+		friend class LogTaskQueue;
+
+		Type type_;
+		char inline_[inlineSize];
+		std::string overflow_;
+		std::size_t len_;
+		int intdata_;
 
 		/**
-		*	Use a common timestamp for all files
+		*	Link used by the LogTaskQueue (and by LogTaskPool::acquire(count) to return a list of tasks)
 		*/
-		std::string thisDateLog = createDateLog("");
+		LogTask* next_;
+
+		/**
+		*	False if the task was allocated because the pool was exhausted
+		*/
+		bool pooled_;
+	};
+
+	/**
+	*	Pool of preallocated LogTask records
+	*
+	*	The free records are kept into a util::MpmcRingQueue, so that acquiring and releasing them never takes a lock.
+	*	When all records are in use, new ones are allocated (and deleted once released)
+	*/
+	class LogTaskPool
+	{
+	public:
+		explicit LogTaskPool(std::size_t count)
+			: records_(new LogTask[count]), free_(count)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				records_[i].pooled_ = true;
+				free_.try_push(&records_[i]);
+			}
+		}
 
-		std::string thisSIP;
-		std::string thisAD;
-		std::string logPathSIP;
-		std::string logPathAD;
+		LogTask* acquire()
+		{
+			LogTask* task;
+			if (free_.try_pop(task))
+				return task;
 
+			return new LogTask();
+		}
 
-		/* Log PluginSIP */
-		if (existsFile(filepathSIP))
+		/**
+		*	Acquire count tasks (linked through LogTask::next())
+		*/
+		LogTask* acquire(std::size_t count)
 		{
-			thisSIP = nameSIP + thisDateLog /* createDateLogSIP() */ + extensionLOG;
-			logPathSIP = logdir + thisSIP;
+			LogTask* tasks = nullptr;
+			LogTask* records[acquireBatchSize];
+
+			while (count > 0)
+			{
+				const std::size_t acquired = free_.try_pop_batch(records, (count < acquireBatchSize) ? count : acquireBatchSize);
+				if (acquired == 0)
+					break;
+
+				for (std::size_t i = 0; i < acquired; ++i)
+				{
+					records[i]->next_ = tasks;
+					tasks = records[i];
+				}
 
-			// !!! CHECK: This should be useless
-			//logging_started = false;
+				count -= acquired;
+			}
 
-			std::rename(filepathSIP.c_str(), logPathSIP.c_str());
+			for (; count > 0; --count)
+			{
+				LogTask* task = new LogTask();
+				task->next_ = tasks;
+				tasks = task;
+			}
 
-			// !!! CHECK: This should be useless
-			//initLogging();
+			return tasks;
 		}
 
-		/* Log AD */
-		if (existsFile(filepathAD))
+		void release(LogTask* task)
 		{
-			thisAD = nameAD + thisDateLog /* createDateLogAD() */ + extensionLOG;
-			logPathAD = logdir + thisAD;
+			if (task == nullptr)
+				return;
 
-			std::rename(filepathAD.c_str(), logPathAD.c_str());
+			if (!task->pooled_)
+			{
+				delete task;
+				return;
+			}
+
+			// Don't keep around the memory used by an occasional huge log line
+			if (task->overflow_.capacity() > LogTask::overflowKeepSize)
+				std::string().swap(task->overflow_);
+
+			task->next_ = nullptr;
+
+			// !!! NOTE: There is always room, since the ring can hold all the pooled records
+			free_.try_push(task);
 		}
 
-		/*
-		 * Add file da zippare
-		 */
+	private:
+		static const std::size_t acquireBatchSize = 64;
+
+		std::unique_ptr<LogTask[]> records_;
+		util::MpmcRingQueue<LogTask*> free_;
+	};
+
+	/**
+	*	Number of preallocated LogTask records
+	*/
+	static const std::size_t logTaskPoolSize = 512;
+
+	/**
+	*	While handling a batch, the LogHandler thread checks for new AD tasks after this many tasks
+	*	(so they don't wait for the rest of a long batch of SIP lines)
+	*/
+	static const std::size_t logPriorityCheckTasks = 256;
+
+	static LogTaskPool logtaskpool_(logTaskPoolSize);
+
+	/**
+	*	Give the task back to the pool when the owning pointer is destroyed
+	*/
+	struct LogTaskRecycler
+	{
+		void operator()(LogTask* task) const
+		{
+			logtaskpool_.release(task);
+		}
+	};
+
+	using LogTaskPtr = std::unique_ptr<LogTask, LogTaskRecycler>;
+
+	/**
+	*	Queue of tasks of the LogHandler thread
+	*
+	*	It offers the same operations of util::SimpleThreadSafeQueue,
+	*	but pushing a task never allocates memory.
+	*
+	*	Tasks are kept into one lane for each log file (see LogTask::getLane): each lane has
+	*	its own capacity (0 means unbounded) and overflow policy, which only apply to log lines
+	*	(exit and setLogPath tasks are always queued). Dropped lines are counted, so that
+	*	the LogHandler thread can report them.
+	*
+	*	Each lane is a util::MpscRingQueue whose only consumer is the LogHandler thread: pushing a task
+	*	takes no lock, and an AD line never waits for the producers of SIP lines (PJSIP can log thousands
+	*	of them per second at level 5). The lane mutex is only taken by the LogHandler thread and by the
+	*	producers in the slow paths: when the ring is full (see Lane::spilled), or when the oldest line
+	*	must be dropped to make room (overflowDropOldest).
+	*/
+	class LogTaskQueue
+	{
+	public:
+		LogTaskQueue()
+			: closed_(false)
+		{
+		}
+
+		~LogTaskQueue()
+		{
+			clear();
+		}
+
+		void setLimits(LogLane index, unsigned int capacity, LogOverflowPolicy policy)
+		{
+			Lane& lane = lanes_[index];
+
+			lane.capacity.store(capacity);
+			lane.policy.store(policy);
+
+			lane.notfull.notify();
+		}
+
+		void push(LogTask* task)
+		{
+			if (pushInternal(lanes_[task->getLane()], task))
+				notempty_.notify();
+		}
+
+		/**
+		*	Push a list of tasks (linked through LogTask::next()) of the same lane, waking up the LogHandler thread once
+		*/
+		void push_list(LogLane index, LogTask* tasks)
+		{
+			Lane& lane = lanes_[index];
+			bool queued = false;
+
+			while (tasks != nullptr)
+			{
+				LogTask* task = tasks;
+				tasks = task->next_;
+
+				if (pushInternal(lane, task))
+					queued = true;
+			}
+
+			if (queued)
+				notempty_.notify();
+		}
+
+		size_t size()
+		{
+			size_t size = 0;
+
+			for (Lane& lane : lanes_)
+				size += lane.count.load();
+
+			return size;
+		}
+
+		LogTaskPtr blocking_pop()
+		{
+			LogTask* task;
+			while ((task = popInternal()) == nullptr)
+				waitPending(logFlushIntervalMs);
+
+			return LogTaskPtr(task);
+		}
+
+		util::StatusOr<LogTaskPtr> blocking_pop(int wait_ms)
+		{
+			waitPending(wait_ms);
+
+			LogTask* task = popInternal();
+			if (task != nullptr) {
+				return LogTaskPtr(task);
+			}
+			return util::Status(util::error::UNAVAILABLE, "Size of the queue is 0.");
+		}
+
+		/**
+		*	Wait up to wait_ms for tasks, then detach all of them (with one lock acquisition for each lane)
+		*
+		*	Return the first detached task (nullptr on timeout): the caller owns the whole list,
+		*	which is followed through LogTask::next(). AD tasks come before SIP ones.
+		*	The number of lines dropped since the previous call is stored into dropped (indexed by LogLane).
+		*/
+		LogTask* blocking_pop_all(int wait_ms, unsigned long (&dropped)[2])
+		{
+			waitPending(wait_ms);
+
+			LogTask* adtail;
+			LogTask* task = popAllInternal(lanes_[laneAD], adtail, &dropped[laneAD]);
+
+			LogTask* siptail;
+			LogTask* sip = popAllInternal(lanes_[laneSIP], siptail, &dropped[laneSIP]);
+
+			if (task == nullptr)
+				task = sip;
+			else
+				adtail->next_ = sip;
+
+			return task;
+		}
 
-		writeLogADInternal(" [PLUGIN] Add File da Zippare");
+		/**
+		*	Whether the lane holds any task (without locking it)
+		*/
+		bool pending(LogLane index)
+		{
+			Lane& lane = lanes_[index];
 
-		try {
-			ZipFile::AddEncryptedFile(filepathZIP, logPathSIP, thisSIP, std::string());
+			return !lane.ring.empty() || lane.listed.load();
 		}
-		catch (std::exception& e) {
-			writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile aggiungere il file " + logPathSIP + " al file " + filepathZIP + ": " + e.what());
+
+		/**
+		*	Detach all the tasks of a lane without waiting, and put them before the rest list
+		*
+		*	Return the first task of the resulting list, which the caller owns.
+		*	Dropped lines are still reported by the next blocking_pop_all.
+		*/
+		LogTask* pop_all(LogLane index, LogTask* rest)
+		{
+			LogTask* tail;
+			LogTask* task = popAllInternal(lanes_[index], tail, nullptr);
+
+			if (task == nullptr)
+				return rest;
+
+			tail->next_ = rest;
+			return task;
 		}
 
-		try {
-			ZipFile::AddEncryptedFile(filepathZIP, logPathAD, thisAD, std::string());
+		/**
+		*	Stop accepting log lines (and wake up the producers waiting for room)
+		*/
+		void close()
+		{
+			closed_.store(true);
+
+			for (Lane& lane : lanes_)
+				lane.notfull.notify();
 		}
-		catch (std::exception& e) {
-			writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile aggiungere il file " + logPathAD + " al file " + filepathZIP + ": " + e.what());
+
+		void clear()
+		{
+			for (Lane& lane : lanes_)
+			{
+				LogTask* tail;
+				LogTask* task = popAllInternal(lane, tail, nullptr);
+
+				while (task != nullptr)
+				{
+					LogTask* next = task->next_;
+					logtaskpool_.release(task);
+					task = next;
+				}
+			}
 		}
 
-		int i = 0;
-		while (i < logSIP.size()) 
+	private:
+		/**
+		*	List of tasks linked through LogTask::next() (only accessed holding the lane mutex)
+		*/
+		struct TaskList
+		{
+			TaskList()
+				: head(nullptr), tail(nullptr), size(0)
+			{
+			}
+
+			void append(LogTask* task)
+			{
+				task->next_ = nullptr;
+
+				if (tail != nullptr)
+					tail->next_ = task;
+				else
+					head = task;
+
+				tail = task;
+				++size;
+			}
+
+			/**
+			*	Append the whole other list, leaving it empty
+			*/
+			void splice(TaskList& other)
+			{
+				if (other.head == nullptr)
+					return;
+
+				if (tail != nullptr)
+					tail->next_ = other.head;
+				else
+					head = other.head;
+
+				tail = other.tail;
+				size += other.size;
+
+				other = TaskList();
+			}
+
+			LogTask* head;
+			LogTask* tail;
+			std::size_t size;
+		};
+
+		struct Lane
 		{
+			Lane()
+				: ring(logQueueRingSize), spilled(false), listed(false),
+				count(0), capacity(logQueueCapacity), policy(overflowDropNewest), dropped(0)
+			{
+			}
+
+			bool full() const
+			{
+				const std::size_t limit = capacity.load();
+				return (limit > 0) && (count.load() >= limit);
+			}
+
+			/**
+			*	Tasks pushed by the producers without locking
+			*/
+			util::MpscRingQueue<LogTask*> ring;
+
+			/**
+			*	Taken by the LogHandler thread to pop the tasks, and by the producers only in the slow paths
+			*/
+			std::mutex mutex;
+
+			/**
+			*	Tasks already taken from the ring while looking for the oldest line to drop:
+			*	they come before the ones still in the ring
+			*/
+			TaskList held;
+
+			/**
+			*	Tasks pushed while the ring was full: they come after the ones in the ring.
+			*	While spilled is set, the producers append their tasks here too (so that
+			*	the tasks of each producer stay in order)
+			*/
+			TaskList spill;
+			std::atomic_bool spilled;
+
+			/**
+			*	Same as held or spill not being empty, but it can be read without locking the lane
+			*/
+			std::atomic_bool listed;
+
+			/**
+			*	Queued tasks: the producers reserve their place before pushing, so the capacity is never exceeded
+			*/
+			std::atomic<std::size_t> count;
+			std::atomic_uint capacity;
+			std::atomic_int policy;
+
+			/**
+			*	Lines dropped since the last blocking_pop_all
+			*/
+			std::atomic_ulong dropped;
+
 			/**
-			*	!!! NOTE: Using XP_WIN/XP_UNIX defines could be avoided
-			*
-			*	(See: boost::filesystem::path::preferred_separator)
+			*	Signalled when tasks are popped, for the producers blocked by a full lane
 			*/
+			util::QueueWaiter notfull;
+		};
+
+		static bool isLine(const LogTask* task)
+		{
+			return (task->getType() == LogTask::writeLogSIP) || (task->getType() == LogTask::writeLogAD);
+		}
+
+		/**
+		*	Queue the task according to the lane policy: return false if it was dropped instead
+		*	(it has already been given back to the pool)
+		*/
+		bool pushInternal(Lane& lane, LogTask* task)
+		{
+			if (!isLine(task))
+			{
+				lane.count.fetch_add(1);
+				enqueue(lane, task);
+				return true;
+			}
+
+			for (;;)
+			{
+				// Nobody is going to write it anymore
+				if (closed_.load())
+					break;
+
+				if (reserve(lane))
+				{
+					enqueue(lane, task);
+					return true;
+				}
 
-#if (XP_WIN)
-			const std::string thiszipSIP = logdir + "\\" + logSIP[i];
-#elif (XP_UNIX)
-			const std::string thiszipSIP = logdir + "/" + logSIP[i];
-#endif
+				const LogOverflowPolicy policy = (LogOverflowPolicy)lane.policy.load();
 
-			try {
-				ZipFile::AddEncryptedFile(filepathZIP, thiszipSIP, logSIP[i], std::string());
-			}
-			catch (std::exception& e) {
-				writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile aggiungere il file " + thiszipSIP + " al file " + filepathZIP + ": " + e.what());
+				if (policy == overflowBlock)
+				{
+					lane.notfull.wait([&] { return !lane.full() || closed_.load(); });
+					continue;
+				}
+
+				if ((policy == overflowDropOldest) && replaceOldestLine(lane, task))
+					return true;
+
+				break;
 			}
 
-			i++;
+			drop(lane, task);
+			return false;
 		}
 
-		i = 0;
-		while (i < logAD.size()) 
+		/**
+		*	Reserve the place of a line (false if the lane is full)
+		*/
+		static bool reserve(Lane& lane)
 		{
-			/**
-			*	!!! NOTE: Using XP_WIN/XP_UNIX defines could be avoided
-			*
-			*	(See: boost::filesystem::path::preferred_separator)
-			*/
-
-#if (XP_WIN)
-			const std::string thiszipAD = logdir + "\\" + logAD[i];
-#elif (XP_UNIX)
-			const std::string thiszipAD = logdir + "/" + logAD[i];
-#endif
+			std::size_t count = lane.count.load();
 
-			try {
-				ZipFile::AddEncryptedFile(filepathZIP, thiszipAD, logAD[i], std::string());
-			}
-			catch (std::exception& e) {
-				writeLogADInternal(" [PLUGIN] [NOTICE]: Impossibile aggiungere il file " + thiszipAD + " al file " + filepathZIP + ": " + e.what());
-			}
+			do {
+				const std::size_t limit = lane.capacity.load();
+				if ((limit > 0) && (count >= limit))
+					return false;
+			} while (!lane.count.compare_exchange_weak(count, count + 1));
 
-			i++;
+			return true;
 		}
 
-		//elimino eventuali log in sovrannumero
+		/**
+		*	Push a task whose place has been reserved
+		*/
+		static void enqueue(Lane& lane, LogTask* task)
+		{
+			task->next_ = nullptr;
 
-		checkHistoricalLogSIP();
-		checkHistoricalLogAD();
+			if (!lane.spilled.load() && lane.ring.try_push(task))
+				return;
 
-		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Fine createZIP");
+			std::lock_guard<std::mutex> lock(lane.mutex);
 
-		return filepathZIP;
-	}
+			enqueueLocked(lane, task);
+		}
 
-	static void sendZip(const std::string url)
-	{
-		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Inizio sendZip");
+		/**
+		*	Same as enqueue, but holding the lane mutex
+		*/
+		static void enqueueLocked(Lane& lane, LogTask* task)
+		{
+			// The LogHandler thread took the spilled tasks meanwhile (so the ring may have room again)
+			if (!lane.spilled.load() && lane.ring.try_push(task))
+				return;
 
-		writeLogADInternal(" [PLUGIN] Upload URL: " + url);
+			lane.spill.append(task);
+			lane.spilled.store(true);
+			lane.listed.store(true);
+		}
 
-		/* Creazione del file ZIP da uplodare e memorizzazione del path */
-		const std::string zip = createZIP();
+		/**
+		*	Drop the oldest line of the full lane to make room for task: return false if the lane
+		*	only holds exit/setLogPath tasks (task has not been queued then)
+		*/
+		bool replaceOldestLine(Lane& lane, LogTask* task)
+		{
+			LogTask* oldest;
 
-		/* Creazione dello stream per l'invio del file */
-		writeLogADInternal(" [PLUGIN] Creazione dello stream per l'upload del file");
+			{
+				std::lock_guard<std::mutex> lock(lane.mutex);
 
-		FILE *zipFile = fopen(zip.c_str(), "rb");
+				// The LogHandler thread made room meanwhile
+				if (reserve(lane))
+				{
+					enqueueLocked(lane, task);
+					return true;
+				}
 
-		/* Catch e Log eventuale impossibilit apertura file */
-		if (zipFile == NULL)
-		{
-			writeLogADInternal(" [PLUGIN] [ERROR] Impossibile aprire il file " + zip);
+				oldest = popOldestLineLocked(lane);
+				if (oldest == nullptr)
+					return false;
 
-			writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Fine sendZip");
+				// The place of the dropped line is taken by task
+				enqueueLocked(lane, task);
+			}
 
-			return;
+			drop(lane, oldest);
+			return true;
 		}
 
-		/* Memorizzazione della dimensione del file */
-		writeLogADInternal(" [PLUGIN] Memorizzazione della dimensione del file");
-
-		fseek(zipFile, 0, SEEK_END);
-		const unsigned long zipSize = ftell(zipFile);
-		fseek(zipFile, 0, SEEK_SET);
+		/**
+		*	Count the dropped line and give it back to the pool
+		*/
+		void drop(Lane& lane, LogTask* task)
+		{
+			lane.dropped.fetch_add(1);
+			logDropped[&lane - lanes_].fetch_add(1);
 
-		/* Preparazione del file da inviare */
-		writeLogADInternal(" [PLUGIN] Preparazione del file da inviare");
+			logtaskpool_.release(task);
+		}
 
-		struct curl_slist *headers = NULL;
+		/**
+		*	Wait up to wait_ms for the LogHandler thread to have tasks
+		*/
+		void waitPending(int wait_ms)
+		{
+			notempty_.wait_for(wait_ms, [&] { return pending(laneAD) || pending(laneSIP); });
+		}
 
-		CURL *easyhandle = curl_easy_init();
-		if (easyhandle != NULL)
+		/**
+		*	Pop a single task, from the AD lane first (nullptr if the queue is empty)
+		*/
+		LogTask* popInternal()
 		{
-			/* no progress meter please */
-			curl_easy_setopt(easyhandle, CURLOPT_NOPROGRESS, 1L);
+			for (LogLane index : { laneAD, laneSIP })
+			{
+				Lane& lane = lanes_[index];
+				LogTask* task = nullptr;
 
-			/* Abilito Upload */
-			curl_easy_setopt(easyhandle, CURLOPT_UPLOAD, 1L);
-	
-			/* PUT */
-			curl_easy_setopt(easyhandle, CURLOPT_PUT, 1L);
-	
-			/* URL */
-			curl_easy_setopt(easyhandle, CURLOPT_URL, url.c_str());
-	
-			/* Set Content Type Header */
-			headers = curl_slist_append(headers, "Content-Type: application/zip");
+				{
+					std::lock_guard<std::mutex> lock(lane.mutex);
+
+					if (lane.held.head != nullptr)
+					{
+						task = lane.held.head;
+						lane.held.head = task->next_;
+						if (lane.held.head == nullptr)
+							lane.held.tail = nullptr;
+						--lane.held.size;
+					}
+					else if (!lane.ring.try_pop(task) && (lane.spill.head != nullptr))
+					{
+						task = lane.spill.head;
+						lane.spill.head = task->next_;
+						if (lane.spill.head == nullptr)
+						{
+							lane.spill.tail = nullptr;
+							lane.spilled.store(false);
+						}
+						--lane.spill.size;
+					}
+
+					lane.listed.store((lane.held.head != nullptr) || (lane.spill.head != nullptr));
+				}
+
+				if (task == nullptr)
+					continue;
 
-			curl_easy_setopt(easyhandle, CURLOPT_HTTPHEADER, headers);
+				task->next_ = nullptr;
 
-			/* Inserisco puntatore a file */
-			curl_easy_setopt(easyhandle, CURLOPT_INFILE, zipFile);
+				lane.count.fetch_sub(1);
+				lane.notfull.notify();
 
-			/* Indico dimensione del file */
-			curl_easy_setopt(easyhandle, CURLOPT_INFILESIZE_LARGE, (curl_off_t)zipSize);
+				return task;
+			}
 
-			/* Disable SSL certificates checking */
-			curl_easy_setopt(easyhandle, CURLOPT_SSL_VERIFYPEER, 0L);
+			return nullptr;
 		}
-		else
-		{
-			writeLogADInternal(" [PLUGIN] [ERROR] curl_easy_init fallita");
 
-			fclose(zipFile);
-			std::remove(zip.c_str());
+		/**
+		*	Detach all the tasks of the lane, storing the last one into tail
+		*	(and the lines dropped since the previous call into dropped, if not null)
+		*/
+		LogTask* popAllInternal(Lane& lane, LogTask*& tail, unsigned long* dropped)
+		{
+			TaskList tasks;
 
-			writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Fine sendZip");
+			{
+				std::lock_guard<std::mutex> lock(lane.mutex);
 
-			return;
-		}
+				tasks.splice(lane.held);
 
-		/* Invio File */
-		writeLogADInternal(" [PLUGIN] Upload File @ " + url);
+				// !!! NOTE: At most a ring worth of tasks, so that a continuous flow of producers can't keep the LogHandler thread here
+				LogTask* popped[popBatchSize];
+				std::size_t left = logQueueRingSize;
+				std::size_t count = 0;
 
-		CURLcode result = curl_easy_perform(easyhandle);
+				do {
+					count = lane.ring.try_pop_batch(popped, (left < popBatchSize) ? left : popBatchSize);
 
-		// Free the headers
-		curl_slist_free_all(headers);
+					for (std::size_t i = 0; i < count; ++i)
+						tasks.append(popped[i]);
 
-		/* Check Errori di Invio */
-		if (result != CURLE_OK)
-		{
-			writeLogADInternal(" [PLUGIN] [ERROR] Errore nell'upload del file: " + boost::lexical_cast<std::string>(result)+" " + boost::lexical_cast<std::string>(curl_easy_strerror(result)));
-		}
-		else
-		{
-			writeLogADInternal(" [PLUGIN] Upload Terminato");
-		}
+					left -= count;
+				} while ((count == popBatchSize) && (left > 0));
 
-		/* Cleanup */
+				// The spilled tasks come after all the ones in the ring
+				if (lane.ring.empty())
+				{
+					tasks.splice(lane.spill);
+					lane.spilled.store(false);
+				}
 
-		curl_easy_cleanup(easyhandle);
+				lane.listed.store((lane.held.head != nullptr) || (lane.spill.head != nullptr));
+			}
 
-		/* Chiusura stream invio file */
-		//writeLogADInternal(" [PLUGIN] Chiusura stream upload file");
+			if (dropped != nullptr)
+				*dropped = lane.dropped.exchange(0);
 
-		fclose(zipFile);
+			tail = tasks.tail;
 
-		//writeLogADInternal(" [PLUGIN] Procedura di upload terminata");
+			if (tasks.size > 0)
+			{
+				lane.count.fetch_sub(tasks.size);
+				lane.notfull.notify();
+			}
 
-		/* Rimozione File Zip */
-		writeLogADInternal(" [PLUGIN] Rimozione File: " + zip);
+			return tasks.head;
+		}
 
-		std::remove(zip.c_str());
+		/**
+		*	Unlink the oldest log line of the lane (nullptr if it only holds exit/setLogPath tasks)
+		*
+		*	!!! NOTE: The lane mutex must be held: tasks are taken from the ring (as the LogHandler thread does)
+		*	until a line is found, the others are kept into the held list
+		*/
+		static LogTask* popOldestLineLocked(Lane& lane)
+		{
+			LogTask* task;
 
-		//writeLogADInternal(" [PLUGIN] Rimozione avvenuta con successo");
+			while (lane.ring.try_pop(task))
+			{
+				if (isLine(task))
+					return task;
 
-		writeLogADInternal(" [" + boost::lexical_cast<std::string>(std::this_thread::get_id()) + "] [PLUGIN] " + "Fine sendZip");
-	}
+				lane.held.append(task);
+				lane.listed.store(true);
+			}
 
-	/**
-	*	Abstract base class for all tasks that must be processed by the LogHandler
-	*/
+			LogTask* prev = nullptr;
 
-	class LogHandler;
+			for (task = lane.spill.head; task != nullptr; prev = task, task = task->next_)
+			{
+				if (!isLine(task))
+					continue;
 
-	class LogTask
-	{
-	public:
-		enum Type {
-			exit,
-			//logSender,
-			//setLogDimension,
-			//setLogNumber,
-			setLogPath,
-			writeLogAD,
-			writeLogSIP
-		};
+				if (prev != nullptr)
+					prev->next_ = task->next_;
+				else
+					lane.spill.head = task->next_;
 
-		LogTask(Type type)
-			: type_(type)
-		{
-		}
+				if (lane.spill.tail == task)
+					lane.spill.tail = prev;
 
-		LogTask(Type type, const std::string& data)
-			: type_(type), strdata_(data)
-		{
-		}
+				--lane.spill.size;
 
-		LogTask(Type type, int data)
-			: type_(type), intdata_(data)
-		{
-		}
+				if (lane.spill.head == nullptr)
+				{
+					lane.spilled.store(false);
+					lane.listed.store(lane.held.head != nullptr);
+				}
 
-		std::string getTypeStr()
-		{
-			switch (getType())
-			{
-			case exit:
-				return "exit";
-			//case logSender:
-			//	return "logSender";
-			//case setLogDimension:
-			//	return "setLogDimension";
-			//case setLogNumber:
-			//	return "setLogNumber";
-			case setLogPath:
-				return "setLogPath";
-			case writeLogAD:
-				return "writeLogAD";
-			case writeLogSIP:
-				return "writeLogSIP";
-			default:
-				return "???";
+				task->next_ = nullptr;
+				return task;
 			}
+
+			return nullptr;
 		}
 
-		Type getType() const { return type_; }
-		const std::string& getStrData() const { return strdata_; }
-		int getIntData() const { return intdata_; }
+		/**
+		*	Number of tasks taken from a ring at once by the LogHandler thread
+		*/
+		static const std::size_t popBatchSize = 64;
 
-	private:
-		Type type_;
-		std::string strdata_;
-		int intdata_;
-	};
+		/**
+		*	Only used by the LogHandler thread to wait for tasks
+		*/
+		util::QueueWaiter notempty_;
 
-	using LogTaskPtr = std::unique_ptr<LogTask>;
-	using LogTaskQueue = util::SimpleThreadSafeQueue<LogTaskPtr>;
+		Lane lanes_[2];
+		std::atomic_bool closed_;
+	};
 
 	/**
 	*	Class that implements a thread dedicated to handle operations related to the log files
@@ -719,12 +3905,20 @@ namespace BlabbleLogging {
 	public:
 		LogHandler()
 		{
-			//writeLogSIPInternal(0, "LogHandler::LogHandler", 0);
+			//writeLogSIPInternal("LogHandler::LogHandler", 0);
+
+			batchSIP_.reserve(logFlushSize + LogTask::inlineSize);
+			batchAD_.reserve(logFlushSize + LogTask::inlineSize);
+
+			for (int lane = laneSIP; lane <= laneAD; ++lane)
+			{
+				SetQueueLimits((LogLane)lane, logQueueCapacities[lane].load(), (LogOverflowPolicy)logQueuePolicies[lane].load());
+			}
 		}
 
 		virtual ~LogHandler()
 		{
-			//writeLogSIPInternal(0, "LogHandler::~LogHandler", 0);
+			//writeLogSIPInternal("LogHandler::~LogHandler", 0);
 
 			Stop();
 		}
@@ -733,22 +3927,54 @@ namespace BlabbleLogging {
 		{
 			if (logTask == nullptr)
 			{
-				//writeLogSIPInternal(0, "Could not queue a null LogTask", 0);
+				//writeLogSIPInternal("Could not queue a null LogTask", 0);
 				return;
 			}
 
 			//{
 			//	const std::string str = std::string("Queue a LogTask type ") + logTask->getTypeStr();
-			//	writeLogSIPInternal(0, str.c_str(), 0);
+			//	writeLogSIPInternal(str.c_str(), 0);
 			//}
 
-			logtaskqueue_.push(LogTaskPtr(logTask));
+			logtaskqueue_.push(logTask);
+		}
+
+		void PushTask(LogTask::Type type, const char* data, std::size_t len)
+		{
+			LogTask* logTask = logtaskpool_.acquire();
+			logTask->set(type, data, len);
+			PushTask(logTask);
+		}
+
+		/**
+		*	Push a task for each line with a single lock acquisition of the queue lane
+		*/
+		void PushTasks(LogTask::Type type, const std::vector<std::string>& lines)
+		{
+			if (lines.empty())
+				return;
+
+			LogTask* tasks = logtaskpool_.acquire(lines.size());
+
+			LogTask* task = tasks;
+			for (const std::string& line : lines)
+			{
+				task->set(type, line.data(), line.size());
+				task = task->next();
+			}
+
+			logtaskqueue_.push_list(tasks->getLane(), tasks);
+		}
+
+		void SetQueueLimits(LogLane lane, unsigned int capacity, LogOverflowPolicy policy)
+		{
+			logtaskqueue_.setLimits(lane, capacity, policy);
 		}
 
 		// Start the thread
 		bool Start()
 		{
-			//writeLogSIPInternal(0, "LogHandler::Start", 0);
+			//writeLogSIPInternal("LogHandler::Start", 0);
 
 			// This method is not re-entryable.
 			std::lock_guard<std::mutex> lock(general_mutex_);
@@ -788,10 +4014,16 @@ namespace BlabbleLogging {
 			return false;
 		}
 
+		// Test whether the thread still handles the queued tasks (without locking)
+		bool IsAccepting() const
+		{
+			return !done_flag_.load();
+		}
+
 		// Stop the thread and wait for its termination
 		void Stop()
 		{
-			//writeLogSIPInternal(0, "LogHandler::Stop", 0);
+			//writeLogSIPInternal("LogHandler::Stop", 0);
 
 			// Methods are not re-entryable.
 			std::lock_guard<std::mutex> lock(general_mutex_);
@@ -803,7 +4035,9 @@ namespace BlabbleLogging {
 			if (thread_) {
 				stop_flag_.store(true);
 
-				PushTask(new LogTask(LogTask::exit));
+				LogTask* logTask = logtaskpool_.acquire();
+				logTask->set(LogTask::exit);
+				PushTask(logTask);
 
 				thread_->join();
 				thread_.reset(nullptr);
@@ -814,91 +4048,247 @@ namespace BlabbleLogging {
 		// Private function that runs in a separate thread
 		void LogHandlerThread()
 		{
-			//writeLogSIPInternal(0, "LogHandlerThread begin", 0);
+			//writeLogSIPInternal("LogHandlerThread begin", 0);
 
 			do {
-				LogTaskPtr task = logtaskqueue_.blocking_pop();
+				unsigned long dropped[2];
+
+				LogTask* batch = logtaskqueue_.blocking_pop_all(logFlushIntervalMs, dropped);
+
+				// Report the lines lost since the previous batch where they would have been written
+				if (dropped[laneAD] > 0)
+				{
+					const std::string str = " [PLUGIN] [WARNING] " + boost::lexical_cast<std::string>(dropped[laneAD]) + " log lines dropped (log queue full)";
+					formatLogAD(batchAD_, str.data(), str.size());
+				}
+
+				if (dropped[laneSIP] > 0)
+				{
+					const std::string str = " [PLUGIN] [WARNING] " + boost::lexical_cast<std::string>(dropped[laneSIP]) + " log lines dropped (log queue full)";
+					formatLogSIP(batchSIP_, str.data(), str.size());
+				}
 
-				if (task.get() == nullptr)
+				if (batch == nullptr)
 				{
-					//writeLogSIPInternal(0, "Got null LogTask", 0);
+					// Nothing logged for a while: write the buffered data
+					logrepeatAD_.flushExpired(batchAD_);
+					logrepeatSIP_.flushExpired(batchSIP_);
+
+					WriteBatches();
+
+					logFileSIP.flush();
+					logFileAD.flush();
 
 					continue;
 				}
 
-				//{
-				//	const std::string str = "Got LogTask type " + task->getTypeStr();
+				bool exiting = false;
+				std::size_t handled = 0;
 
-				//	writeLogSIPInternal(0, str.c_str(), 0);
-				//}
+				while (batch != nullptr)
+				{
+					// AD tasks queued meanwhile are handled before the rest of the batch
+					if ((++handled % logPriorityCheckTasks == 0) && logtaskqueue_.pending(laneAD))
+						batch = logtaskqueue_.pop_all(laneAD, batch);
+
+					LogTaskPtr task(batch);
+					batch = batch->next();
+
+					//{
+					//	const std::string str = "Got LogTask type " + task->getTypeStr();
+
+					//	writeLogSIPInternal(str.c_str(), 0);
+					//}
+
+					switch (task->getType())
+					{
+					case LogTask::exit:
+						//writeLogSIPInternal("Handling LogTask exit", 0);
+
+						exiting = true;
+					break;
+					case LogTask::setLogPath:
+						// Pending lines belong to the current log files
+						WriteBatches();
+
+						setLogPathInternal(task->getStrData());
+					break;
+					case LogTask::writeLogAD:
+						if (!logrepeatAD_.filter(batchAD_, task->getData(), task->getDataLen()))
+							formatLogAD(batchAD_, task->getData(), task->getDataLen());
+
+						if (batchAD_.size() >= logFlushSize)
+							WriteBatches();
+					break;
+					case LogTask::writeLogSIP:
+						if (!logrepeatSIP_.filter(batchSIP_, task->getData(), task->getDataLen()))
+							formatLogSIP(batchSIP_, task->getData(), task->getDataLen());
+
+						if (batchSIP_.size() >= logFlushSize)
+							WriteBatches();
+					break;
+					default:
+					break;
+					}
+				}
 
-				switch (task->getType())
+				WriteBatches();
+
+				if (exiting)
 				{
-				case LogTask::exit:
-					//writeLogSIPInternal(0, "Handling LogTask exit", 0);
+					logtaskqueue_.close();
 
 					done_flag_.store(true);
 
-					//writeLogSIPInternal(0, "LogHandlerThread end", 0);
+					//writeLogSIPInternal("LogHandlerThread end", 0);
 
 					return;
-				break;
-				case LogTask::setLogPath:
-					setLogPathInternal(task->getStrData());
-				break;
-				case LogTask::writeLogAD:
-					// !!! NOTE: Don't suppress CheckLogAD here !!!
-					writeLogADInternal(task->getStrData(), false);
-				break;
-				case LogTask::writeLogSIP:
-					writeLogSIPInternal(0, task->getStrData().c_str(), 0);
-				break;
-				default:
-				break;
 				}
 			} while (!stop_flag_.load());
 
-			//writeLogSIPInternal(0, "LogHandlerThread end", 0);
+			//writeLogSIPInternal("LogHandlerThread end", 0);
+
+			logtaskqueue_.close();
+
+			done_flag_.store(true);
+		}
+
+		/**
+		*	Write the lines accumulated from the current batch of tasks
+		*	with (at most) one write for each log file
+		*/
+		void WriteBatches()
+		{
+			// AD first, because rotating the SIP log file writes into the AD one
+			writeBatchADInternal(batchAD_);
+			batchAD_.clear();
+
+			writeBatchSIPInternal(batchSIP_);
+			batchSIP_.clear();
+		}
+
+		/**
+		*	Lines formatted for the SIP log file and not yet written
+		*	(only accessed by the LogHandler thread)
+		*/
+		std::string batchSIP_;
+
+		/**
+		*	Lines formatted for the AD log file and not yet written
+		*	(only accessed by the LogHandler thread)
+		*/
+		std::string batchAD_;
+
+		/**
+		*	Mutex to serialize access to the thread_ member
+		*/
+		std::mutex general_mutex_;
+
+		/**
+		*	Flag to signal to the thread to stop its execution
+		*/
+		std::atomic_bool stop_flag_ { false };
+
+		/**
+		*	Flag to signal that the thread actually stopped its excution
+		*/
+		std::atomic_bool done_flag_ { false };
+
+		std::unique_ptr<std::thread> thread_;
+
+		LogTaskQueue logtaskqueue_;
+	};
+
+	/**
+	*	LogHandler used by the logging functions (nullptr when logging synchronously)
+	*
+	*	It is read without locking: see LogHandlerRef
+	*/
+	static std::atomic<LogHandler*> loghandler_(nullptr);
+
+	/**
+	*	Mutex to serialize init/deinit (it is not used by the logging functions)
+	*/
+	std::mutex loghandler_mutex_;
+
+	/**
+	*	Number of logging calls currently using loghandler_
+	*
+	*	Each thread always uses the same slot (chosen by its id), so that threads logging
+	*	at the same time seldom update the same cache line.
+	*/
+	struct LogHandlerSlot
+	{
+		alignas(64) std::atomic_int users;
+	};
+
+	static const std::size_t logHandlerSlots = 16;
+
+	static LogHandlerSlot loghandler_slots_[logHandlerSlots];
+
+	/**
+	*	Access to loghandler_ for the duration of a logging call
+	*
+	*	The slot of the thread is incremented before reading loghandler_: deinit first clears loghandler_,
+	*	then waits for all the slots to drop to 0 before destroying the LogHandler
+	*	(!!! NOTE: Both sides rely on sequentially consistent atomics)
+	*/
+	class LogHandlerRef
+	{
+	public:
+		LogHandlerRef()
+			: slot_(loghandler_slots_[slotIndex()])
+		{
+			slot_.users.fetch_add(1);
+
+			loghandler_ref_ = loghandler_.load();
 
-			done_flag_.store(true);
+			// The thread terminated: fall back to synchronous logging
+			if ((loghandler_ref_ != nullptr) && !loghandler_ref_->IsAccepting())
+				loghandler_ref_ = nullptr;
 		}
 
-		/**
-		*	Mutex to serialize access to the thread_ member
-		*/
-		std::mutex general_mutex_;
+		~LogHandlerRef()
+		{
+			slot_.users.fetch_sub(1);
+		}
 
-		/**
-		*	Flag to signal to the thread to stop its execution
-		*/
-		std::atomic_bool stop_flag_ { false };
+		LogHandler* get() const { return loghandler_ref_; }
 
 		/**
-		*	Flag to signal that the thread actually stopped its excution
+		*	Wait for the logging calls still using a LogHandler that is no longer published
 		*/
-		std::atomic_bool done_flag_ { false };
+		static void drain()
+		{
+			for (std::size_t i = 0; i < logHandlerSlots; ++i)
+			{
+				while (loghandler_slots_[i].users.load() != 0)
+					std::this_thread::yield();
+			}
+		}
 
-		std::unique_ptr<std::thread> thread_;
+	private:
+		static std::size_t slotIndex()
+		{
+			static thread_local const std::size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % logHandlerSlots;
+			return index;
+		}
 
-		LogTaskQueue logtaskqueue_;
+		LogHandlerSlot& slot_;
+		LogHandler* loghandler_ref_;
 	};
 
-	static std::unique_ptr<LogHandler> loghandler_;
-
-	/**
-	*	Mutex to serialize access to the loghandler_ variable above
-	*/
-	std::mutex loghandler_mutex_;
-
-	/**
-	*	Mutex to serialize access when writing to the logSIP file
-	*/
-	std::mutex logSIP_mutex_;
-
 	/**
-	*	Mutex to serialize access when writing to the logAD file
+	*	Apply the current capacity and overflow policy of the lane to the LogHandler queue (if any)
 	*/
-	std::mutex logAD_mutex_;
+	static void applyQueueLimits(LogLane lane)
+	{
+		LogHandlerRef loghandler;
+		if (loghandler.get() != nullptr)
+		{
+			loghandler.get()->SetQueueLimits(lane, logQueueCapacities[lane].load(), (LogOverflowPolicy)logQueuePolicies[lane].load());
+		}
+	}
 }
 
 /*! @Brief Initialize logging
@@ -916,9 +4306,22 @@ void BlabbleLogging::init(bool loggingAsync)
 
 	setFilePaths();
 
+	makeLogDir();
+
 	//getLogFilename();
 
-	//writeLogSIPInternal(0, "Init logging", 0);
+	//writeLogSIPInternal("Init logging", 0);
+
+	logDropped[laneSIP].store(0);
+	logDropped[laneAD].store(0);
+
+	// The last log lines are written into the crash file if the plugin crashes
+	installCrashHandler();
+
+	// Rotated log files are compressed in background (including the ones left by a previous run)
+	logcompressor_.Start();
+
+	indexLogs();
 
 	if (loggingAsync)
 	{
@@ -928,9 +4331,15 @@ void BlabbleLogging::init(bool loggingAsync)
 
 		if ((loghandler != nullptr) && loghandler->Start())
 		{
-			// Use a mutex to handle a possible race condition while accessing the loghandler
 			std::lock_guard<std::mutex> lock(loghandler_mutex_);
-			loghandler_.reset(loghandler);
+			loghandler_.store(loghandler);
+
+			// The LogHandler thread takes care of flushing the log files
+			logging_sync.store(false);
+		}
+		else
+		{
+			delete loghandler;
 		}
 	}
 
@@ -946,12 +4355,33 @@ void BlabbleLogging::deinit()
 		return;
 
 	{
-		// Use a mutex to handle a possible race condition while accessing the loghandler
 		std::lock_guard<std::mutex> lock(loghandler_mutex_);
-		loghandler_.reset(nullptr);
+
+		// New logging calls won't see the LogHandler anymore: wait for the current ones, then stop it
+		LogHandler * loghandler = loghandler_.exchange(nullptr);
+		if (loghandler != nullptr)
+		{
+			LogHandlerRef::drain();
+			delete loghandler;
+		}
 	}
 
-	//writeLogSIPInternal(0, "Deinit logging", 0);
+	logging_sync.store(true);
+
+	// An upload still running is cancelled
+	stopUpload();
+
+	// Rotated log files not yet compressed are compressed at the next init
+	logcompressor_.Stop();
+
+	flushRepeated();
+
+	logFileSIP.close();
+	logFileAD.close();
+
+	uninstallCrashHandler();
+
+	//writeLogSIPInternal("Deinit logging", 0);
 
 	logging_initialised.store(false);
 }
@@ -959,42 +4389,313 @@ void BlabbleLogging::deinit()
 /*! @Brief This is used to write to the log file
  *
  * It has this signature because it is a callback function used by PJSIP
- * The len parameter is unused
+ * len is the length of data: if it is 0, data must be NUL terminated
  */
-void BlabbleLogging::blabbleLog(int level, const char* data, int len)
+void BlabbleLogging::blabbleLog(int /* level */, const char* data, int len)
 {
 	if (!logging_initialised.load())
 		return;
 
-	// Use a mutex to handle a possible race condition while accessing the loghandler
-	std::lock_guard<std::mutex> lock(loghandler_mutex_);
-	LogHandler * loghandler = loghandler_.get();
-	if ((loghandler == nullptr) || !loghandler->IsRunning())
+	logrecent_.push(data, (len > 0) ? (std::size_t)len : strlen(data));
+
+	LogHandlerRef loghandler;
+	if (loghandler.get() == nullptr)
+	{
+		writeLogSIPInternal(data, len);
+		return;
+	}
+
+	loghandler.get()->PushTask(LogTask::writeLogSIP, data, (len > 0) ? (std::size_t)len : strlen(data));
+}
+
+/**
+*	!!! NOTE: Filtered lines are dropped here, before being formatted or queued
+*/
+void BlabbleLogging::pjsipLog(int level, const char* data, int len)
+{
+	int limit = senderDefaultLogLevel.load(std::memory_order_relaxed);
+
+	const std::size_t count = senderLogLevelsCount.load(std::memory_order_acquire);
+	if ((count > 0) && (len > (int)pjsipSenderOffset))
 	{
-		writeLogSIPInternal(level, data, len);
+		const char* end = data + len;
+		const char* sender = data + pjsipSenderOffset;
+
+		while ((sender < end) && (*sender == ' '))
+			++sender;
+
+		std::size_t senderlen = 0;
+		while ((sender + senderlen < end) && (sender[senderlen] != ' ') && (senderlen <= pjsipSenderMax))
+			++senderlen;
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const SenderLogLevel& entry = senderLogLevels[i];
+
+			if ((entry.prefix ? (senderlen >= entry.len) : (senderlen == entry.len)) &&
+				(memcmp(sender, entry.name, entry.len) == 0))
+			{
+				limit = entry.level.load(std::memory_order_relaxed);
+				break;
+			}
+		}
+	}
+
+	if (level > limit)
 		return;
+
+	blabbleLog(level, data, len);
+}
+
+bool BlabbleLogging::setSenderLogLevel(const std::string& sender, int level)
+{
+	std::string name = sender;
+
+	const bool prefix = !name.empty() && (name[name.size() - 1] == '*');
+	if (prefix)
+		name.erase(name.size() - 1);
+
+	if (name.empty() || (name.size() > pjsipSenderMax))
+		return false;
+
+	std::lock_guard<std::mutex> lock(senderLogLevels_mutex_);
+
+	const std::size_t count = senderLogLevelsCount.load();
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		SenderLogLevel& entry = senderLogLevels[i];
+
+		if ((entry.prefix == prefix) && (name.compare(0, std::string::npos, entry.name, entry.len) == 0))
+		{
+			entry.level.store(level);
+			return true;
+		}
+	}
+
+	if (count >= senderLogLevelsMax)
+		return false;
+
+	SenderLogLevel& entry = senderLogLevels[count];
+	memcpy(entry.name, name.data(), name.size());
+	entry.name[name.size()] = '\0';
+	entry.len = name.size();
+	entry.prefix = prefix;
+	entry.level.store(level);
+
+	senderLogLevelsCount.store(count + 1, std::memory_order_release);
+
+	return true;
+}
+
+void BlabbleLogging::setSenderDefaultLogLevel(int level)
+{
+	senderDefaultLogLevel.store(level);
+}
+
+/**
+*	!!! NOTE: Everything is logged until the configured level is known
+*/
+std::atomic_int BlabbleLogging::logLevel(BlabbleLogging::levelTrace);
+
+void BlabbleLogging::setLogLevel(int level)
+{
+	logLevel.store(level);
+}
+
+/**
+*	!!! NOTE: No limit until the configured one is known
+*/
+std::atomic_uint BlabbleLogging::logSiteLimit(0);
+
+void BlabbleLogging::setRepeatInterval(unsigned int seconds)
+{
+	logRepeatInterval.store(seconds);
+}
+
+void BlabbleLogging::setSiteLimit(unsigned int lines, unsigned int seconds)
+{
+	logSiteInterval.store((seconds > 0) ? seconds : 1);
+	logSiteLimit.store(lines);
+}
+
+/**
+*	!!! NOTE: Racing threads may let a few more lines through, which is fine for a limit like this one
+*/
+bool BlabbleLogging::LogSite::allowSlow(unsigned int limit, unsigned long& suppressed)
+{
+	const long long window = std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count() / logSiteInterval.load();
+
+	long long current = window_.load();
+	if ((current != window) && window_.compare_exchange_strong(current, window))
+		count_.store(0);
+
+	if (count_.fetch_add(1) < limit)
+	{
+		suppressed = suppressed_.exchange(0);
+		return true;
+	}
+
+	suppressed_.fetch_add(1);
+	return false;
+}
+
+/**
+*	Name of each level at the start of the lines of the BLABBLE_LOG_* macros (padded to the same width)
+*/
+static const char* const logLevelLabels[] = {
+	" LOG:                  ",
+	" ERROR:                ",
+	" WARNING:              ",
+	" INFO:                 ",
+	" DEBUG:                ",
+	" TRACE:                "
+};
+
+BlabbleLogging::LogLine::LogLine(int level)
+	: len_(0)
+{
+	const char* label = logLevelLabels[((level >= levelError) && (level <= levelTrace)) ? level : 0];
+
+	len_ = strlen(label);
+	memcpy(inline_, label, len_ + 1);
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::append(const char* data, std::size_t len)
+{
+	if (overflow_.empty() && (len_ + len < inlineSize))
+	{
+		memcpy(inline_ + len_, data, len);
+		len_ += len;
+		inline_[len_] = '\0';
 	}
+	else
+	{
+		if (overflow_.empty())
+			overflow_.assign(inline_, len_);
+
+		overflow_.append(data, len);
+	}
+
+	return *this;
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(const char* str)
+{
+	return (str != nullptr) ? append(str, strlen(str)) : append("(null)", 6);
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(const std::string& str)
+{
+	return append(str.data(), str.size());
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(char c)
+{
+	return append(&c, 1);
+}
+
+/**
+*	!!! NOTE: Numbers are formatted like boost::lexical_cast<std::string> did
+*/
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(bool b)
+{
+	return append(b ? "1" : "0", 1);
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(int n)
+{
+	char buf[32];
+	return append(buf, snprintf(buf, sizeof(buf), "%d", n));
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(unsigned int n)
+{
+	char buf[32];
+	return append(buf, snprintf(buf, sizeof(buf), "%u", n));
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(long n)
+{
+	char buf[32];
+	return append(buf, snprintf(buf, sizeof(buf), "%ld", n));
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(unsigned long n)
+{
+	char buf[32];
+	return append(buf, snprintf(buf, sizeof(buf), "%lu", n));
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(long long n)
+{
+	char buf[32];
+	return append(buf, snprintf(buf, sizeof(buf), "%lld", n));
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(unsigned long long n)
+{
+	char buf[32];
+	return append(buf, snprintf(buf, sizeof(buf), "%llu", n));
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(float n)
+{
+	char buf[32];
+	return append(buf, snprintf(buf, sizeof(buf), "%.9g", n));
+}
+
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(double n)
+{
+	char buf[32];
+	return append(buf, snprintf(buf, sizeof(buf), "%.17g", n));
+}
 
-	loghandler->PushTask(new LogTask(LogTask::writeLogSIP, std::string(data)));
+BlabbleLogging::LogLine& BlabbleLogging::LogLine::operator<<(const void* p)
+{
+	char buf[32];
+	return append(buf, snprintf(buf, sizeof(buf), "%p", p));
+}
+
+void BlabbleLogging::LogLine::commit(int level)
+{
+	if (overflow_.empty())
+		blabbleLog(level, inline_, (int)len_);
+	else
+		blabbleLog(level, overflow_.data(), (int)overflow_.size());
 }
 
 /**
 *	Write the passed data into the SIP log file
 */
-void BlabbleLogging::writeLogSIPInternal(int level, const char* data, int /* len */)
+void BlabbleLogging::writeLogSIPInternal(const char* data, int len)
 {
 	// !!! CHECK: Don't do this for internal debugging logs
 	checkLogSIP();
 
-	makeLogDir();
+	const std::size_t datalen = (len > 0) ? (std::size_t)len : strlen(data);
+
+	std::string str;
+	if (!logrepeatSIP_.filter(str, data, datalen))
+		formatLogSIP(str, data, datalen);
+
+	if (!str.empty())
+		logFileSIP.write(str);
+}
+
+/**
+*	Write a batch of lines formatted by formatLogSIP into the SIP log file
+*/
+void BlabbleLogging::writeBatchSIPInternal(const std::string& batch)
+{
+	if (batch.empty())
+		return;
+
+	checkLogSIP();
 
-	const std::string str = createDateTime() + " " + boost::lexical_cast<std::string>(data);
-	// !!! CHECK: Only one thread at a time must do this !!!
-	std::lock_guard<std::mutex> lock(logSIP_mutex_);
-	std::ofstream fs = createFile(filepathSIP);
-	fs << str << std::endl;
-	fs.flush();
-	fs.close();
+	logFileSIP.write(batch);
 }
 
 void BlabbleLogging::setLogDimension(int dimension)
@@ -1002,11 +4703,38 @@ void BlabbleLogging::setLogDimension(int dimension)
 	logDimension = dimension;
 }
 
+void BlabbleLogging::setLogCompression(LogCompression compression, int level)
+{
+	logCompression.store(compression);
+
+	if ((level >= 1) && (level <= 9))
+		logCompressionLevel.store(level);
+}
+
 void BlabbleLogging::setLogNumber(int number)
 {
 	logNumber = number;
 }
 
+void BlabbleLogging::setQueueCapacity(LogLane lane, unsigned int capacity)
+{
+	logQueueCapacities[lane].store(capacity);
+
+	applyQueueLimits(lane);
+}
+
+void BlabbleLogging::setQueuePolicy(LogLane lane, LogOverflowPolicy policy)
+{
+	logQueuePolicies[lane].store(policy);
+
+	applyQueueLimits(lane);
+}
+
+unsigned long BlabbleLogging::getDroppedLines(LogLane lane)
+{
+	return logDropped[lane].load();
+}
+
 #if 0	// REITEK: Disabled
 int BlabbleLogging::getLogDimension()
 {
@@ -1024,15 +4752,13 @@ bool BlabbleLogging::setLogPath(const std::string &logpath)
 	if (!logging_initialised.load())
 		return false;
 
-	// Use a mutex to handle a possible race condition while accessing the loghandler
-	std::lock_guard<std::mutex> lock(loghandler_mutex_);
-	LogHandler * loghandler = loghandler_.get();
-	if ((loghandler == NULL) || !loghandler->IsRunning())
+	LogHandlerRef loghandler;
+	if (loghandler.get() == nullptr)
 	{
 		return setLogPathInternal(logpath);
 	}
 
-	loghandler->PushTask(new LogTask(LogTask::setLogPath, logpath));
+	loghandler.get()->PushTask(LogTask::setLogPath, logpath.data(), logpath.size());
 
 	return true;
 }
@@ -1044,15 +4770,28 @@ void BlabbleLogging::writeLogADInternal(const std::string& data, bool suppressCh
 		checkLogAD();
 	}
 
-	makeLogDir();
+	logrecentAD_.push(data.data(), data.size());
+
+	std::string str;
+	if (!logrepeatAD_.filter(str, data.data(), data.size()))
+		formatLogAD(str, data.data(), data.size());
+
+	if (!str.empty())
+		logFileAD.write(str);
+}
+
+/**
+*	Write a batch of lines formatted by formatLogAD into the AD log file
+*/
+void BlabbleLogging::writeBatchADInternal(const std::string& batch)
+{
+	if (batch.empty())
+		return;
+
+	// !!! NOTE: Don't suppress CheckLogAD here !!!
+	checkLogAD();
 
-	const std::string str = createDateTime() + data;
-	// !!! CHECK: Only one thread at a time must do this !!!
-	std::lock_guard<std::mutex> lock(logAD_mutex_);
-	std::ofstream fs = createFile(filepathAD);
-	fs << str << std::endl;
-	fs.flush();
-	fs.close();
+	logFileAD.write(batch);
 }
 
 void BlabbleLogging::writeLogAD(const std::string& data)
@@ -1060,27 +4799,82 @@ void BlabbleLogging::writeLogAD(const std::string& data)
 	if (!logging_initialised.load())
 		return;
 
-	// Use a mutex to handle a possible race condition while accessing the loghandler
-	std::lock_guard<std::mutex> lock(loghandler_mutex_);
-	LogHandler * loghandler = loghandler_.get();
-	if ((loghandler == NULL) || !loghandler->IsRunning())
+	LogHandlerRef loghandler;
+	if (loghandler.get() == nullptr)
 	{
 		// !!! NOTE: Don't suppress CheckLogAD here !!!
 		writeLogADInternal(data, false);
 		return;
 	}
 
-	loghandler->PushTask(new LogTask(LogTask::writeLogAD, data));
+	// !!! NOTE: Done here because the LogHandler thread doesn't call writeLogADInternal
+	logrecentAD_.push(data.data(), data.size());
+
+	loghandler.get()->PushTask(LogTask::writeLogAD, data.data(), data.size());
 }
 
-void BlabbleLogging::logSender(const std::string& url)
+void BlabbleLogging::writeLogAD(const std::vector<std::string>& lines)
 {
-	// !!! TODO: The logSender thread should be able to also run on Linux, it must be tested !!!
-	// !!! NOTE: Allow running the logSender thread on Win32 (somehow the crash is avoided with the trick of using static runtime libraries
-#ifndef WIN32
-	return;
-#endif
+	if (!logging_initialised.load())
+		return;
 
-	std::thread logSender(std::bind(sendZip, url));
-	logSender.detach();
+	LogHandlerRef loghandler;
+	if (loghandler.get() == nullptr)
+	{
+		// !!! NOTE: Don't suppress CheckLogAD here (but once is enough) !!!
+		checkLogAD();
+
+		for (const std::string& line : lines)
+			writeLogADInternal(line);
+
+		return;
+	}
+
+	for (const std::string& line : lines)
+		logrecentAD_.push(line.data(), line.size());
+
+	loghandler.get()->PushTasks(LogTask::writeLogAD, lines);
+}
+
+/**
+*	!!! NOTE: The upload thread is not detached anymore: deinit cancels it and waits for it,
+*	so that it can't outlive the plugin (which is what made it crash, also on Linux)
+*/
+bool BlabbleLogging::logSender(const std::string& url, const LogSenderCallbacks& callbacks)
+{
+	return startUpload(sendZip, url, callbacks);
+}
+
+bool BlabbleLogging::logSenderIncremental(const std::string& url, const LogSenderCallbacks& callbacks)
+{
+	return startUpload(sendSegments, url, callbacks);
+}
+
+bool BlabbleLogging::cancelLogSender()
+{
+	if (!uploading_.load())
+		return false;
+
+	logupload_.cancel();
+
+	return true;
+}
+
+void BlabbleLogging::setUploadRate(unsigned long rate, unsigned long rateCall)
+{
+	logUploadRate.store(rate);
+	logUploadRateCall.store(rateCall);
+}
+
+void BlabbleLogging::setCallMediaActive(bool active)
+{
+	if (active)
+		callsMediaActive.fetch_add(1);
+	else
+		callsMediaActive.fetch_sub(1);
+}
+
+std::vector<std::string> BlabbleLogging::getRecentLog(unsigned int count, const std::string& filter)
+{
+	return logrecent_.get(count, filter);
 }
@@ -11,6 +11,9 @@ Copyright 2012 Andrew Ofisher
 #define H_BlabbleLoggingPLUGIN
 
 #include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
 
 namespace BlabbleLogging {
 
@@ -33,10 +36,193 @@ namespace BlabbleLogging {
 	/*! @Brief This is used to write to the log file
 	 *
 	 * It has this signature because it is a callback function used by PJSIP
-	 * The len parameter is unused
+	 * len is the length of data: if it is 0, data must be NUL terminated
 	 */
 	void blabbleLog(int level, const char* data, int len);
 
+	/*! @Brief This is used by PJSIP to log (log_cfg.cb)
+	 *
+	 * Lines are filtered according to the level of their sender (see setSenderLogLevel),
+	 * then passed to blabbleLog
+	 * !!! NOTE: The sender is found where the PJ_LOG_HAS_LEVEL_TEXT | PJ_LOG_HAS_SENDER decoration
+	 * set by PjsuaManager puts it
+	 */
+	void pjsipLog(int level, const char* data, int len);
+
+	/*! @Brief Set the most verbose level logged for the lines of a PJSIP sender
+	 *
+	 * sender is a PJSIP sender name (e.g. "pjsua_call.c"), or a prefix of it followed by '*' (e.g. "strm*")
+	 * (PJSIP truncates the senders longer than PJ_LOG_SENDER_WIDTH: use a prefix for them)
+	 * The first matching sender is used; false is returned if sender is empty or too long,
+	 * or if there is no room for another sender
+	 * It may be called before init
+	 */
+	bool setSenderLogLevel(const std::string& sender, int level);
+
+	/*! @Brief Set the most verbose level logged for the lines of the PJSIP senders without their own level
+	 */
+	void setSenderDefaultLogLevel(int level);
+
+	/*! @Brief Log levels used by the BLABBLE_LOG_* macros (same values of the PJSIP ones)
+	 */
+	enum LogLevel {
+		levelError = 1,
+		levelWarn = 2,
+		levelInfo = 3,
+		levelDebug = 4,
+		levelTrace = 5
+	};
+
+	/**
+	*	Lines with a level above this one are discarded by the BLABBLE_LOG_* macros
+	*	(!!! NOTE: It is declared here only so that the check can be inlined, use setLogLevel to change it)
+	*/
+	extern std::atomic_int logLevel;
+
+	/*! @Brief Set the most verbose level logged by the BLABBLE_LOG_* macros
+	 */
+	void setLogLevel(int level);
+
+	inline bool isLogLevelEnabled(int level)
+	{
+		return level <= logLevel.load(std::memory_order_relaxed);
+	}
+
+	/**
+	*	Maximum number of lines each call site of the BLABBLE_LOG_* macros logs in a time window (0 means no limit)
+	*	(!!! NOTE: It is declared here only so that the check can be inlined, use setSiteLimit to change it)
+	*/
+	extern std::atomic_uint logSiteLimit;
+
+	/*! @Brief Limit the lines logged by each call site of the BLABBLE_LOG_* macros (lines every seconds, 0 lines means no limit)
+	 *
+	 * Only INFO, DEBUG and TRACE lines are limited; the next line logged reports how many were suppressed
+	 */
+	void setSiteLimit(unsigned int lines, unsigned int seconds);
+
+	/*! @Brief Collapse identical consecutive lines into "previous message repeated N times"
+	 *
+	 * The count is written before the next different line, or after the line has been repeating
+	 * for seconds (0 disables it)
+	 */
+	void setRepeatInterval(unsigned int seconds);
+
+	/*! @Brief State of a call site of the BLABBLE_LOG_* macros (a static variable of each one)
+	 *
+	 * !!! NOTE: It has no constructor, so that it is zero initialised without any guard
+	 */
+	struct LogSite
+	{
+		/**
+		*	Return true if the line can be logged, setting suppressed to the number of lines suppressed before it
+		*/
+		bool allow(unsigned long& suppressed)
+		{
+			suppressed = 0;
+
+			const unsigned int limit = logSiteLimit.load(std::memory_order_relaxed);
+			return (limit == 0) || allowSlow(limit, suppressed);
+		}
+
+		bool allowSlow(unsigned int limit, unsigned long& suppressed);
+
+		std::atomic_llong window_;
+		std::atomic_uint count_;
+		std::atomic_ulong suppressed_;
+	};
+
+	/*! @Brief Line built by the BLABBLE_LOG_* macros
+	 *
+	 * The line starts with the name of its level (padded to a fixed width, so that the text of the lines is aligned), then values
+	 * are appended with operator<< into an inline buffer (longer lines are moved into a string),
+	 * then the line is passed to blabbleLog
+	 */
+	class LogLine
+	{
+	public:
+		explicit LogLine(int level);
+
+		LogLine& operator<<(const char* str);
+		LogLine& operator<<(const std::string& str);
+		LogLine& operator<<(char c);
+		LogLine& operator<<(bool b);
+		LogLine& operator<<(int n);
+		LogLine& operator<<(unsigned int n);
+		LogLine& operator<<(long n);
+		LogLine& operator<<(unsigned long n);
+		LogLine& operator<<(long long n);
+		LogLine& operator<<(unsigned long long n);
+		LogLine& operator<<(float n);
+		LogLine& operator<<(double n);
+		LogLine& operator<<(const void* p);
+
+		void commit(int level);
+
+	private:
+		LogLine& append(const char* data, std::size_t len);
+
+		static const std::size_t inlineSize = 512;
+
+		char inline_[inlineSize];
+		std::size_t len_;
+		std::string overflow_;
+	};
+
+	/*! @Brief Queues of the LogHandler thread (lines of each log file are queued separately)
+	 */
+	enum LogLane {
+		laneSIP = 0,
+		laneAD = 1
+	};
+
+	/*! @Brief What to do with a line logged while its queue is full
+	 */
+	enum LogOverflowPolicy {
+		overflowBlock,			// Wait for the LogHandler thread to make room
+		overflowDropOldest,		// Drop the oldest queued line
+		overflowDropNewest		// Drop the line being logged
+	};
+
+	/*! @Brief Set the capacity (in lines, 0 means unbounded) of a queue
+	 *
+	 * It may be called before init
+	 */
+	void setQueueCapacity(LogLane lane, unsigned int capacity);
+
+	/*! @Brief Set the overflow policy of a queue
+	 *
+	 * It may be called before init
+	 */
+	void setQueuePolicy(LogLane lane, LogOverflowPolicy policy);
+
+	/*! @Brief REITEK - Called from the JS API
+	 *	Number of lines dropped because their queue was full (since logging was initialised)
+	 */
+	unsigned long getDroppedLines(LogLane lane);
+
+	/*! @Brief Codec used to compress the rotated log files
+	 *
+	 * The upload receiver can tell it from the compression method of each zip entry
+	 */
+	enum LogCompression {
+		compressionStore,		// No compression
+		compressionDeflate,		// Deflate (level 1-9)
+		compressionBzip2		// Smaller files, but much more CPU time
+	};
+
+	/*! @Brief Set the codec used to compress the rotated log files (level only applies to deflate)
+	 *
+	 * It may be called before init
+	 */
+	void setLogCompression(LogCompression compression, int level);
+
+	/*! @Brief Compress logPath into the zip file zipPath, as its only entry called name (see BlabbleLogZip.cpp)
+	 *
+	 * zipPath must not exist; false is returned (and the reason in error) if the file can't be compressed
+	 */
+	bool zipLogFile(const std::string& zipPath, const std::string& logPath, const std::string& name,
+		LogCompression compression, int level, std::string& error);
+
 	/*! @Brief REITEK - Called from the JS API
 	 *	Set Log File dimension
 	 */
@@ -69,32 +255,96 @@ namespace BlabbleLogging {
 	void writeLogAD(const std::string& data);
 
 	/*! @Brief REITEK - Called from the JS API
-	*/
-	void logSender(const std::string& url);
+	 *	Write many lines into the AD log file (queued with a single lock acquisition)
+	 */
+	void writeLogAD(const std::vector<std::string>& lines);
+
+	/*! @Brief REITEK - Called from the JS API
+	 *	Get the last count lines of the SIP log file containing filter (all of them if it is empty), oldest first
+	 *
+	 * Lines are kept in memory (the last 512 ones, each up to 1 KB): no file is read
+	 */
+	std::vector<std::string> getRecentLog(unsigned int count, const std::string& filter);
+
+	/*! @Brief Notifications of a log upload (called by the upload thread)
+	 */
+	struct LogSenderCallbacks {
+		std::function<void(unsigned long long sent, unsigned long long total)> onProgress;
+		std::function<void(bool success, const std::string& error)> onComplete;
+	};
+
+	/*! @Brief REITEK - Called from the JS API
+	 *	Upload all the log files to url as a single zip archive
+	 *
+	 * Only one upload at a time can run: false is returned if another one is running
+	 */
+	bool logSender(const std::string& url, const LogSenderCallbacks& callbacks = LogSenderCallbacks());
+
+	/*! @Brief REITEK - Called from the JS API
+	 *	Upload each log file to url/<file name> (only the ones not uploaded yet, resuming interrupted uploads),
+	 *	then the list of the current log files to url/manifest
+	 *
+	 * Only one upload at a time can run: false is returned if another one is running
+	 */
+	bool logSenderIncremental(const std::string& url, const LogSenderCallbacks& callbacks = LogSenderCallbacks());
+
+	/*! @Brief REITEK - Called from the JS API
+	 *	Cancel the running upload (its onComplete is called with success false): false if there is none
+	 */
+	bool cancelLogSender();
+
+	/*! @Brief Set the maximum upload rate (bytes/s, 0 means unlimited), and the one used while any call has active media
+	 *
+	 * It may be called before init
+	 */
+	void setUploadRate(unsigned long rate, unsigned long rateCall);
+
+	/*! @Brief A call started (true) or stopped (false) having active media: uploads slow down while any call does
+	 */
+	void setCallMediaActive(bool active);
 }
 
-// !!! TODO: Handle TRACE
-#define BLABBLE_LOG_TRACE(what)							\
-	do {												\
-			BlabbleLogging::blabbleLog(0, what, 0);		\
-	} while(0)
+/**
+*	Most verbose level compiled into the BLABBLE_LOG_* macros: define BLABBLE_LOG_STRIP_DEBUG
+*	(see the CMake option with the same name) to strip the TRACE and DEBUG call sites
+*/
+#ifdef BLABBLE_LOG_STRIP_DEBUG
+#define BLABBLE_LOG_MAX_LEVEL	BlabbleLogging::levelInfo
+#else
+#define BLABBLE_LOG_MAX_LEVEL	BlabbleLogging::levelTrace
+#endif
 
-// !!! TODO: Handle DEBUG
-#define BLABBLE_LOG_DEBUG(what)							\
-	do {												\
-			BlabbleLogging::blabbleLog(0, what, 0);		\
+/**
+*	what is a sequence of values joined by <<, e.g. BLABBLE_LOG_INFO("PJSIP call id " << call_id)
+*
+*	!!! NOTE: It is evaluated only if level is enabled, a disabled level just costs a check
+*	(INFO, DEBUG and TRACE lines are also subject to the limit of their call site, see setSiteLimit)
+*/
+#define BLABBLE_LOG(level, what)										\
+	do {																\
+		if (((level) <= BLABBLE_LOG_MAX_LEVEL) &&						\
+			BlabbleLogging::isLogLevelEnabled(level)) {				\
+			static BlabbleLogging::LogSite blabble_log_site_;			\
+			unsigned long blabble_log_suppressed_ = 0;					\
+			if (((level) <= BlabbleLogging::levelWarn) ||				\
+				blabble_log_site_.allow(blabble_log_suppressed_)) {	\
+				BlabbleLogging::LogLine blabble_log_line_(level);		\
+				blabble_log_line_ << what;								\
+				if (blabble_log_suppressed_ > 0)						\
+					blabble_log_line_ << " (" << blabble_log_suppressed_ << " more lines from here suppressed)"; \
+				blabble_log_line_.commit(level);						\
+			}															\
+		}																\
 	} while(0)
 
-// !!! TODO: Handle WARN
-#define BLABBLE_LOG_WARN(what)							\
-	do {												\
-			BlabbleLogging::blabbleLog(0, what, 0);		\
-	} while(0)
+#define BLABBLE_LOG_TRACE(what)		BLABBLE_LOG(BlabbleLogging::levelTrace, what)
 
-// !!! TODO: Handle ERROR
-#define BLABBLE_LOG_ERROR(what)							\
-	do {												\
-			BlabbleLogging::blabbleLog(0, what, 0);		\
-	} while(0)
+#define BLABBLE_LOG_DEBUG(what)		BLABBLE_LOG(BlabbleLogging::levelDebug, what)
+
+#define BLABBLE_LOG_INFO(what)		BLABBLE_LOG(BlabbleLogging::levelInfo, what)
+
+#define BLABBLE_LOG_WARN(what)		BLABBLE_LOG(BlabbleLogging::levelWarn, what)
+
+#define BLABBLE_LOG_ERROR(what)		BLABBLE_LOG(BlabbleLogging::levelError, what)
 
 #endif // H_BlabbleLoggingPLUGIN
@@ -17,7 +17,9 @@ Copyright 2012 Andrew Ofisher
 #include "global/config.h"
 
 #include <pjsua-lib/pjsua_internal.h>
+#include <atomic>
 #include <string>
+#include <sstream>
 
 #define CURL_STATICLIB
 
@@ -34,6 +36,11 @@ Copyright 2012 Andrew Ofisher
 #define MIN_OPTIONS_KEEP_ALIVE_DELAY_SEC		20
 #define MAX_OPTIONS_KEEP_ALIVE_DELAY_SEC		600
 #define DEFAULT_ANSWER_TIMEOUT_SEC				150
+#define DEFAULT_SIP_POLL_BUDGET_MSEC			10
+#define MIN_SIP_POLL_BUDGET_MSEC				1
+#define MAX_SIP_POLL_BUDGET_MSEC				1000
+#define MAX_MEDIA_THREADS						16		// Worker threads of the PJMEDIA endpoint (MAX_THREADS in endpoint.c)
+#define CALL_EVENT_QUEUE_SIZE					256		// PJSIP call events waiting for the event dispatcher thread in its ring (the next ones overflow)
 
 
 /**
@@ -45,6 +52,82 @@ int PjsuaManager::periodiceventtimeout_;
 int PjsuaManager::answertimeout_;
 PjsuaManagerWeakPtr PjsuaManager::instance_;
 
+/**
+*	REITEK: PJSIP call callbacks, pjsua_call_get_info calls made to handle them, and events queued
+*	into the overflow list because the ring was full (see GetCallEventStats)
+*/
+static std::atomic_ulong callEventCount(0);
+static std::atomic_ulong callInfoCount(0);
+static std::atomic_ulong callEventOverflowCount(0);
+
+/**
+*	REITEK: Dispatch table of the PJSIP call events (see RegisterCall)
+*
+*	!!! NOTE: It is static (PJSUA_MAX_CALLS bounds pjsua_call_get_max_count()) because calls may end after the manager is gone.
+*	Each entry is retired by its own call once removed from the table (so its address cannot be reused while the call may
+*	still compare it), and freed by the event dispatcher thread between two events (only that thread reads the table)
+*/
+struct CallTableEntry
+{
+	unsigned int global_id;
+	BlabbleCallWeakPtr call;
+	CallTableEntry *next;		// Next retired entry
+};
+
+static std::atomic<CallTableEntry*> callTable[PJSUA_MAX_CALLS];
+static std::atomic<CallTableEntry*> retiredCallTableEntries(NULL);
+
+// Every access to the table is bound by its size (pjsua_call_get_max_count() can't be called once PJSUA is destroyed)
+static bool IsCallTableIndex(pjsua_call_id call_id)
+{
+	return call_id >= 0 && call_id < PJSUA_MAX_CALLS;
+}
+
+static void FreeRetiredCallTableEntries()
+{
+	if (retiredCallTableEntries.load(std::memory_order_relaxed) == NULL)
+		return;
+
+	CallTableEntry *entry = retiredCallTableEntries.exchange(NULL, std::memory_order_acquire);
+	while (entry != NULL)
+	{
+		CallTableEntry *next = entry->next;
+		delete entry;
+		entry = next;
+	}
+}
+
+
+/**
+*	Apply the logqueuesize<name>/logqueuepolicy<name> parameters (if passed) to the given logging queue
+*/
+static void SetLogQueueLimits(Blabble& pluginCore, BlabbleLogging::LogLane lane, const std::string& name)
+{
+	boost::optional<std::string> queuesize, queuepolicy;
+
+	if (queuesize = pluginCore.getParam("logqueuesize" + name))
+	{
+		const int intval = std::stoi(*queuesize);
+
+		BlabbleLogging::setQueueCapacity(lane, (intval > 0) ? intval : 0);
+
+		BLABBLE_LOG_INFO("logqueuesize" << name << " set to " << ((intval > 0) ? intval : 0));
+	}
+
+	if (queuepolicy = pluginCore.getParam("logqueuepolicy" + name))
+	{
+		if (*queuepolicy == "block") { BlabbleLogging::setQueuePolicy(lane, BlabbleLogging::overflowBlock); }
+		else if (*queuepolicy == "dropoldest") { BlabbleLogging::setQueuePolicy(lane, BlabbleLogging::overflowDropOldest); }
+		else if (*queuepolicy == "dropnewest") { BlabbleLogging::setQueuePolicy(lane, BlabbleLogging::overflowDropNewest); }
+		else
+		{
+			BLABBLE_LOG_ERROR("Unknown logqueuepolicy" << name << " " << *queuepolicy << " (block, dropoldest or dropnewest): the default one is used");
+			return;
+		}
+
+		BLABBLE_LOG_INFO("logqueuepolicy" << name << " set to " << *queuepolicy);
+	}
+}
 
 PjsuaManagerPtr PjsuaManager::GetManager(Blabble& pluginCore)
 {
@@ -63,10 +146,13 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 	optionskatimeout_ = DEFAULT_OPTIONS_KEEP_ALIVE_DELAY_SEC;
 	periodiceventtimeout_ = DEFAULT_PERIODIC_EVENT_TIMEOUT_SEC;
 	answertimeout_ = DEFAULT_ANSWER_TIMEOUT_SEC;
+	sip_poll_budget_ = DEFAULT_SIP_POLL_BUDGET_MSEC;
+	call_events_ = boost::make_shared<CallEventQueue>(CALL_EVENT_QUEUE_SIZE);
+	sip_poll_stop_ = boost::make_shared<std::atomic_bool>(false);
 
 	// REITEK: Get/parse parameters passed to the plugin upon manager creation
 
-	boost::optional<std::string> logging, loggingasyncparam, ice, ecalgo, optionskatimeout, periodiceventtimeout, answertimeout, loglevelparam;
+	boost::optional<std::string> logging, loggingasyncparam, logcompression, loguploadrate, loguploadratecall, logrepeatinterval, logsitelimit, logsenderlevels, ice, ecalgo, optionskatimeout, periodiceventtimeout, answertimeout, sipthreads, mediathreads, sippollbudget, loglevelparam;
 	bool enableIce = false;
 
 	bool loggingAsync = true;
@@ -85,16 +171,65 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 		BlabbleLogging::init(loggingAsync);
 	}
 
+	BLABBLE_LOG_INFO(FBSTRING_PluginName << " version " << FBSTRING_PLUGIN_VERSION);
+
+	BLABBLE_LOG_INFO("async logging " << (loggingAsync ? "enabled" : "disabled"));
+
+	// REITEK: Bound the memory used by the async logging queues (when the disk stalls)
+	SetLogQueueLimits(pluginCore, BlabbleLogging::laneSIP, "sip");
+	SetLogQueueLimits(pluginCore, BlabbleLogging::laneAD, "ad");
+
+	// REITEK: Codec used to compress the rotated log files (deflate level 6 by default, as ZipLib does)
+	if (logcompression = pluginCore.getParam("logcompression"))
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string(FBSTRING_PluginName) + std::string(" version ") + std::string(FBSTRING_PLUGIN_VERSION);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		const int level = std::stoi(pluginCore.getParam("logcompressionlevel").get_value_or("6"));
+
+		if ((*logcompression == "store") || (*logcompression == "deflate") || (*logcompression == "bzip2"))
+		{
+			if (*logcompression == "store") { BlabbleLogging::setLogCompression(BlabbleLogging::compressionStore, level); }
+			else if (*logcompression == "deflate") { BlabbleLogging::setLogCompression(BlabbleLogging::compressionDeflate, level); }
+			else { BlabbleLogging::setLogCompression(BlabbleLogging::compressionBzip2, level); }
+
+			BLABBLE_LOG_INFO("logcompression set to " << *logcompression << " (level " << level << ")");
+		}
+		else
+		{
+			BLABBLE_LOG_ERROR("Unknown logcompression " << *logcompression << " (store, deflate or bzip2): the default one is used");
+		}
 	}
 
+	// REITEK: Log upload rate (bytes/s), in general and while any call has active media
+	loguploadrate = pluginCore.getParam("loguploadrate");
+	loguploadratecall = pluginCore.getParam("loguploadratecall");
+	if (loguploadrate || loguploadratecall)
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 " + std::string("async logging ") + (loggingAsync ? "enabled" : "disabled");
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		const int rate = std::stoi(loguploadrate.get_value_or("0"));
+		const int rateCall = std::stoi(loguploadratecall.get_value_or("16384"));
+
+		BlabbleLogging::setUploadRate((rate > 0) ? rate : 0, (rateCall > 0) ? rateCall : 0);
+
+		BLABBLE_LOG_INFO("loguploadrate set to " << ((rate > 0) ? rate : 0) << ", loguploadratecall set to " << ((rateCall > 0) ? rateCall : 0));
+	}
+
+	// REITEK: Collapse of repeated log lines (seconds, 0 disables it)
+	if (logrepeatinterval = pluginCore.getParam("logrepeatinterval"))
+	{
+		const int interval = std::stoi(*logrepeatinterval);
+
+		BlabbleLogging::setRepeatInterval((interval > 0) ? interval : 0);
+
+		BLABBLE_LOG_INFO("logrepeatinterval set to " << ((interval > 0) ? interval : 0));
+	}
+
+	// REITEK: Limit of the lines logged by each call site of the plugin (lines every logsiteinterval seconds, 0 means no limit)
+	if (logsitelimit = pluginCore.getParam("logsitelimit"))
+	{
+		const int limit = std::stoi(*logsitelimit);
+		const int interval = std::stoi(pluginCore.getParam("logsiteinterval").get_value_or("60"));
+
+		BlabbleLogging::setSiteLimit((limit > 0) ? limit : 0, (interval > 0) ? interval : 1);
+
+		BLABBLE_LOG_INFO("logsitelimit set to " << ((limit > 0) ? limit : 0) << " (every " << ((interval > 0) ? interval : 1) << "s)");
 	}
 
 	// REITEK: Output the parameters passed to the plugin
@@ -111,21 +246,13 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 			{
 				const std::string& strval = val.convert_cast<std::string>();
 
-				{
-					// !!! UGLY (should automatically conform to pjsip formatting)
-					const std::string str = " INFO:                 " + it->first + std::string(": ") + strval;
-					BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-				}
+				BLABBLE_LOG_INFO(it->first << ": " << strval);
 			}
 		}
 	}
 	else
 	{
-		{
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			const std::string str = " INFO:                 " + std::string("No parameters passed to the plugin");
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-		}
+		BLABBLE_LOG_INFO("No parameters passed to the plugin");
 	}
 
 	if ((ice = pluginCore.getParam("enableice")) && *ice == "true")
@@ -144,11 +271,7 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 	// !!! NOTE: Default value is 0, 64 should be used instead for connectivity over Internet
 	const int ecTailLen = std::stoi(pluginCore.getParam("ectaillen").get_value_or("0"));
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 ectaillen set to " + boost::lexical_cast<std::string>(ecTailLen);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("ectaillen set to " << ecTailLen);
 
 	// !!! NOTE: Default value is 0, 2 should be used instead for connectivity over Internet
 	int ecAlgo = 0;
@@ -160,11 +283,7 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 		else if ((*ecalgo == "2") || (*ecalgo == "suppressor")) { ecAlgo = 2; }
 	}
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 ecalgo set to " + boost::lexical_cast<std::string>(ecAlgo);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("ecalgo set to " << ecAlgo);
 
 	if (optionskatimeout = pluginCore.getParam("optionskatimeout"))
 	{
@@ -182,11 +301,7 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 		optionskatimeout_ = intval;
 	}
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 optionskatimeout set to " + boost::lexical_cast<std::string>(optionskatimeout_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("optionskatimeout set to " << optionskatimeout_);
 
 	if (periodiceventtimeout = pluginCore.getParam("periodiceventtimeout"))
 	{
@@ -200,11 +315,7 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 		periodiceventtimeout_ = intval;
 	}
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 periodiceventtimeout set to " + boost::lexical_cast<std::string>(periodiceventtimeout_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("periodiceventtimeout set to " << periodiceventtimeout_);
 
 	if (answertimeout = pluginCore.getParam("answertimeout"))
 	{
@@ -213,11 +324,7 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 		answertimeout_ = intval;
 	}
 
-	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 answertimeout set to " + boost::lexical_cast<std::string>(answertimeout_);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
-	}
+	BLABBLE_LOG_INFO("answertimeout set to " << answertimeout_);
 
 	pj_status_t status;
 	pjsua_config cfg;
@@ -248,6 +355,70 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 #endif
 	cfg.cb.on_call_tsx_state = &PjsuaManager::OnCallTsxState;
 
+	// REITEK: PJSIP threading model (the PJSUA defaults are kept for the parameters not passed)
+	//
+	// - sipthreads: worker threads polling the SIP events; with 0 they are polled by a plugin thread
+	//   (see PollSipEvents), waiting at most sippollbudget ms for each pjsua_handle_events call
+	// - mediathreads: worker threads of the media endpoint; with 0 RTP/RTCP are polled together with the SIP
+	//   events (the media endpoint shares the SIP ioqueue)
+
+	if (sipthreads = pluginCore.getParam("sipthreads"))
+	{
+		int intval = std::stoi(*sipthreads);
+
+		if (intval < 0)
+		{
+			intval = 0;
+		}
+		else if (intval > (int)PJ_ARRAY_SIZE(pjsua_var.thread))
+		{
+			intval = (int)PJ_ARRAY_SIZE(pjsua_var.thread);
+		}
+
+		cfg.thread_cnt = intval;
+	}
+
+	BLABBLE_LOG_INFO("sipthreads set to " << cfg.thread_cnt);
+
+	if (mediathreads = pluginCore.getParam("mediathreads"))
+	{
+		int intval = std::stoi(*mediathreads);
+
+		if (intval < 0)
+		{
+			intval = 0;
+		}
+		else if (intval > MAX_MEDIA_THREADS)
+		{
+			intval = MAX_MEDIA_THREADS;
+		}
+
+		media_cfg.thread_cnt = intval;
+	}
+
+	BLABBLE_LOG_INFO("mediathreads set to " << media_cfg.thread_cnt);
+
+	if (sippollbudget = pluginCore.getParam("sippollbudget"))
+	{
+		int intval = std::stoi(*sippollbudget);
+
+		if (intval < MIN_SIP_POLL_BUDGET_MSEC)
+		{
+			intval = MIN_SIP_POLL_BUDGET_MSEC;
+		}
+		else if (intval > MAX_SIP_POLL_BUDGET_MSEC)
+		{
+			intval = MAX_SIP_POLL_BUDGET_MSEC;
+		}
+
+		sip_poll_budget_ = intval;
+	}
+
+	if (cfg.thread_cnt == 0)
+	{
+		BLABBLE_LOG_INFO("sippollbudget set to " << sip_poll_budget_);
+	}
+
 	// REITEK: Default log level is 4
 
 	//int loglevel = 4;
@@ -269,19 +440,53 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 		}
 	}
 
-	log_cfg.level = loglevel;
-	log_cfg.console_level = loglevel;
+	// REITEK: Levels of single PJSIP senders (e.g. "pjsua_call.c:5,sip_endpoint.c:5,jbuf.c:3,strm*:3"),
+	// PJSIP must log up to the most verbose one (the other senders are held at loglevel by BlabbleLogging::pjsipLog)
+	int pjsiploglevel = loglevel;
 
+	if (logsenderlevels = pluginCore.getParam("logsenderlevels"))
 	{
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		const std::string str = " INFO:                 log level set to " + boost::lexical_cast<std::string>(loglevel);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		std::istringstream entries(*logsenderlevels);
+		std::string entry;
+
+		while (std::getline(entries, entry, ','))
+		{
+			const std::string::size_type pos = entry.rfind(':');
+			if ((pos == std::string::npos) || (pos == 0))
+				continue;
+
+			const std::string sender = entry.substr(0, pos);
+			int senderlevel = std::stoi(entry.substr(pos + 1));
+
+			// !!! NOTE: log level 6 is UNUSABLE !!!
+			if (senderlevel > 5)
+				senderlevel = 5;
+
+			if (!BlabbleLogging::setSenderLogLevel(sender, senderlevel))
+				continue;
+
+			if (senderlevel > pjsiploglevel)
+				pjsiploglevel = senderlevel;
+
+			BLABBLE_LOG_INFO("log level of sender " << sender << " set to " << senderlevel);
+		}
 	}
 
+	BlabbleLogging::setSenderDefaultLogLevel(loglevel);
+
+	log_cfg.level = pjsiploglevel;
+	log_cfg.console_level = pjsiploglevel;
+
+	// REITEK: The plugin own logs (BLABBLE_LOG_* macros) honour the same level
+	BlabbleLogging::setLogLevel(loglevel);
+
+	BLABBLE_LOG_INFO("log level set to " << loglevel);
+
 	// REITEK: Log messages!
 	log_cfg.msg_logging = PJ_TRUE;
+	// !!! NOTE: BlabbleLogging::pjsipLog expects the sender right after the level text
 	log_cfg.decor = PJ_LOG_HAS_SENDER | PJ_LOG_HAS_SPACE | PJ_LOG_HAS_LEVEL_TEXT | PJ_LOG_HAS_THREAD_ID | PJ_LOG_HAS_THREAD_SWC;
-	log_cfg.cb = BlabbleLogging::blabbleLog;
+	log_cfg.cb = BlabbleLogging::pjsipLog;
 
 	// UDP transport settings
 
@@ -364,8 +569,7 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 #if 0
 		has_tls_ = status == PJ_SUCCESS;
 		if (!has_tls_) {
-			// !!! UGLY (should automatically conform to pjsip formatting)
-			BLABBLE_LOG_DEBUG(" WARN:                 pjsua_transport_create failed for TLS transport: TLS not enabled");
+			BLABBLE_LOG_WARN("pjsua_transport_create failed for TLS transport: TLS not enabled");
 			this->tls_transport = -1;
 		}
 #endif
@@ -379,14 +583,14 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 		status = pjsua_transport_create(PJSIP_TRANSPORT_UDP6, &tran6_cfg, &this->udp6_transport);
 		if (status != PJ_SUCCESS)
 		{
-			BLABBLE_LOG_DEBUG(" WARN:                 pjsua_transport_create failed for UDP IPv6 transport: UDP IPv6 not enabled");
+			BLABBLE_LOG_WARN("pjsua_transport_create failed for UDP IPv6 transport: UDP IPv6 not enabled");
 			this->udp6_transport = -1;
 		}
 
 		status = pjsua_transport_create(PJSIP_TRANSPORT_TLS6, &tls_tran6_cfg, &this->tls6_transport);
 		if (status != PJ_SUCCESS)
 		{
-			BLABBLE_LOG_DEBUG(" WARN:                 pjsua_transport_create failed for TLS IPv6 transport: TLS IPv6 not enabled");
+			BLABBLE_LOG_WARN("pjsua_transport_create failed for TLS IPv6 transport: TLS IPv6 not enabled");
 			this->tls6_transport = -1;
 		}
 
@@ -421,13 +625,18 @@ PjsuaManager::PjsuaManager(Blabble& pluginCore)
 
 		audio_manager_ = boost::make_shared<BlabbleAudioManager>(pluginCore);
 
-		// !!! UGLY (should automatically conform to pjsip formatting)
-		BLABBLE_LOG_DEBUG(" INFO:                 PjsuaManager startup complete");
+		// REITEK: PJSIP call callbacks are handled by the event dispatcher thread
+		dispatcher_ = std::thread(&PjsuaManager::DispatchCallEvents, this, call_events_);
+
+		// REITEK: Without PJSIP worker threads the SIP (and media, if they share the ioqueue) events are polled by the plugin
+		if (cfg.thread_cnt == 0)
+			sip_poller_ = std::thread(&PjsuaManager::PollSipEvents, sip_poll_stop_, sip_poll_budget_);
+
+		BLABBLE_LOG_INFO("PjsuaManager startup complete");
 	}
 	catch (std::runtime_error& e)
 	{
-		const std::string str = "Error during PjsuaManager startup: " + boost::lexical_cast<std::string>(e.what());
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("Error during PjsuaManager startup: " << e.what());
 
 		pjsua_destroy();
 		throw e;
@@ -438,11 +647,48 @@ PjsuaManager::~PjsuaManager()
 {
 	pjsua_call_hangup_all();
 
+	if (dispatcher_.get_id() == std::this_thread::get_id())
+	{
+		/**
+		*	REITEK: A call event handler dropped the last reference to the manager: the event dispatcher thread
+		*	can't join itself. The events still queued are dropped (pjsua_destroy ends their calls), the thread
+		*	stops as soon as it is back into DispatchCallEvents, without touching the manager anymore
+		*/
+		call_events_->clear();
+		call_events_->push(CallEvent(CallEvent::stopDispatcher, PJSUA_INVALID_ID, PJSUA_INVALID_ID));
+
+		dispatcher_.detach();
+	}
+	else
+	{
+		// REITEK: Let the event dispatcher thread handle the events already queued, then stop it
+		// (pjsua_destroy waits for the calls still not disconnected)
+		call_events_->push(CallEvent(CallEvent::stopDispatcher, PJSUA_INVALID_ID, PJSUA_INVALID_ID));
+
+		if (dispatcher_.joinable())
+			dispatcher_.join();
+	}
+
+	BLABBLE_LOG_INFO(callEventCount.load() << " call events handled with " << callInfoCount.load() << " pjsua_call_get_info calls, " << callEventOverflowCount.load() << " overflowed");
+
 	accounts_.clear();
 
 	if (audio_manager_)
 		audio_manager_.reset();
 
+	// The entries of the dispatch table retired by the calls ended above (and by the event dispatcher thread)
+	FreeRetiredCallTableEntries();
+
+	// REITEK: The hangups and unregistrations above still need the SIP events to be polled,
+	// pjsua_destroy polls them by itself (when there are no PJSIP worker threads)
+	*sip_poll_stop_ = true;
+
+	// Same as above, if a PJSIP callback polled by the thread dropped the last reference to the manager
+	if (sip_poller_.get_id() == std::this_thread::get_id())
+		sip_poller_.detach();
+	else if (sip_poller_.joinable())
+		sip_poller_.join();
+
 	pjsua_destroy();
 
 	BlabbleLogging::deinit();
@@ -486,6 +732,212 @@ void PjsuaManager::SetCodecPriority(const char* codec, int value)
 	pjsua_codec_set_priority(pj_cstr(&tmpstr, codec), value);
 }
 
+/**
+*	REITEK: Copy what the handlers of the PJSIP call events read of the call info (see CallStateInfo)
+*/
+static void CopyCallStateInfo(const pjsua_call_info& from, CallStateInfo& to)
+{
+	to.state = from.state;
+	to.media_status = from.media_status;
+	to.last_status = from.last_status;
+	to.conf_slot = from.conf_slot;
+}
+
+//Static
+pj_status_t PjsuaManager::GetCallInfo(pjsua_call_id call_id, pjsua_call_info *info)
+{
+	callInfoCount.fetch_add(1, std::memory_order_relaxed);
+
+	return pjsua_call_get_info(call_id, info);
+}
+
+//Static
+void PjsuaManager::GetCallEventStats(unsigned long& events, unsigned long& callInfo, unsigned long& overflowed)
+{
+	events = callEventCount.load(std::memory_order_relaxed);
+	callInfo = callInfoCount.load(std::memory_order_relaxed);
+	overflowed = callEventOverflowCount.load(std::memory_order_relaxed);
+}
+
+//Static
+CallTableEntry* PjsuaManager::RegisterCall(pjsua_call_id call_id, const BlabbleCallPtr& call)
+{
+	if (!IsCallTableIndex(call_id))
+		return NULL;
+
+	CallTableEntry *entry = new CallTableEntry;
+	entry->global_id = call->id();
+	entry->call = call;
+	entry->next = NULL;
+
+	// !!! NOTE: An entry left by a previous call is retired by that call (see UnregisterCall)
+	callTable[call_id].store(entry, std::memory_order_release);
+
+	return entry;
+}
+
+//Static
+void PjsuaManager::UnregisterCall(pjsua_call_id call_id, CallTableEntry* entry)
+{
+	if (entry == NULL)
+		return;
+
+	// The entry may have already been replaced by the one of a new call
+	CallTableEntry *expected = entry;
+	callTable[call_id].compare_exchange_strong(expected, NULL, std::memory_order_acq_rel);
+
+	entry->next = retiredCallTableEntries.load(std::memory_order_relaxed);
+	while (!retiredCallTableEntries.compare_exchange_weak(entry->next, entry, std::memory_order_release, std::memory_order_relaxed))
+		;
+}
+
+//Static
+bool PjsuaManager::IsRegisteredCall(pjsua_call_id call_id, const CallTableEntry* entry)
+{
+	if (entry == NULL || !IsCallTableIndex(call_id))
+		return false;
+
+	return callTable[call_id].load(std::memory_order_acquire) == entry;
+}
+
+//Static
+BlabbleCallPtr PjsuaManager::FindCall(pjsua_call_id call_id, unsigned int global_id)
+{
+	if (!IsCallTableIndex(call_id))
+		return BlabbleCallPtr();
+
+	CallTableEntry *entry = callTable[call_id].load(std::memory_order_acquire);
+	if (entry != NULL && entry->global_id == global_id)
+		return entry->call.lock();
+
+	return BlabbleCallPtr();
+}
+
+/**
+*	REITEK: Called by the PJSIP callbacks (the global id is read now, the PJSIP call may be gone when the event is handled)
+*
+*	!!! NOTE: The dispatch table is looked up by the event dispatcher thread (see FindCall), not here: it frees the retired
+*	entries between two events, so a PJSIP thread could read an entry while it is freed
+*/
+void PjsuaManager::QueueCallEvent(CallEvent& event)
+{
+	unsigned int *internalId = (unsigned int*)pjsua_call_get_user_data(event.call_id);
+	event.global_id = internalId ? *internalId : 0;
+
+	// !!! NOTE: It never waits: when the ring is full the event goes into the overflow list, drained by the dispatcher
+	const std::size_t overflow = call_events_->push(event);
+	if (overflow > 0)
+	{
+		const unsigned long overflowed = callEventOverflowCount.fetch_add(1, std::memory_order_relaxed) + 1;
+
+		// Once per burst: the next events follow this one until the dispatcher has drained the overflow list
+		if (overflow == 1)
+			BLABBLE_LOG_WARN("Call event queue full (" << CALL_EVENT_QUEUE_SIZE << " events): the event dispatcher thread is late, events go into the overflow list (" << overflowed << " so far)");
+	}
+}
+
+// REITEK: Event dispatcher thread
+void PjsuaManager::DispatchCallEvents(boost::shared_ptr<CallEventQueue> events)
+{
+	// !!! NOTE: Threads not created by PJSIP must be registered before calling it
+	pj_thread_desc desc;
+	pj_thread_t *thread = NULL;
+
+	pj_bzero(desc, sizeof(desc));
+	if (pj_thread_register("blabble_events", desc, &thread) != PJ_SUCCESS)
+	{
+		BLABBLE_LOG_ERROR("Could not register the event dispatcher thread");
+	}
+
+	for (;;)
+	{
+		CallEvent event = events->blocking_pop();
+		if (event.type == CallEvent::stopDispatcher)
+			break;
+
+		// !!! NOTE: The manager may be destroyed by the handler (see ~PjsuaManager), only events is used afterwards
+		try
+		{
+			DispatchCallEvent(event);
+		}
+		catch (std::exception& e)
+		{
+			BLABBLE_LOG_ERROR("PjsuaManager failed to handle event " << (int)event.type << " for PJSIP call id " << event.call_id << ": " << e.what());
+		}
+
+		// No entry of the dispatch table is in use here
+		FreeRetiredCallTableEntries();
+	}
+}
+
+//Static
+void PjsuaManager::PollSipEvents(boost::shared_ptr<std::atomic_bool> stop, unsigned int budget)
+{
+	// !!! NOTE: Threads not created by PJSIP must be registered before calling it
+	pj_thread_desc desc;
+	pj_thread_t *thread = NULL;
+
+	pj_bzero(desc, sizeof(desc));
+	if (pj_thread_register("blabble_poll", desc, &thread) != PJ_SUCCESS)
+	{
+		BLABBLE_LOG_ERROR("Could not register the SIP events polling thread");
+	}
+
+	while (!stop->load(std::memory_order_relaxed))
+	{
+		// Returns as soon as some events have been handled, or after budget ms (errors are logged by PJSIP)
+		pjsua_handle_events(budget);
+	}
+}
+
+void PjsuaManager::DispatchCallEvent(const CallEvent& event)
+{
+	// The account notifies the incoming call, the other events go straight to the call
+	if (event.type == CallEvent::callIncoming)
+	{
+		BlabbleAccountPtr acc = FindAcc(event.acc_id);
+		if (!acc || !acc->HandleIncomingCall(event.call_id, event.global_id, event.must_answer))
+		{
+			/**
+			*	Otherwise we respond busy if no one wants the call, but only while the PJSIP call id is still
+			*	the one of this call: once it ended PJSIP may have reused the id for a new call (OnIncomingCall
+			*	already rejects, on the PJSIP thread, the calls it can't hand over to an account)
+			*/
+			if (FindCall(event.call_id, event.global_id))
+				pjsua_call_hangup(event.call_id, 486, NULL, NULL);
+			else
+				BLABBLE_LOG_INFO("PJSIP call id " << event.call_id << " not rejected: the call with global id " << event.global_id << " has already ended");
+		}
+
+		return;
+	}
+
+	BlabbleCallPtr call = FindCall(event.call_id, event.global_id);
+	if (!call)
+	{
+		BLABBLE_LOG_INFO("Received call event " << (int)event.type << " for unknown PJSIP call id " << event.call_id << ", on PJSIP account id " << event.acc_id);
+		return;
+	}
+
+	switch (event.type)
+	{
+	case CallEvent::callState:
+		call->OnCallState(event.call_id, event.info);
+		break;
+
+	case CallEvent::callMediaState:
+		call->OnCallMediaState(event.info);
+		break;
+
+	case CallEvent::callTsxState:
+		call->HandleCallTsxEvent(event.tsx_event, event.status_code);
+		break;
+
+	default:
+		break;
+	}
+}
+
 //Event handlers
 
 //Static
@@ -505,8 +957,7 @@ void PjsuaManager::OnTransportState(pjsip_transport *tp, pjsip_transport_state s
 //Static
 void PjsuaManager::OnIncomingCall(pjsua_acc_id acc_id, pjsua_call_id call_id, pjsip_rx_data *rdata)
 {
-	const std::string str = "OnIncomingCall called for PJSIP account id " + boost::lexical_cast<std::string>(acc_id)+", PJSIP call id " + boost::lexical_cast<std::string>(call_id);
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_INFO("OnIncomingCall called for PJSIP account id " << acc_id << ", PJSIP call id " << call_id);
 
 	if (rdata != NULL)
 	{
@@ -522,8 +973,7 @@ void PjsuaManager::OnIncomingCall(pjsua_acc_id acc_id, pjsua_call_id call_id, pj
 			pjsip_generic_string_hdr* hdr = (pjsip_generic_string_hdr*)pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, &hdrName, NULL);
 			if (hdr == NULL)
 			{
-				const std::string str = "PJSIP call id " + boost::lexical_cast<std::string>(call_id) + ": declining the incoming call";
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+				BLABBLE_LOG_INFO("PJSIP call id " << call_id << ": declining the incoming call");
 
 				pjsua_call_hangup(call_id, 603, NULL, NULL);
 
@@ -541,6 +991,8 @@ void PjsuaManager::OnIncomingCall(pjsua_acc_id acc_id, pjsua_call_id call_id, pj
 		return;
 	}
 
+	callEventCount.fetch_add(1, std::memory_order_relaxed);
+
 	// REITEK: Prefer local codec ordering (!!! CHECK: Make it configurable ?)
 
 	pjsua_call *call;
@@ -555,26 +1007,40 @@ void PjsuaManager::OnIncomingCall(pjsua_acc_id acc_id, pjsua_call_id call_id, pj
 			status = pjmedia_sdp_neg_set_prefer_remote_codec_order(call->inv->neg, PJ_FALSE);
 			if (status != PJ_SUCCESS)
 			{
-				const std::string str = "Could not set codec negotiation preference on local side for PJSIP account id " + boost::lexical_cast<std::string>(acc_id)+", PJSIP call id " + boost::lexical_cast<std::string>(call_id);
-				BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+				BLABBLE_LOG_WARN("Could not set codec negotiation preference on local side for PJSIP account id " << acc_id << ", PJSIP call id " << call_id);
 			}
 		}
 		else
 		{
-			const std::string str = "WARNING: NULL SDP negotiator: cannot set codec negotiation preference on local side for PJSIP account id " + boost::lexical_cast<std::string>(acc_id)+", PJSIP call id " + boost::lexical_cast<std::string>(call_id);
-			BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+			BLABBLE_LOG_WARN("NULL SDP negotiator: cannot set codec negotiation preference on local side for PJSIP account id " << acc_id << ", PJSIP call id " << call_id);
 		}
 
 		pjsip_dlg_dec_lock(dlg);
 	}
 	else {
-		const std::string str = "Could not acquire lock to set codec negotiation preference on local side for PJSIP account id " + boost::lexical_cast<std::string>(acc_id)+", PJSIP call id " + boost::lexical_cast<std::string>(call_id);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_WARN("Could not acquire lock to set codec negotiation preference on local side for PJSIP account id " << acc_id << ", PJSIP call id " << call_id);
+	}
+
+	pjsua_call_info info;
+	if ((status = GetCallInfo(call_id, &info)) != PJ_SUCCESS)
+	{
+		BLABBLE_LOG_ERROR("PjsuaManager::OnIncomingCall failed to call pjsua_call_get_info for PJSIP call id " << call_id << ", got status: " << status);
 	}
 
+	BlabbleCallPtr newCall;
+
 	BlabbleAccountPtr acc = manager->FindAcc(acc_id);
-	if (acc && acc->OnIncomingCall(call_id, rdata))
+	if (acc && (status == PJ_SUCCESS))
+		newCall = acc->OnIncomingCall(call_id, info);
+
+	if (newCall)
 	{
+		// REITEK: The call is added to the account and rung (or auto answered) by the event dispatcher thread
+		CallEvent event(CallEvent::callIncoming, acc_id, call_id);
+		event.must_answer = BlabbleCall::MustAnswerCall(rdata);
+		event.call = newCall;
+
+		manager->QueueCallEvent(event);
 		return;
 	}
 	
@@ -589,27 +1055,24 @@ void PjsuaManager::OnCallMediaState(pjsua_call_id call_id)
 
 	if (!manager)
 		return;
-	
+
+	callEventCount.fetch_add(1, std::memory_order_relaxed);
+
 	pjsua_call_info info;
 	pj_status_t status;
-	if ((status = pjsua_call_get_info(call_id, &info)) == PJ_SUCCESS) 
+	if ((status = GetCallInfo(call_id, &info)) == PJ_SUCCESS) 
 	{
-		const std::string str = "PjsuaManager::OnCallMediaState called with PJSIP call id " +
-						boost::lexical_cast<std::string>(call_id)+", state: " +
-						boost::lexical_cast<std::string>(info.state) +
-						" (" + std::string(pjsip_inv_state_name(info.state)) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_INFO("PjsuaManager::OnCallMediaState called with PJSIP call id " << call_id << ", state: " << info.state << " (" << pjsip_inv_state_name(info.state) << ")");
 
-		BlabbleAccountPtr acc = manager->FindAcc(info.acc_id);
-		if (acc)
-		{
-			acc->OnCallMediaState(call_id);
-		}
+		// REITEK: The event carries the media state of the call when it changed
+		CallEvent event(CallEvent::callMediaState, info.acc_id, call_id);
+		CopyCallStateInfo(info, event.info);
+
+		manager->QueueCallEvent(event);
 	}
 	else
 	{
-		const std::string str = "PjsuaManager::OnCallMediaState failed to call pjsua_call_get_info for PJSIP call id " + boost::lexical_cast<std::string>(call_id)+", got status: " + boost::lexical_cast<std::string>(status);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("PjsuaManager::OnCallMediaState failed to call pjsua_call_get_info for PJSIP call id " << call_id << ", got status: " << status);
 	}
 
 }
@@ -622,21 +1085,19 @@ void PjsuaManager::OnCallState(pjsua_call_id call_id, pjsip_event *e)
 	if (!manager)
 		return;
 
+	callEventCount.fetch_add(1, std::memory_order_relaxed);
+
 	pjsua_call_info info;
 	pj_status_t status;
-	if ((status = pjsua_call_get_info(call_id, &info)) == PJ_SUCCESS) 
+	if ((status = GetCallInfo(call_id, &info)) == PJ_SUCCESS) 
 	{
-		const std::string str = "PjsuaManager::OnCallState called with PJSIP call id " +
-						boost::lexical_cast<std::string>(call_id)+", state: " +
-						boost::lexical_cast<std::string>(info.state) +
-						" (" + std::string(pjsip_inv_state_name(info.state)) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_INFO("PjsuaManager::OnCallState called with PJSIP call id " << call_id << ", state: " << info.state << " (" << pjsip_inv_state_name(info.state) << ")");
 
-		BlabbleAccountPtr acc = manager->FindAcc(info.acc_id);
-		if (acc)
-		{
-			acc->OnCallState(call_id, e);
-		}
+		// REITEK: The event carries the state of the call (it is gone once disconnected)
+		CallEvent event(CallEvent::callState, info.acc_id, call_id);
+		CopyCallStateInfo(info, event.info);
+
+		manager->QueueCallEvent(event);
 
 		// REITEK: !!! CHECK: If this necessary/wanted?
 		if (info.state == PJSIP_INV_STATE_DISCONNECTED)
@@ -651,8 +1112,7 @@ void PjsuaManager::OnCallState(pjsua_call_id call_id, pjsip_event *e)
 	}
 	else
 	{
-		const std::string str = "PjsuaManager::OnCallState failed to call pjsua_call_get_info for PJSIP call id " + boost::lexical_cast<std::string>(call_id)+", got status: " + boost::lexical_cast<std::string>(status);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("PjsuaManager::OnCallState failed to call pjsua_call_get_info for PJSIP call id " << call_id << ", got status: " << status);
 	}
 }
 
@@ -665,20 +1125,20 @@ void PjsuaManager::OnCallTsxState(pjsua_call_id call_id, pjsip_transaction *tsx,
 	if (!manager)
 		return;
 
+	callEventCount.fetch_add(1, std::memory_order_relaxed);
+
 	pjsua_call_info info;
 	pj_status_t status;
-	if ((status = pjsua_call_get_info(call_id, &info)) == PJ_SUCCESS)
+	if ((status = GetCallInfo(call_id, &info)) == PJ_SUCCESS)
 	{
-		const std::string str = "PjsuaManager::OnCallTsxState called with PJSIP call id " +
-						boost::lexical_cast<std::string>(call_id) +
-						", state: " + boost::lexical_cast<std::string>(info.state) +
-						" (" + std::string(pjsip_inv_state_name(info.state)) + ")";
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_INFO("PjsuaManager::OnCallTsxState called with PJSIP call id " << call_id << ", state: " << info.state << " (" << pjsip_inv_state_name(info.state) << ")");
 
-		BlabbleAccountPtr acc = manager->FindAcc(info.acc_id);
-		if (acc)
+		// REITEK: Incoming requests are answered right now, what follows is left to the event dispatcher thread
+		CallEvent event(CallEvent::callTsxState, info.acc_id, call_id);
+		event.tsx_event = BlabbleCall::OnCallTsxState(call_id, tsx, e, &event.status_code);
+		if (event.tsx_event != TSX_EVENT_NONE)
 		{
-			acc->OnCallTsxState(call_id, tsx, e);
+			manager->QueueCallEvent(event);
 		}
 
 		// REITEK: !!! CHECK: If this necessary/wanted?
@@ -694,8 +1154,7 @@ void PjsuaManager::OnCallTsxState(pjsua_call_id call_id, pjsip_transaction *tsx,
 	}
 	else
 	{
-		const std::string str = "PjsuaManager::OnCallTsxState failed to call pjsua_call_get_info for PJSIP call id " + boost::lexical_cast<std::string>(call_id)+", got status: " + boost::lexical_cast<std::string>(status);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("PjsuaManager::OnCallTsxState failed to call pjsua_call_get_info for PJSIP call id " << call_id << ", got status: " << status);
 	}
 }
 
@@ -714,8 +1173,7 @@ void PjsuaManager::OnRegState(pjsua_acc_id acc_id)
 	}
 	else
 	{
-		const std::string str = "PjsuaManager::OnRegState failed to find account PJSIP account id " + boost::lexical_cast<std::string>(acc_id);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("PjsuaManager::OnRegState failed to find account PJSIP account id " << acc_id);
 	}
 }
 
@@ -723,8 +1181,7 @@ void PjsuaManager::OnRegState(pjsua_acc_id acc_id)
 //Static
 void PjsuaManager::OnCallTransferStatus(pjsua_call_id call_id, int st_code, const pj_str_t *st_text, pj_bool_t final, pj_bool_t *p_cont)
 {
-	const std::string str = "PjsuaManager::OnCallTransferState called with PJSIP call id " + boost::lexical_cast<std::string>(call_id) + ", state: " + boost::lexical_cast<std::string>(st_code);
-	BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+	BLABBLE_LOG_INFO("PjsuaManager::OnCallTransferState called with PJSIP call id " << call_id << ", state: " << st_code);
 
 	PjsuaManagerPtr manager = PjsuaManager::instance_.lock();
 
@@ -744,8 +1201,7 @@ void PjsuaManager::OnCallTransferStatus(pjsua_call_id call_id, int st_code, cons
 	}
 	else
 	{
-		const std::string str = "PjsuaManager::OnCallTransferStatus failed to call pjsua_call_get_info for PJSIP call id " + boost::lexical_cast<std::string>(call_id)+", got status: " + boost::lexical_cast<std::string>(status);
-		BlabbleLogging::blabbleLog(0, str.c_str(), 0);
+		BLABBLE_LOG_ERROR("PjsuaManager::OnCallTransferStatus failed to call pjsua_call_get_info for PJSIP call id " << call_id << ", got status: " << status);
 	}
 }
 #endif
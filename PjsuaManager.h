@@ -13,6 +13,8 @@ Copyright 2012 Andrew Ofisher
 #include "JSAPIAuto.h"
 #include <string>
 #include <map>
+#include <thread>
+#include <atomic>
 //#include <boost/smart_ptr/shared_ptr.hpp>
 //#include <boost/optional.hpp>
 #include <pjlib.h>
@@ -24,6 +26,8 @@ Copyright 2012 Andrew Ofisher
 #include <pjsua-lib/pjsua.h>
 #include <pjmedia.h>
 #include <pjmedia-codec.h> 
+#include "BlabbleCall.h"
+#include "simple_thread_safe_queue.h"
 
 class Blabble;
 
@@ -75,6 +79,35 @@ public:
 
 	static void SetCodecPriority(const char* codec, int value);
 
+	/*! @Brief REITEK: pjsua_call_get_info for the PJSIP call callbacks (counted, see GetCallEventStats)
+	 *  Each callback takes a single snapshot of the call, passed down to BlabbleAccount and BlabbleCall
+	 */
+	static pj_status_t GetCallInfo(pjsua_call_id call_id, pjsua_call_info *info);
+
+	/*! @Brief REITEK: Number of PJSIP call callbacks, of the pjsua_call_get_info calls made to handle them,
+	 *  and of the events queued into the overflow list because the ring of the event queue was full
+	 */
+	static void GetCallEventStats(unsigned long& events, unsigned long& callInfo, unsigned long& overflowed);
+
+	/*! @Brief REITEK: Add a call to the dispatch table of the PJSIP call events (indexed by PJSIP call id)
+	 *  The returned entry must be passed to UnregisterCall (NULL if call_id is not valid)
+	 */
+	static CallTableEntry* RegisterCall(pjsua_call_id call_id, const BlabbleCallPtr& call);
+
+	/*! @Brief REITEK: Remove a call from the dispatch table (once its PJSIP call ended)
+	 */
+	static void UnregisterCall(pjsua_call_id call_id, CallTableEntry* entry);
+
+	/*! @Brief REITEK: Whether the entry of a call is still the one of its PJSIP call id (not yet replaced by a new call)
+	 *  Any thread may call it (the entry is only compared)
+	 */
+	static bool IsRegisteredCall(pjsua_call_id call_id, const CallTableEntry* entry);
+
+	/*! @Brief REITEK: Find the call with the given global id in the dispatch table (a single atomic load)
+	 *  !!! NOTE: Only the event dispatcher thread may call it (it frees the entries removed from the table)
+	 */
+	static BlabbleCallPtr FindCall(pjsua_call_id call_id, unsigned int global_id);
+
 	//void SetCodecPriorityAll(std::vector<std::pair<std::string, int>> codecMap); ==> NON ESPOSTO
 	
 public:
@@ -121,10 +154,69 @@ public:
 #endif
 
 private:
+	/*! @Brief REITEK: A PJSIP call callback, handled by the event dispatcher thread
+	 *
+	 *  The callbacks only copy here what is needed to handle them, so that the PJSIP thread
+	 *  never waits for the plugin (JavaScript callbacks, audio devices, locks). The events are
+	 *  values (an incoming call event also holds the new call), queued without allocating while the
+	 *  dispatcher keeps up (see CallEventQueue)
+	 */
+	struct CallEvent
+	{
+		enum Type {
+			callIncoming,
+			callState,
+			callMediaState,
+			callTsxState,
+			stopDispatcher
+		};
+
+		CallEvent()
+			: type(stopDispatcher), acc_id(PJSUA_INVALID_ID), call_id(PJSUA_INVALID_ID), global_id(0), info(), must_answer(false), tsx_event(TSX_EVENT_NONE), status_code(0) {}
+
+		CallEvent(Type t, pjsua_acc_id acc, pjsua_call_id call)
+			: type(t), acc_id(acc), call_id(call), global_id(0), info(), must_answer(false), tsx_event(TSX_EVENT_NONE), status_code(0) {}
+
+		Type type;
+		pjsua_acc_id acc_id;
+		pjsua_call_id call_id;
+		unsigned int global_id;		// Global id of the call when the event was queued (0 if none)
+		CallStateInfo info;			// callState and callMediaState only
+		bool must_answer;			// callIncoming only
+		BlabbleCallPtr call;		// callIncoming only: the dispatch table just has a weak reference to the new call
+		CallTsxEvent tsx_event;		// callTsxState only
+		int status_code;			// callTsxState only
+	};
+
+	// Many PJSIP threads push, the event dispatcher thread pops: neither allocate nor lock, unless the ring is full
+	// (then the events go into an overflow list: a PJSIP thread never waits for the dispatcher)
+	typedef util::OverflowRingQueue<CallEvent> CallEventQueue;
+
+	/**
+	*	REITEK: The threads below get the state they share with the manager as shared pointers: the last reference
+	*	to the manager may be dropped by one of them, which then runs the destructor (and can't be joined)
+	*/
+	void QueueCallEvent(CallEvent& event);
+	void DispatchCallEvents(boost::shared_ptr<CallEventQueue> events);
+	void DispatchCallEvent(const CallEvent& event);
+
+	/**
+	*	REITEK: Thread polling the SIP events when PJSIP has no worker threads (sipthreads set to 0)
+	*/
+	static void PollSipEvents(boost::shared_ptr<std::atomic_bool> stop, unsigned int budget);
+
 	BlabbleAccountMap accounts_;
 	BlabbleAudioManagerPtr audio_manager_;
 	pjsua_transport_id udp_transport, tls_transport, udp6_transport, tls6_transport;
 
+	boost::shared_ptr<CallEventQueue> call_events_;
+	std::thread dispatcher_;
+
+	// REITEK: Maximum time (ms) each pjsua_handle_events call of the SIP events polling thread waits for events
+	unsigned int sip_poll_budget_;
+	boost::shared_ptr<std::atomic_bool> sip_poll_stop_;
+	std::thread sip_poller_;
+
 	// REITEK: Disable TLS flag (TLS is handled differently)
 #if 0
 	bool has_tls_;
@@ -27,8 +27,14 @@
 #ifndef UTIL_SIMPLE_THREAD_SAFE_QUEUE_H_
 #define UTIL_SIMPLE_THREAD_SAFE_QUEUE_H_
 
+#include <atomic>
 #include <condition_variable>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <utility>
@@ -62,7 +68,7 @@ template <typename T> class SimpleThreadSafeQueue {
     condvar_.wait(lock, [&] { return !queue_.empty(); });
     T result = std::move(queue_.front());
     queue_.pop();
-    return std::move(result);
+    return result;
   }
 
   util::StatusOr<T> blocking_pop(int wait_ms) {
@@ -87,11 +93,567 @@ template <typename T> class SimpleThreadSafeQueue {
     return util::Status(util::error::UNAVAILABLE, "Size of the queue is 0.");
   }
 
+  // Same as blocking_pop(wait_ms) and pop(), but an empty queue is reported by
+  // returning false instead of building a Status (which allocates its message).
+  bool blocking_pop(T& value, int wait_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::chrono::milliseconds wait_for_duration(wait_ms);
+    condvar_.wait_for(lock, wait_for_duration, [&] { return !queue_.empty(); });
+    return pop_locked(value);
+  }
+
+  bool pop(T& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pop_locked(value);
+  }
+
+  // Pushes all the values of [first, last) with a single lock acquisition.
+  template <typename InputIt> void push_batch(InputIt first, InputIt last) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (; first != last; ++first) {
+      queue_.push(*first);
+    }
+    lock.unlock();
+    condvar_.notify_one();
+  }
+
+  // Pops up to max_count values into out with a single lock acquisition.
+  // Returns the number of values popped.
+  template <typename OutputIt> size_t pop_batch(OutputIt out, size_t max_count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pop_batch_locked(out, max_count);
+  }
+
+  // Same as pop_batch, but waits up to wait_ms for the queue to be non empty.
+  template <typename OutputIt>
+  size_t blocking_pop_batch(OutputIt out, size_t max_count, int wait_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::chrono::milliseconds wait_for_duration(wait_ms);
+    condvar_.wait_for(lock, wait_for_duration, [&] { return !queue_.empty(); });
+    return pop_batch_locked(out, max_count);
+  }
+
   void clear() {
     std::lock_guard<std::mutex> lock(mutex_);
     std::queue<T> tmp;
     queue_.swap(tmp);
   }
+
+ private:
+  bool pop_locked(T& value) {
+    if (queue_.empty()) {
+      return false;
+    }
+    value = std::move(queue_.front());
+    queue_.pop();
+    return true;
+  }
+
+  template <typename OutputIt> size_t pop_batch_locked(OutputIt out, size_t max_count) {
+    size_t count = 0;
+    for (; (count < max_count) && !queue_.empty(); ++count) {
+      *out++ = std::move(queue_.front());
+      queue_.pop();
+    }
+    return count;
+  }
+};
+
+// Lets a thread sleep until a lock-free queue is ready (non empty or non
+// full), while the threads making it ready only take the mutex if someone is
+// actually waiting.
+//
+// The notifier publishes its change before reading waiting_, the waiter sets
+// waiting_ before checking its predicate: the fences make at least one of them
+// see the other, so no wake up is lost.
+class QueueWaiter {
+ public:
+  QueueWaiter() : waiting_(0) {}
+
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      condvar_.notify_all();
+    }
+  }
+
+  template <typename Predicate> void wait(Predicate ready) {
+    if (ready()) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    condvar_.wait(lock, ready);
+    waiting_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  template <typename Predicate> bool wait_for(int wait_ms, Predicate ready) {
+    if (ready()) {
+      return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const bool result =
+        condvar_.wait_for(lock, std::chrono::milliseconds(wait_ms), ready);
+    waiting_.fetch_sub(1, std::memory_order_relaxed);
+    return result;
+  }
+
+ private:
+  std::atomic<int> waiting_;
+  std::mutex mutex_;
+  std::condition_variable condvar_;
+};
+
+namespace internal {
+
+inline size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 2;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+// Shared by the ring queues below: given the lock-free try_push/pop of Ring,
+// it implements the SimpleThreadSafeQueue interface (waiting through
+// QueueWaiter when the ring is full or empty).
+template <typename T, typename Ring> class RingQueueBase {
+ public:
+  typedef T value_type;
+
+  // Waits for room if the queue is full.
+  template<typename... Args> void push(Args&&... args) {
+    T value(std::forward<Args>(args)...);
+    while (!ring().try_push(std::move(value))) {
+      not_full_.wait([&] { return !ring().full(); });
+    }
+  }
+
+  // Pushes all the values of [first, last), waiting for room if needed.
+  template <typename ForwardIt> void push_batch(ForwardIt first, ForwardIt last) {
+    while (first != last) {
+      const size_t count = ring().try_push_batch(first, last);
+      if (count == 0) {
+        not_full_.wait([&] { return !ring().full(); });
+      }
+      std::advance(first, count);
+    }
+  }
+
+  T blocking_pop() {
+    T result;
+    while (!ring().try_pop(result)) {
+      not_empty_.wait([&] { return !ring().empty(); });
+    }
+    return result;
+  }
+
+  util::StatusOr<T> blocking_pop(int wait_ms) {
+    T result;
+    if (blocking_pop(result, wait_ms)) {
+      return std::move(result);
+    }
+    return util::Status(util::error::UNAVAILABLE, "Size of the queue is 0.");
+  }
+
+  util::StatusOr<T> pop() {
+    T result;
+    if (ring().try_pop(result)) {
+      return std::move(result);
+    }
+    return util::Status(util::error::UNAVAILABLE, "Size of the queue is 0.");
+  }
+
+  // Allocation-free variants: false means the queue is empty.
+  bool blocking_pop(T& value, int wait_ms) {
+    if (ring().try_pop(value)) {
+      return true;
+    }
+    not_empty_.wait_for(wait_ms, [&] { return !ring().empty(); });
+    return ring().try_pop(value);
+  }
+
+  bool pop(T& value) {
+    return ring().try_pop(value);
+  }
+
+  template <typename OutputIt> size_t pop_batch(OutputIt out, size_t max_count) {
+    return ring().try_pop_batch(out, max_count);
+  }
+
+  template <typename OutputIt>
+  size_t blocking_pop_batch(OutputIt out, size_t max_count, int wait_ms) {
+    const size_t count = ring().try_pop_batch(out, max_count);
+    if (count > 0) {
+      return count;
+    }
+    not_empty_.wait_for(wait_ms, [&] { return !ring().empty(); });
+    return ring().try_pop_batch(out, max_count);
+  }
+
+  // Only the consumer thread may call it.
+  void clear() {
+    T value;
+    while (ring().try_pop(value)) {
+    }
+  }
+
+ protected:
+  void notify_not_empty() { not_empty_.notify(); }
+  void notify_not_full() { not_full_.notify(); }
+
+ private:
+  Ring& ring() { return static_cast<Ring&>(*this); }
+
+  QueueWaiter not_empty_;
+  QueueWaiter not_full_;
+};
+
+}  // namespace internal
+
+// Bounded queue for a single producer thread and a single consumer thread.
+//
+// It has the same interface of SimpleThreadSafeQueue, but neither push nor pop
+// take a lock (unless the queue is full or empty and a thread has to wait).
+// The capacity is rounded up to a power of two; T must be default
+// constructible and move assignable (the slots are allocated up front).
+template <typename T>
+class SpscRingQueue : public internal::RingQueueBase<T, SpscRingQueue<T> > {
+ public:
+  explicit SpscRingQueue(size_t capacity)
+      : capacity_(internal::RoundUpToPowerOfTwo(capacity)),
+        mask_(capacity_ - 1),
+        buffer_(new T[capacity_]),
+        head_(0),
+        tail_(0),
+        head_cache_(0),
+        tail_cache_(0) {}
+
+  size_t size() {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+
+  bool empty() { return size() == 0; }
+  bool full() { return size() >= capacity_; }
+
+  // Returns false if the queue is full.
+  template<typename... Args> bool try_push(Args&&... args) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (!room(tail, 1)) {
+      return false;
+    }
+    buffer_[tail & mask_] = T(std::forward<Args>(args)...);
+    tail_.store(tail + 1, std::memory_order_release);
+    this->notify_not_empty();
+    return true;
+  }
+
+  // Pushes as many values of [first, last) as fit, publishing them at once.
+  // Returns the number of values pushed.
+  template <typename ForwardIt> size_t try_push_batch(ForwardIt first, ForwardIt last) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t count = 0;
+    for (; (first != last) && room(tail, count + 1); ++first, ++count) {
+      buffer_[(tail + count) & mask_] = *first;
+    }
+    if (count > 0) {
+      tail_.store(tail + count, std::memory_order_release);
+      this->notify_not_empty();
+    }
+    return count;
+  }
+
+  // Returns false if the queue is empty (consumer only).
+  bool try_pop(T& value) {
+    return try_pop_batch(&value, 1) == 1;
+  }
+
+  // Pops up to max_count values into out. Returns the number of values popped.
+  template <typename OutputIt> size_t try_pop_batch(OutputIt out, size_t max_count) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (tail_cache_ - head < max_count) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+    }
+    size_t count = tail_cache_ - head;
+    if (count > max_count) {
+      count = max_count;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      *out++ = std::move(buffer_[(head + i) & mask_]);
+    }
+    if (count > 0) {
+      head_.store(head + count, std::memory_order_release);
+      this->notify_not_full();
+    }
+    return count;
+  }
+
+ private:
+  // Whether count slots are free starting from tail (producer only).
+  bool room(size_t tail, size_t count) {
+    if (tail + count - head_cache_ <= capacity_) {
+      return true;
+    }
+    head_cache_ = head_.load(std::memory_order_acquire);
+    return tail + count - head_cache_ <= capacity_;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<T[]> buffer_;
+
+  // Consumer and producer indexes (each one written by its own thread only),
+  // together with the copy of the other one each thread last read.
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+  size_t head_cache_;
+  size_t tail_cache_;
+};
+
+// Bounded queue for any number of producer threads and a single consumer
+// thread (MultiConsumer false, see MpscRingQueue) or any number of consumer
+// threads (MultiConsumer true, see MpmcRingQueue).
+//
+// It has the same interface of SimpleThreadSafeQueue, but neither push nor pop
+// take a lock (unless the queue is full or empty and a thread has to wait):
+// each slot has a sequence number telling whether it is free or filled for a
+// given position (D. Vyukov's bounded queue). The capacity is rounded up to a
+// power of two; T must be default constructible and move assignable.
+template <typename T, bool MultiConsumer>
+class SequencedRingQueue
+    : public internal::RingQueueBase<T, SequencedRingQueue<T, MultiConsumer> > {
+ public:
+  explicit SequencedRingQueue(size_t capacity)
+      : capacity_(internal::RoundUpToPowerOfTwo(capacity)),
+        mask_(capacity_ - 1),
+        buffer_(new Slot[capacity_]),
+        head_(0),
+        tail_(0) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      buffer_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  size_t size() {
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return (tail > head) ? tail - head : 0;
+  }
+
+  bool empty() {
+    const size_t head = head_.load(std::memory_order_acquire);
+    return !filled(buffer_[head & mask_], head);
+  }
+
+  bool full() { return size() >= capacity_; }
+
+  // Returns false if the queue is full.
+  template<typename... Args> bool try_push(Args&&... args) {
+    size_t position;
+    if (claim(1, position) == 0) {
+      return false;
+    }
+    Slot& slot = buffer_[position & mask_];
+    slot.value = T(std::forward<Args>(args)...);
+    slot.sequence.store(position + 1, std::memory_order_release);
+    this->notify_not_empty();
+    return true;
+  }
+
+  // Pushes as many values of [first, last) as fit (claiming their slots at
+  // once). Returns the number of values pushed.
+  template <typename ForwardIt> size_t try_push_batch(ForwardIt first, ForwardIt last) {
+    size_t position;
+    const size_t count = claim(std::distance(first, last), position);
+    for (size_t i = 0; i < count; ++i, ++first) {
+      Slot& slot = buffer_[(position + i) & mask_];
+      slot.value = *first;
+      slot.sequence.store(position + i + 1, std::memory_order_release);
+    }
+    if (count > 0) {
+      this->notify_not_empty();
+    }
+    return count;
+  }
+
+  // Returns false if the queue is empty.
+  bool try_pop(T& value) {
+    return try_pop_batch(&value, 1) == 1;
+  }
+
+  // Pops up to max_count values into out. Returns the number of values popped.
+  template <typename OutputIt> size_t try_pop_batch(OutputIt out, size_t max_count) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t count;
+    for (;;) {
+      count = 0;
+      while ((count < max_count) && filled(buffer_[(head + count) & mask_], head + count)) {
+        ++count;
+      }
+      if (count == 0) {
+        return 0;
+      }
+      // A single consumer owns the filled slots; otherwise they are claimed
+      // by moving head_ past them (failing if another consumer got there first)
+      if (!MultiConsumer ||
+          head_.compare_exchange_weak(head, head + count, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      Slot& slot = buffer_[(head + i) & mask_];
+      *out++ = std::move(slot.value);
+      slot.sequence.store(head + i + capacity_, std::memory_order_release);
+    }
+    if (!MultiConsumer) {
+      head_.store(head + count, std::memory_order_release);
+    }
+    this->notify_not_full();
+    return count;
+  }
+
+ private:
+  struct Slot {
+    // position if the slot is free for the producer of position,
+    // position + 1 once it has been filled.
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static bool filled(const Slot& slot, size_t position) {
+    return slot.sequence.load(std::memory_order_acquire) == position + 1;
+  }
+
+  // Claims up to count consecutive free slots. Returns how many were claimed
+  // (storing the position of the first one into position).
+  size_t claim(size_t count, size_t& position) {
+    if (count == 0) {
+      return 0;
+    }
+    position = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      // Each slot is checked: with several consumers, the slots are not
+      // necessarily freed in order.
+      size_t claimed = 0;
+      intptr_t diff = 0;
+      while (claimed < count) {
+        const size_t sequence =
+            buffer_[(position + claimed) & mask_].sequence.load(std::memory_order_acquire);
+        diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + claimed);
+        if (diff != 0) {
+          break;
+        }
+        ++claimed;
+      }
+      if (claimed == 0) {
+        const size_t current = tail_.load(std::memory_order_relaxed);
+        if ((diff < 0) && (current == position)) {
+          return 0;  // Full
+        }
+        // Another producer claimed it meanwhile
+        position = current;
+        continue;
+      }
+      if (tail_.compare_exchange_weak(position, position + claimed,
+                                      std::memory_order_relaxed)) {
+        return claimed;
+      }
+    }
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<Slot[]> buffer_;
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+};
+
+template <typename T> using MpscRingQueue = SequencedRingQueue<T, false>;
+
+template <typename T> using MpmcRingQueue = SequencedRingQueue<T, true>;
+
+// Queue for any number of producer threads and a single consumer thread whose
+// push never waits: values go into a MpscRingQueue while it has room, and into
+// an unbounded overflow list (taking a mutex and allocating) while it is full.
+//
+// Once a value went into the overflow list, the next ones follow it there
+// until the consumer drained it, and the consumer empties the ring before
+// taking from the list: the values pushed by each thread keep their order.
+template <typename T> class OverflowRingQueue {
+ public:
+  typedef T value_type;
+
+  explicit OverflowRingQueue(size_t capacity)
+      : ring_(capacity), overflow_size_(0) {}
+
+  // Never waits. Returns 0 if the value went into the ring, otherwise the
+  // number of values in the overflow list (this one included).
+  template<typename... Args> size_t push(Args&&... args) {
+    T value(std::forward<Args>(args)...);
+    if ((overflow_size_.load(std::memory_order_acquire) == 0) &&
+        ring_.try_push(std::move(value))) {
+      ready_.notify();
+      return 0;
+    }
+    size_t size;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      overflow_.push_back(std::move(value));
+      size = overflow_.size();
+      overflow_size_.store(size, std::memory_order_release);
+    }
+    ready_.notify();
+    return size;
+  }
+
+  T blocking_pop() {
+    T result;
+    while (!pop(result)) {
+      ready_.wait([&] {
+        return (overflow_size_.load(std::memory_order_acquire) > 0) || !ring_.empty();
+      });
+    }
+    return result;
+  }
+
+  // False means the queue is empty.
+  bool pop(T& value) {
+    // The overflow list is read first: the values pushed into the ring before
+    // it filled up are then visible too, and are popped before it.
+    const bool overflowed = overflow_size_.load(std::memory_order_acquire) > 0;
+    if (ring_.try_pop(value)) {
+      return true;
+    }
+    if (!overflowed) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    value = std::move(overflow_.front());
+    overflow_.pop_front();
+    overflow_size_.store(overflow_.size(), std::memory_order_release);
+    return true;
+  }
+
+  // Values in the overflow list.
+  size_t overflow_size() { return overflow_size_.load(std::memory_order_acquire); }
+
+  // Only the consumer thread may call it.
+  void clear() {
+    T value;
+    while (pop(value)) {
+    }
+  }
+
+ private:
+  MpscRingQueue<T> ring_;
+  QueueWaiter ready_;
+  std::mutex mutex_;
+  std::deque<T> overflow_;
+  std::atomic<size_t> overflow_size_;
 };
 
 }  // namespace util
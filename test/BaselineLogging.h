@@ -0,0 +1,177 @@
+/**
+*	REITEK: The logging as it was before the rework, kept for the benchmarks to compare against
+*
+*	These are copies of the original code (only turned into inline functions with explicit
+*	state): don't fix them, they must keep costing what the original code cost.
+*/
+
+#ifndef H_BaselineLogging
+#define H_BaselineLogging
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include "boost/filesystem.hpp"
+#include "boost/lexical_cast.hpp"
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "simple_thread_safe_queue.h"
+
+namespace BaselineLogging {
+
+	/**
+	*	Timestamp of the log lines ("dd/mm/YYYY - HH:MM:SS.mmm")
+	*/
+	inline std::string createDateTime()
+	{
+		const boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
+		const boost::posix_time::time_facet *facet = new boost::posix_time::time_facet("%d/%m/%Y - %H:%M:%S.%f");
+
+		std::ostringstream stream;
+		stream.imbue(std::locale(stream.getloc(), facet));
+		stream << now;
+
+		/* Taglio la frazione al millisecondo */
+		return stream.str().substr(0,25);
+	}
+
+	/**
+	*	Date of the names of the rotated log files ("YYYY-mm-dd_HHMMSS")
+	*/
+	inline std::string createDateLog(const std::string& pfx)
+	{
+		std::string tmp = pfx;
+		const boost::posix_time::ptime now = boost::posix_time::second_clock::local_time();
+		const boost::posix_time::time_facet *facet = new boost::posix_time::time_facet("%Y-%m-%d_%H%M%S");
+
+		std::ostringstream stream;
+		stream.imbue(std::locale(stream.getloc(), facet));
+		stream << now;
+
+		tmp.append(stream.str());
+
+		return tmp;
+	}
+
+	inline bool existsFile(const std::string &filepath)
+	{
+		const std::fstream fs = std::fstream(filepath, std::ios::in);
+		const bool open = fs.is_open();
+		return open;
+	}
+
+	/**
+	*	writeLogSIPInternal: each line checks the size of the log file (rotating it), creates the
+	*	log folder, then opens the log file, appends the line and closes it
+	*	(!!! NOTE: The rotated files are not compressed, nor counted, here)
+	*/
+	inline void writeLogSIP(const std::string& logdir, const std::string& filepathSIP, int logDimension, const char* data)
+	{
+		static std::mutex logSIP_mutex_;
+
+		// checkLogSIP
+		if (existsFile(filepathSIP))
+		{
+			if (boost::filesystem::file_size(filepathSIP) >= (static_cast<boost::uintmax_t>(logDimension) * 1024 * 1024))
+			{
+				const std::string logPath = logdir + createDateLog("/PluginSIP_") + ".log";
+
+				boost::filesystem::rename(filepathSIP, logPath.c_str());
+			}
+		}
+
+		// makeLogDir
+		boost::filesystem::create_directories(logdir);
+
+		const std::string str = createDateTime() + " " + boost::lexical_cast<std::string>(data);
+		std::lock_guard<std::mutex> lock(logSIP_mutex_);
+		std::ofstream fs = std::ofstream(filepathSIP, std::ios::app);
+		fs << str << std::endl;
+		fs.flush();
+		fs.close();
+	}
+
+	/**
+	*	The LogHandler thread: a task is allocated for each line, and queued into a locked queue
+	*
+	*	The thread only formats the lines (the original one then wrote each of them with writeLogSIP):
+	*	it is faster than the original one, which can only make the producers contend less.
+	*/
+	class LogHandler
+	{
+	public:
+		struct LogTask
+		{
+			explicit LogTask(const std::string& data) : data_(data) {}
+
+			std::string data_;
+		};
+
+		typedef std::unique_ptr<LogTask> LogTaskPtr;
+
+		LogHandler()
+			: written_(0)
+		{
+			thread_.reset(new std::thread([ this ] {
+				for (;;)
+				{
+					LogTaskPtr task = logtaskqueue_.blocking_pop();
+					if (task.get() == nullptr)
+						return;
+
+					const std::string str = createDateTime() + " " + task->data_;
+					written_ += str.size();
+				}
+			}));
+		}
+
+		~LogHandler()
+		{
+			logtaskqueue_.push(LogTaskPtr());
+
+			std::lock_guard<std::mutex> lock(general_mutex_);
+			thread_->join();
+		}
+
+		void PushTask(LogTask * logTask)
+		{
+			if (logTask == nullptr)
+				return;
+
+			logtaskqueue_.push(LogTaskPtr(logTask));
+		}
+
+		bool IsRunning()
+		{
+			// Methods are not re-entryable.
+			std::lock_guard<std::mutex> lock(general_mutex_);
+
+			return (bool)thread_;
+		}
+
+	private:
+		std::mutex general_mutex_;
+		std::unique_ptr<std::thread> thread_;
+		util::SimpleThreadSafeQueue<LogTaskPtr> logtaskqueue_;
+		std::size_t written_;
+	};
+
+	/**
+	*	blabbleLog: a global mutex, then IsRunning (another mutex), then the queue (a third one)
+	*/
+	inline void blabbleLog(std::mutex& loghandler_mutex_, LogHandler* loghandler, const char* data)
+	{
+		std::lock_guard<std::mutex> lock(loghandler_mutex_);
+		if ((loghandler == nullptr) || !loghandler->IsRunning())
+			return;
+
+		loghandler->PushTask(new LogHandler::LogTask(std::string(data)));
+	}
+}
+
+#endif // H_BaselineLogging
@@ -0,0 +1,111 @@
+/**
+*	REITEK: Helpers shared by the logging benchmarks (they are not run by ctest)
+*/
+
+#ifndef H_BenchCommon
+#define H_BenchCommon
+
+#include <string>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+
+#ifdef __linux__
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+/**
+*	Wall clock time taken by run (ns)
+*/
+inline double benchTime(const std::function<void()>& run)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	run();
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+*	Number of system calls made by run, by all the threads of a traced child process (-1 if it can't be traced)
+*
+*	Each system call stops a traced thread twice (entry and exit): the stops are counted and halved.
+*/
+inline long benchCountSyscalls(const std::function<void()>& run)
+{
+#ifdef __linux__
+	fflush(NULL);
+
+	const pid_t pid = fork();
+	if (pid < 0)
+		return -1;
+
+	if (pid == 0)
+	{
+		if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0)
+			_exit(1);
+
+		raise(SIGSTOP);
+		run();
+		_exit(0);
+	}
+
+	int status = 0;
+	if ((waitpid(pid, &status, 0) != pid) || !WIFSTOPPED(status) ||
+		(ptrace(PTRACE_SETOPTIONS, pid, NULL, (void*)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL)) != 0))
+	{
+		kill(pid, SIGKILL);
+		waitpid(pid, &status, 0);
+		return -1;
+	}
+
+	long stops = 0;
+	ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+	for (;;)
+	{
+		const pid_t tid = waitpid(-1, &status, __WALL);
+		if (tid < 0)
+			break;
+
+		if (!WIFSTOPPED(status))
+			continue;
+
+		int sig = WSTOPSIG(status);
+		if (sig == (SIGTRAP | 0x80))
+		{
+			++stops;
+			sig = 0;
+		}
+		else if ((sig == SIGTRAP) || (sig == SIGSTOP))
+		{
+			// Clone events, and the first stop of the new threads
+			sig = 0;
+		}
+
+		ptrace(PTRACE_SYSCALL, tid, NULL, (void*)(long)sig);
+	}
+
+	return stops / 2;
+#else
+	(void)run;
+	return -1;
+#endif
+}
+
+/**
+*	System calls made by each of the count units of work of run(count) (run(0) being the fixed cost)
+*/
+inline double benchSyscallsPerUnit(const std::function<void(int)>& run, int count)
+{
+	const long base = benchCountSyscalls([&run] { run(0); });
+	const long total = benchCountSyscalls([&run, count] { run(count); });
+
+	if ((base < 0) || (total < 0) || (count <= 0))
+		return -1;
+
+	return (double)(total - base) / count;
+}
+
+#endif // H_BenchCommon
@@ -0,0 +1,150 @@
+/**
+*	REITEK: The queue of the PJSIP call events (util::OverflowRingQueue, see PjsuaManager::QueueCallEvent)
+*
+*	- with the event dispatcher stopped, pushing several rings worth of events returns (PJSIP never waits),
+*	  the events that don't fit into the ring go into the overflow list, then they are all popped in order
+*	- each producer's events are popped once, in order, with a consumer slower than the producers
+*/
+
+#include "simple_thread_safe_queue.h"
+
+#include "TestCommon.h"
+
+#include <thread>
+
+/**
+*	An event pushed by a producer: its index, and its sequence number
+*/
+typedef std::pair<int, int> Event;
+
+static const std::size_t ringSize = 64;
+
+static void testDispatcherStopped()
+{
+	util::OverflowRingQueue<Event> queue(ringSize);
+
+	const int count = (int)(4 * ringSize);
+
+	// A PJSIP thread queuing events while the dispatcher is stuck in a handler
+	std::future<std::vector<std::size_t> > pushed = std::async(std::launch::async, [&queue, count] {
+		std::vector<std::size_t> overflow;
+		for (int i = 0; i < count; ++i)
+			overflow.push_back(queue.push(Event(0, i)));
+		return overflow;
+	});
+
+	const bool returned = (pushed.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+	TEST_CHECK(returned);
+	if (!returned)
+	{
+		// The producer is stuck: popping the events would hide it
+		std::cerr << "push waited for the consumer" << std::endl;
+		std::exit(1);
+	}
+
+	// The ring first, then the overflow list, one more event each time
+	const std::vector<std::size_t> overflow = pushed.get();
+	int wrong = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		if (overflow[i] != ((i < (int)ringSize) ? 0 : i - ringSize + 1))
+			++wrong;
+	}
+
+	TEST_CHECK(wrong == 0);
+	TEST_CHECK(queue.overflow_size() == count - ringSize);
+
+	for (int i = 0; i < count; ++i)
+	{
+		Event event;
+		TEST_CHECK(queue.pop(event) && (event.second == i));
+	}
+
+	Event event;
+	TEST_CHECK(!queue.pop(event));
+	TEST_CHECK(queue.overflow_size() == 0);
+
+	// Once the overflow list has been drained, the ring is used again
+	TEST_CHECK(queue.push(Event(0, count)) == 0);
+	TEST_CHECK(queue.blocking_pop().second == count);
+}
+
+static void testProducers(int producers, int count)
+{
+	util::OverflowRingQueue<Event> queue(ringSize);
+
+	std::vector<std::thread> threads;
+	std::vector<std::vector<int> > popped(producers, std::vector<int>(count, 0));
+	int unordered = 0;
+	std::size_t overflowed = 0;
+
+	threads.push_back(std::thread([&] {
+		std::vector<int> last(producers, -1);
+
+		for (int left = producers * count; left > 0; --left)
+		{
+			const Event event = queue.blocking_pop();
+
+			if (event.second <= last[event.first])
+				++unordered;
+
+			last[event.first] = event.second;
+			++popped[event.first][event.second];
+
+			// Slower than the producers, so that the ring fills up
+			if (left % 1000 == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}));
+
+	std::mutex mutex;
+	for (int p = 0; p < producers; ++p)
+	{
+		threads.push_back(std::thread([&, p] {
+			std::size_t n = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				if (queue.push(Event(p, i)) > 0)
+					++n;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			overflowed += n;
+		}));
+	}
+
+	for (std::size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	int wrong = 0;
+	for (int p = 0; p < producers; ++p)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			if (popped[p][i] != 1)
+				++wrong;
+		}
+	}
+
+	TEST_CHECK(wrong == 0);
+	TEST_CHECK(unordered == 0);
+	TEST_CHECK(overflowed > 0);
+	TEST_CHECK(queue.overflow_size() == 0);
+}
+
+int main(int argc, char* argv[])
+{
+	const int count = (argc > 1) ? atoi(argv[1]) : 100000;
+
+	testDispatcherStopped();
+	testProducers(4, count);
+
+	if (testFailures > 0)
+	{
+		std::cerr << testFailures << " checks failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "OK" << std::endl;
+	return 0;
+}
@@ -0,0 +1,148 @@
+/**
+*	REITEK: logSender uploads the log files as a single zip archive, produced while it is sent
+*
+*	The archive must be exactly as long as the Content-Length announced before sending it,
+*	and hold every rotated log file (compressed) with the usual zip layout.
+*/
+
+#include "TestCommon.h"
+#include "TestHttpServer.h"
+#include "TestZipReader.h"
+
+#include <cstdio>
+#include <curl/curl.h>
+
+static const int lineCount = 20000;
+
+static void writeLines()
+{
+	char line[128];
+
+	for (int i = 0; i < lineCount; ++i)
+	{
+		snprintf(line, sizeof(line), "archive test line %06d .........................................", i);
+		BlabbleLogging::blabbleLog(BlabbleLogging::levelInfo, line, 0);
+	}
+}
+
+int main()
+{
+	testResetLogDir();
+
+	curl_global_init(CURL_GLOBAL_ALL);
+
+	// Rotate every MB, so that the SIP log file is rotated once before the upload
+	BlabbleLogging::setLogDimension(1);
+	BlabbleLogging::setLogNumber(10);
+
+	BlabbleLogging::init(false);
+
+	writeLines();
+
+	TestHttpServer server;
+
+	std::string error;
+	const bool ok = testUpload(BlabbleLogging::logSender, server.url("/upload"), error);
+	TEST_CHECK(ok);
+	if (!ok)
+		std::cerr << "upload failed: " << error << std::endl;
+
+	const std::vector<TestHttpRequest> requests = server.take();
+	TEST_CHECK(requests.size() == 1);
+
+	if (!requests.empty())
+	{
+		const TestHttpRequest& request = requests[0];
+
+		TEST_CHECK(request.method == "PUT");
+		TEST_CHECK(request.path == "/upload");
+		TEST_CHECK(request.header("content-type") == "application/zip");
+		TEST_CHECK(request.header("content-disposition").find(".zip\"") != std::string::npos);
+		TEST_CHECK(request.header("x-log-archive-format") == "2");
+
+		// The size of the archive is computed before it is produced
+		TEST_CHECK(request.header("content-length") == std::to_string(request.body.size()));
+
+		std::vector<TestZipEntry> entries;
+		const bool read = readTestZip(request.body, entries, error);
+		TEST_CHECK(read);
+		if (!read)
+			std::cerr << "bad archive: " << error << std::endl;
+
+		std::vector<int> seen(lineCount, 0);
+		int segmentsSIP = 0;
+		int segmentsAD = 0;
+		bool uploadLogged = false;
+
+		for (std::size_t i = 0; i < entries.size(); ++i)
+		{
+			const TestZipEntry& entry = entries[i];
+
+			// Every rotated log file is uploaded compressed, as a zip file holding only it
+			TEST_CHECK(entry.method == 0);
+			TEST_CHECK(entry.name.size() > 4 && entry.name.compare(entry.name.size() - 4, 4, ".zip") == 0);
+
+			std::vector<TestZipEntry> logs;
+			const bool readLog = readTestZip(entry.data, logs, error);
+			TEST_CHECK(readLog && logs.size() == 1);
+			if (!readLog || logs.size() != 1)
+			{
+				std::cerr << "bad compressed log file " << entry.name << ": " << error << std::endl;
+				continue;
+			}
+
+			TEST_CHECK(logs[0].name == entry.name.substr(0, entry.name.size() - 4) + ".log");
+
+			if (entry.name.compare(0, 10, "PluginSIP_") == 0)
+			{
+				++segmentsSIP;
+
+				for (std::size_t pos = logs[0].data.find("archive test line "); pos != std::string::npos;
+					pos = logs[0].data.find("archive test line ", pos + 1))
+				{
+					const int line = atoi(logs[0].data.c_str() + pos + 18);
+					if ((line >= 0) && (line < lineCount))
+						++seen[line];
+				}
+			}
+			else if (entry.name.compare(0, 13, "AgentDesktop_") == 0)
+			{
+				++segmentsAD;
+
+				uploadLogged = uploadLogged || (logs[0].data.find("Inizio sendZip") != std::string::npos);
+			}
+			else
+			{
+				std::cerr << "unexpected archive entry " << entry.name << std::endl;
+				++testFailures;
+			}
+		}
+
+		// The rotated SIP log file, then the current SIP and AD ones (rotated by the upload)
+		TEST_CHECK(segmentsSIP == 2);
+		TEST_CHECK(segmentsAD == 1);
+		TEST_CHECK(uploadLogged);
+
+		int missing = 0;
+		for (int i = 0; i < lineCount; ++i)
+			missing += (seen[i] != 1) ? 1 : 0;
+		TEST_CHECK(missing == 0);
+	}
+
+	// Nothing is left uncompressed, nor half written
+	TEST_CHECK(testListLogs("PluginSIP_", ".log").empty());
+	TEST_CHECK(testListLogs("", ".tmp").empty());
+
+	BlabbleLogging::deinit();
+
+	curl_global_cleanup();
+
+	if (testFailures > 0)
+	{
+		std::cerr << testFailures << " checks failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "LogArchiveTest passed" << std::endl;
+	return 0;
+}
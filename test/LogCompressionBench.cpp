@@ -0,0 +1,425 @@
+/**
+*	REITEK: Size and CPU time of the codecs that can compress the rotated log files
+*
+*	Without files, a synthetic PJSIP level 5 log is used (see SyntheticLog): the default (deflate level 6,
+*	see logCompression) was chosen on it. Pass rotated PJSIP log files taken from agent PCs to check it.
+*
+*	Usage: LogCompressionBench [log files...]
+*/
+
+#include "BenchCommon.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+
+#include <zlib.h>
+
+#ifdef BENCH_BZIP2
+#include <bzlib.h>
+#endif
+
+static std::string readFile(const char* path)
+{
+	std::ifstream fs(path, std::ios::binary);
+	std::ostringstream stream;
+	stream << fs.rdbuf();
+	return stream.str();
+}
+
+/**
+*	About size bytes of a PJSIP level 5 log, as the plugin writes it: each call of an agent (incoming INVITE
+*	with its SDP, provisional and final responses, ACK, an OPTIONS keep-alive every 60 s, BYE), with the
+*	transaction and dialog state lines, the media stream setup and the statistics PJSIP dumps at the end.
+*	Tags, branches, Call-IDs, ports and the statistics are random, as they are in real logs
+*/
+class SyntheticLog
+{
+public:
+	explicit SyntheticLog(unsigned int seed) : random_(seed), ms_(36000000) {}
+
+	std::string generate(std::size_t size)
+	{
+		while (log_.size() < size)
+			call();
+
+		return log_;
+	}
+
+private:
+	unsigned int rand(unsigned int n) { return random_() % n; }
+
+	std::string hex(unsigned int digits)
+	{
+		static const char chars[] = "0123456789abcdef";
+		std::string str;
+		for (unsigned int i = 0; i < digits; ++i)
+			str += chars[rand(16)];
+		return str;
+	}
+
+	// Timestamp of the plugin, then the PJSIP decor (sender, level text, thread id and indentation)
+	void line(unsigned int advance, const std::string& sender, const char* thread, const std::string& text)
+	{
+		ms_ += advance;
+
+		char prefix[128];
+		snprintf(prefix, sizeof(prefix), "18/10/2026 - %02u:%02u:%02u.%03u %-14s %s ",
+			(ms_ / 3600000) % 24, (ms_ / 60000) % 60, (ms_ / 1000) % 60, ms_ % 1000, sender.c_str(), thread);
+
+		log_ += prefix;
+		log_ += text;
+		log_ += '\n';
+	}
+
+	void message(const char* sender, const char* thread, bool tx, const std::string& first, const std::string& msg)
+	{
+		char text[256];
+		snprintf(text, sizeof(text), "%s %u bytes %s %s 10.10.0.5:5060:\n", tx ? "TX" : "RX", (unsigned int)msg.size(),
+			first.c_str(), tx ? "to UDP" : "from UDP");
+
+		line(rand(3), sender, thread, std::string(".") + text + msg + "--end msg--");
+	}
+
+	std::string sdp(const char* ip, unsigned int port, unsigned int session)
+	{
+		char text[1024];
+		snprintf(text, sizeof(text),
+			"v=0\n"
+			"o=- %u %u IN IP4 %s\n"
+			"s=pjmedia\n"
+			"b=AS:84\n"
+			"t=0 0\n"
+			"a=X-nat:0\n"
+			"m=audio %u RTP/AVP 18 0 8 101\n"
+			"c=IN IP4 %s\n"
+			"b=AS:64000\n"
+			"a=rtpmap:18 G729/8000\n"
+			"a=fmtp:18 annexb=no\n"
+			"a=rtpmap:0 PCMU/8000\n"
+			"a=rtpmap:8 PCMA/8000\n"
+			"a=rtpmap:101 telephone-event/8000\n"
+			"a=fmtp:101 0-16\n"
+			"a=sendrecv\n"
+			"a=rtcp:%u IN IP4 %s\n"
+			"a=ssrc:%u cname:%s\n",
+			session, session + 1, ip, port, ip, port + 1, ip, (unsigned)random_(), hex(16).c_str());
+		return text;
+	}
+
+	std::string headers(const std::string& first, const std::string& via, const std::string& from, const std::string& to,
+		const std::string& callId, unsigned int cseq, const char* method, const std::string& extra, const std::string& body)
+	{
+		char text[2048];
+		snprintf(text, sizeof(text),
+			"%s\n"
+			"Via: SIP/2.0/UDP %s\n"
+			"From: %s\n"
+			"To: %s\n"
+			"Call-ID: %s\n"
+			"CSeq: %u %s\n"
+			"%s"
+			"Content-Length:  %u\n"
+			"\n%s",
+			first.c_str(), via.c_str(), from.c_str(), to.c_str(), callId.c_str(), cseq, method, extra.c_str(),
+			(unsigned int)body.size(), body.c_str());
+		return text;
+	}
+
+	// Registration refresh of the account (every 300 s), challenged by the registrar
+	void registration()
+	{
+		const std::string callId = hex(32);
+		const std::string from = "<sip:1045@10.10.0.5>;tag=" + hex(32);
+		const std::string to = "<sip:1045@10.10.0.5>";
+		const std::string tsx = "tsx0x" + hex(12);
+
+		for (unsigned int cseq = 1; cseq <= 2; ++cseq)
+		{
+			const std::string via = "10.10.1.20:5060;rport;branch=z9hG4bKPj" + hex(32);
+			const std::string auth = (cseq == 1) ? "" : "Authorization: Digest username=\"1045\", realm=\"asterisk\", nonce=\"" +
+				hex(8) + "\", uri=\"sip:10.10.0.5\", response=\"" + hex(32) + "\", algorithm=MD5\n";
+
+			line(0, "pjsua_acc.c", "worker", ".Sending REGISTER request for account 0");
+			message("pjsua_core.c", "worker", true, "Request msg REGISTER/cseq=" + std::to_string(cseq) + " (tdta0x" + hex(12) + ")",
+				headers("REGISTER sip:10.10.0.5 SIP/2.0", via, from, to, callId, cseq, "REGISTER",
+					"Max-Forwards: 70\nContact: <sip:1045@10.10.1.20:5060;ob>\nExpires: 300\n" + auth, ""));
+			line(rand(3), tsx, "worker", ".State changed from Null to Calling, event=TX_MSG");
+			message("pjsua_core.c", "worker", false, "Response msg " + std::string((cseq == 1) ? "401" : "200") + "/REGISTER/cseq=" +
+				std::to_string(cseq) + " (rdata0x" + hex(12) + ")",
+				headers((cseq == 1) ? "SIP/2.0 401 Unauthorized" : "SIP/2.0 200 OK", via + ";received=10.10.1.20", from,
+					to + ";tag=as" + hex(8), callId, cseq, "REGISTER",
+					(cseq == 1) ? "WWW-Authenticate: Digest algorithm=MD5, realm=\"asterisk\", nonce=\"" + hex(8) + "\"\n" :
+						"Expires: 300\nContact: <sip:1045@10.10.1.20:5060;ob>;expires=300\n", ""));
+			line(rand(3), tsx, "worker", ".State changed from Calling to Completed, event=RX_MSG");
+		}
+
+		line(rand(2), "pjsua_acc.c", "worker", "....SIP outbound status for acc 0 is not active");
+		line(0, "pjsua_acc.c", "worker", "....sip:1045@10.10.0.5: registration success, status=200 (OK), will re-register in 300 seconds");
+	}
+
+	void call()
+	{
+		if (ms_ >= next_registration_)
+		{
+			registration();
+			next_registration_ = ms_ + 300000;
+		}
+
+		const unsigned int agent = 1000 + rand(50);
+		const std::string caller = std::to_string(3900000000u + rand(100000000));
+		const std::string callId = hex(8) + "-" + hex(4) + "-" + hex(4) + "-" + hex(4) + "-" + hex(12);
+		const std::string uuid = hex(8) + "-" + hex(4) + "-" + hex(4) + "-" + hex(4) + "-" + hex(12);
+		const std::string via = "10.10.0.5:5060;branch=z9hG4bK" + hex(10);
+		const std::string from = "\"" + caller + "\" <sip:" + caller + "@10.10.0.5>;tag=" + hex(12);
+		const std::string to = "<sip:" + std::to_string(agent) + "@10.10.1.20>";
+		const std::string toTag = to + ";tag=" + hex(8) + "-" + hex(4) + "-" + hex(4) + "-" + hex(4) + "-" + hex(12);
+		const std::string contact = "Contact: <sip:" + std::to_string(agent) + "@10.10.1.20:5060;ob>\n";
+		const std::string inv = "inv0x" + hex(12);
+		const std::string dlg = "dlg0x" + hex(12);
+		const std::string tsx = "tsx0x" + hex(12);
+		const std::string strm = "strm0x" + hex(12);
+		const unsigned int callIndex = rand(2);
+		const unsigned int port = 4000 + 2 * rand(100);
+		const char* worker = "worker";
+		const char* events = "blabble_events";
+
+		char text[512];
+
+		// Incoming INVITE
+		message("pjsua_core.c", worker, false, "Request msg INVITE/cseq=" + std::to_string(101) + " (rdata0x" + hex(12) + ")",
+			headers("INVITE sip:" + std::to_string(agent) + "@10.10.1.20:5060;ob SIP/2.0", via, from, to, callId, 101, "INVITE",
+				"Max-Forwards: 69\nContact: <sip:" + caller + "@10.10.0.5:5060>\nX-2X-CallUUID: " + uuid +
+				"\nAllow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, INFO\nSupported: replaces, timer\n"
+				"Content-Type: application/sdp\n", sdp("10.10.0.5", 10000 + 2 * rand(5000), random_())));
+
+		line(rand(2), "pjsua_call.c", worker, ".Incoming Request msg INVITE/cseq=101 (rdata0x" + hex(12) + ")");
+		snprintf(text, sizeof(text), "..Call %u: remote NAT type is 0 (Unknown)", callIndex);
+		line(0, "pjsua_call.c", worker, text);
+		snprintf(text, sizeof(text), "...Call %u: media %u: initializing media..", callIndex, 0);
+		line(rand(2), "pjsua_media.c", worker, text);
+		snprintf(text, sizeof(text), "....RTP socket reachable at 10.10.1.20:%u", port);
+		line(rand(2), "pjsua_media.c", worker, text);
+		snprintf(text, sizeof(text), "....RTCP socket reachable at 10.10.1.20:%u", port + 1);
+		line(0, "pjsua_media.c", worker, text);
+		line(rand(2), "pjsua_media.c", worker, "..Media index 0 selected for audio call " + std::to_string(callIndex));
+		line(rand(2), dlg, worker, "....UAS dialog created");
+		line(0, dlg, worker, "....Session count inc to 2 by mod-pjsua");
+		line(0, tsx, worker, ".....Transaction created for Request msg INVITE/cseq=101 (rdata0x" + hex(12) + ")");
+		line(0, tsx, worker, ".....Incoming Request msg INVITE/cseq=101 (rdata0x" + hex(12) + ") in state Null");
+		line(0, tsx, worker, "......State changed from Null to Trying, event=RX_MSG");
+		line(0, dlg, worker, ".......Transaction " + tsx + " state changed to Trying");
+		snprintf(text, sizeof(text), "...Call %u: incoming INVITE is handed to the application", callIndex);
+		line(rand(3), "pjsua_call.c", worker, text);
+		snprintf(text, sizeof(text), "OnIncomingCall called for PJSIP account id 0, PJSIP call id %u", callIndex);
+		line(rand(2), "blabble", worker, text);
+
+		// 180 Ringing, then the agent answers (200 OK with SDP)
+		message("pjsua_core.c", worker, true, "Response msg 180/INVITE/cseq=101 (tdta0x" + hex(12) + ")",
+			headers("SIP/2.0 180 Ringing", via, from, toTag, callId, 101, "INVITE", contact, ""));
+		line(rand(2), inv, worker, "....State changed from NULL to EARLY, event=TX_MSG");
+		snprintf(text, sizeof(text), "PjsuaManager::OnCallState called with PJSIP call id %u, state: 2 (EARLY)", callIndex);
+		line(rand(2), "blabble", worker, text);
+
+		line(2000 + rand(6000), "pjsua_call.c", events, "Answering call " + std::to_string(callIndex) + ": code=200");
+		line(rand(5), "pjsua_media.c", events, ".Call " + std::to_string(callIndex) + ": updating media..");
+		line(rand(3), "pjsua_aud.c", events, "..Audio channel update..");
+		line(rand(10), strm, events,
+			"...VAD temporarily disabled");
+		line(rand(3), strm, events,
+			"...Encoder stream started");
+		line(0, strm, events,
+			"...Decoder stream started");
+		line(rand(3), "pjsua_media.c", events, "..Audio updated, stream #0: G729 (sendrecv)");
+		snprintf(text, sizeof(text), "..Conf connect: %u --> 0", 1 + callIndex);
+		line(rand(2), "conference.c", events, text);
+		snprintf(text, sizeof(text), "..Conf connect: 0 --> %u", 1 + callIndex);
+		line(0, "conference.c", events, text);
+
+		message("pjsua_core.c", events, true, "Response msg 200/INVITE/cseq=101 (tdta0x" + hex(12) + ")",
+			headers("SIP/2.0 200 OK", via, from, toTag, callId, 101, "INVITE",
+				contact + "Allow: PRACK, INVITE, ACK, BYE, CANCEL, UPDATE, INFO, SUBSCRIBE, NOTIFY, REFER, MESSAGE, OPTIONS\n"
+				"Supported: replaces, 100rel, timer, norefersub\nSession-Expires: 1800;refresher=uac\nContent-Type: application/sdp\n",
+				sdp("10.10.1.20", port, random_())));
+		line(rand(2), inv, events, "..State changed from EARLY to CONNECTING, event=TX_MSG");
+
+		message("pjsua_core.c", worker, false, "Request msg ACK/cseq=101 (rdata0x" + hex(12) + ")",
+			headers("ACK sip:" + std::to_string(agent) + "@10.10.1.20:5060;ob SIP/2.0",
+				"10.10.0.5:5060;branch=z9hG4bK" + hex(10), from, toTag, callId, 101, "ACK", "Max-Forwards: 70\n", ""));
+		line(rand(2), inv, worker, ".State changed from CONNECTING to CONFIRMED, event=RX_MSG");
+		snprintf(text, sizeof(text), "PJSIP call id %u: first ACK", callIndex);
+		line(rand(2), "blabble", events, text);
+
+		// OPTIONS keep-alive every 60 s while the call lasts
+		const unsigned int keepalives = 1 + rand(6);
+		for (unsigned int i = 0; i < keepalives; ++i)
+		{
+			const std::string kaVia = "10.10.1.20:5060;rport;branch=z9hG4bKPj" + hex(32);
+			const std::string kaTsx = "tsx0x" + hex(12);
+			line(60000, "blabble", worker, "PJSIP call id " + std::to_string(callIndex) + ": sending OPTIONS keep-alive");
+			message("pjsua_core.c", worker, true, "Request msg OPTIONS/cseq=" + std::to_string(2000 + i) + " (tdta0x" + hex(12) + ")",
+				headers("OPTIONS sip:" + caller + "@10.10.0.5:5060 SIP/2.0", kaVia, toTag, from, callId, 2000 + i, "OPTIONS",
+					"Max-Forwards: 70\n" + contact, ""));
+			line(rand(3), kaTsx, worker, ".State changed from Null to Calling, event=TX_MSG");
+			message("pjsua_core.c", worker, false, "Response msg 200/OPTIONS/cseq=" + std::to_string(2000 + i) + " (rdata0x" + hex(12) + ")",
+				headers("SIP/2.0 200 OK", kaVia + ";received=10.10.1.20", toTag, from, callId, 2000 + i, "OPTIONS",
+					"Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, INFO\n", ""));
+			line(rand(3), kaTsx, worker, ".State changed from Calling to Completed, event=RX_MSG");
+			snprintf(text, sizeof(text), "PjsuaManager::OnCallTsxState called with PJSIP call id %u, state: 5 (CONFIRMED)", callIndex);
+			line(rand(2), "blabble", worker, text);
+		}
+
+		// The caller hangs up
+		message("pjsua_core.c", worker, false, "Request msg BYE/cseq=102 (rdata0x" + hex(12) + ")",
+			headers("BYE sip:" + std::to_string(agent) + "@10.10.1.20:5060;ob SIP/2.0",
+				"10.10.0.5:5060;branch=z9hG4bK" + hex(10), from, toTag, callId, 102, "BYE", "Max-Forwards: 70\n", ""));
+		message("pjsua_core.c", worker, true, "Response msg 200/BYE/cseq=102 (tdta0x" + hex(12) + ")",
+			headers("SIP/2.0 200 OK", "10.10.0.5:5060;branch=z9hG4bK" + hex(10), from, toTag, callId, 102, "BYE", "", ""));
+		line(rand(2), inv, worker, ".State changed from CONFIRMED to DISCONNECTED, event=TSX_STATE");
+		snprintf(text, sizeof(text), "PjsuaManager::OnCallState called with PJSIP call id %u, state: 6 (DISCONNECTED)", callIndex);
+		line(rand(2), "blabble", worker, text);
+
+		// Statistics dumped by PJSIP when the media stops
+		const unsigned int seconds = 60 * keepalives + rand(60);
+		char stats[2048];
+		snprintf(stats, sizeof(stats),
+			"..Call %u: stream #0 stats (%u:%02u)\n"
+			"     SSRC=0x%08x, %s\n"
+			"     RX pt=18, last update:%02um%02u.%03us ago\n"
+			"        total %upkt %u.%uKB (%u.%uKB +IP hdr) @avg=%u.%ukbps/%u.%ukbps\n"
+			"        pkt loss=%u (%u.%u%%), discrd=%u (%u.%u%%), dup=0 (0.0%%), reord=%u (0.%u%%)\n"
+			"              (msec)    min     avg     max     last    dev\n"
+			"        loss period: %7u.%03u %7u.%03u %7u.%03u %7u.%03u %7u.%03u\n"
+			"        jitter     : %7u.%03u %7u.%03u %7u.%03u %7u.%03u %7u.%03u\n"
+			"     TX pt=18, ptime=20, last update:%02um%02u.%03us ago\n"
+			"        total %upkt %u.%uKB (%u.%uKB +IP hdr) @avg=%u.%ukbps/%u.%ukbps\n"
+			"        pkt loss=0 (0.0%%), dup=0 (0.0%%), reord=0 (0.0%%)\n"
+			"     RTT msec      : %7u.%03u %7u.%03u %7u.%03u %7u.%03u %7u.%03u",
+			callIndex, seconds / 60, seconds % 60, (unsigned)random_(), hex(16).c_str(),
+			rand(60), rand(60), rand(1000),
+			seconds * 50 - rand(100), seconds, rand(10), seconds * 2, rand(10), 8, rand(10), 24, rand(10),
+			rand(50), rand(2), rand(10), rand(20), rand(2), rand(10), rand(5), rand(10),
+			rand(100), rand(1000), rand(100), rand(1000), rand(200), rand(1000), rand(100), rand(1000), rand(50), rand(1000),
+			rand(10), rand(1000), rand(30), rand(1000), rand(80), rand(1000), rand(30), rand(1000), rand(20), rand(1000),
+			rand(60), rand(60), rand(1000),
+			seconds * 50, seconds, rand(10), seconds * 2, rand(10), 8, rand(10), 24, rand(10),
+			rand(50), rand(1000), rand(80), rand(1000), rand(200), rand(1000), rand(80), rand(1000), rand(40), rand(1000));
+		line(rand(10), "pjsua_media.c", worker, stats);
+
+		line(rand(2), strm, worker, ".JB summary:\n"
+			"  size=" + std::to_string(rand(8)) + "/eff=" + std::to_string(rand(8)) + " prefetch=0 level=" + std::to_string(rand(4)) +
+			"\n  delay (min/max/avg/dev)=" + std::to_string(20 + rand(40)) + "/" + std::to_string(60 + rand(100)) + "/" +
+			std::to_string(30 + rand(50)) + "/" + std::to_string(rand(20)) + " ms\n  burst (min/max/avg/dev)=0/" +
+			std::to_string(rand(6)) + "/" + std::to_string(rand(3)) + "/" + std::to_string(rand(2)) + " frames\n  lost=" +
+			std::to_string(rand(50)) + " discard=" + std::to_string(rand(20)) + " empty=" + std::to_string(rand(100)));
+		line(rand(2), strm, worker, ".Stream destroyed");
+		snprintf(text, sizeof(text), "..Conf disconnect: %u -x- 0", 1 + callIndex);
+		line(rand(2), "conference.c", worker, text);
+		line(0, dlg, worker, "..Session count dec to 1 by mod-pjsua");
+		line(0, dlg, worker, "..Dialog destroyed");
+		snprintf(text, sizeof(text), "OnCallEnd for PJSIP call id %u, global id %u", callIndex, ++calls_);
+		line(rand(5), "blabble", events, text);
+
+		// Next call
+		ms_ += 1000 + rand(30000);
+	}
+
+	std::mt19937 random_;
+	unsigned int ms_;
+	unsigned int next_registration_ = 0;
+	unsigned int calls_ = 0;
+	std::string log_;
+};
+
+static double cpuTime()
+{
+	timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char* name, const std::string& data, const std::function<std::size_t()>& compress)
+{
+	const double start = cpuTime();
+	const std::size_t size = compress();
+	const double cpu = cpuTime() - start;
+
+	if (size == 0)
+	{
+		printf("%-12s failed\n", name);
+		return;
+	}
+
+	printf("%-12s %10zu bytes  ratio %5.2f  %7.3f s CPU  %8.1f MB/s\n",
+		name, size, (double)data.size() / size, cpu, data.size() / cpu / (1024 * 1024));
+}
+
+static std::size_t deflateSize(const std::string& data, int level)
+{
+	// Raw deflate, as stored within the zip entries
+	z_stream stream = z_stream();
+	if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return 0;
+
+	std::vector<unsigned char> out(deflateBound(&stream, (uLong)data.size()));
+
+	stream.next_in = (Bytef*)data.data();
+	stream.avail_in = (uInt)data.size();
+	stream.next_out = out.data();
+	stream.avail_out = (uInt)out.size();
+
+	const int result = deflate(&stream, Z_FINISH);
+	const std::size_t size = stream.total_out;
+	deflateEnd(&stream);
+
+	return (result == Z_STREAM_END) ? size : 0;
+}
+
+#ifdef BENCH_BZIP2
+static std::size_t bzip2Size(const std::string& data)
+{
+	std::vector<char> out(data.size() + data.size() / 100 + 600);
+	unsigned int size = (unsigned int)out.size();
+
+	if (BZ2_bzBuffToBuffCompress(out.data(), &size, (char*)data.data(), (unsigned int)data.size(), 9, 0, 0) != BZ_OK)
+		return 0;
+
+	return size;
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+	std::string data;
+
+	if (argc > 1)
+	{
+		for (int i = 1; i < argc; ++i)
+			data += readFile(argv[i]);
+
+		printf("%d log files, %zu bytes\n", argc - 1, data.size());
+	}
+	else
+	{
+		data = SyntheticLog(1).generate(10 * 1024 * 1024);
+
+		printf("synthetic PJSIP level 5 log, %zu bytes\n", data.size());
+	}
+
+	if (data.empty())
+		return 1;
+
+	report("deflate 1", data, [&data] { return deflateSize(data, 1); });
+	report("deflate 3", data, [&data] { return deflateSize(data, 3); });
+	report("deflate 6", data, [&data] { return deflateSize(data, 6); });
+	report("deflate 9", data, [&data] { return deflateSize(data, 9); });
+#ifdef BENCH_BZIP2
+	report("bzip2", data, [&data] { return bzip2Size(data); });
+#endif
+
+	return 0;
+}
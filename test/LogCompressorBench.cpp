@@ -0,0 +1,122 @@
+/**
+*	REITEK: Wall clock time to compress the rotated log files, by the LogCompressor threads
+*	(1 to 4 of them) and by the single-threaded path of prepareZIP (compressLogs)
+*
+*	The compression is the one of TestLogZip.cpp (zlib deflate: bzip2 takes more CPU time for
+*	each MB, so it gains more from the threads), of a synthetic PJSIP log; the threads run with
+*	the low priority they have within the plugin.
+*
+*	Usage: LogCompressorBench [files] [MB for each file] [deflate level]
+*/
+
+// LogCompressor is internal to the logging
+#include "BlabbleLogging.cpp"
+
+#include "BenchCommon.h"
+
+#include <cstdlib>
+
+/**
+*	About size bytes of PJSIP log lines (with the SIP messages)
+*/
+static std::string syntheticLog(std::size_t size)
+{
+	std::string log;
+	char line[512];
+
+	for (unsigned int i = 0; log.size() < size; ++i)
+	{
+		snprintf(line, sizeof(line),
+			"18/10/2026 - 10:%02u:%02u.%03u          pjsua_core.c  .TX 612 bytes Request msg INVITE/cseq=%u (tdta%08x) to UDP 10.0.%u.%u:5060:\n"
+			"INVITE sip:%u@pbx.example.com SIP/2.0\n"
+			"Via: SIP/2.0/UDP 10.0.1.20:5060;rport;branch=z9hG4bKPj%08x\n"
+			"Call-ID: %08x-%04x\n"
+			"CSeq: %u INVITE\n"
+			"--end msg--\n",
+			(i / 60) % 60, i % 60, (i * 7) % 1000, i, i * 2654435761u, i % 8, i % 250,
+			3000 + i % 500, i * 40503u, i * 3266489917u, i & 0xffff, i);
+		log += line;
+	}
+
+	return log;
+}
+
+/**
+*	Write the rotated log files into logdir (half SIP, half AD) and index them
+*/
+static void writeLogs(int files, const std::string& log)
+{
+	for (int i = 0; i < files; ++i)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "%s2026-10-18_1000%02d.log", (i % 2 == 0) ? "PluginSIP_" : "AgentDesktop_", i);
+
+		std::ofstream out((BlabbleLogging::logdir + "/" + name).c_str(), std::ios::binary);
+		out.write(log.data(), log.size());
+	}
+
+	BlabbleLogging::logsegments_.rebuild(BlabbleLogging::logdir);
+}
+
+/**
+*	Remove the compressed log files (and check that every file was compressed)
+*/
+static bool removeLogs(int files)
+{
+	int compressed = 0;
+	boost::system::error_code ec;
+
+	for (boost::filesystem::directory_iterator it(BlabbleLogging::logdir, ec), end; !ec && (it != end); it.increment(ec))
+	{
+		if (it->path().extension() == ".zip")
+			++compressed;
+	}
+
+	boost::filesystem::remove_all(BlabbleLogging::logdir, ec);
+	boost::filesystem::create_directories(BlabbleLogging::logdir, ec);
+
+	return compressed == files;
+}
+
+int main(int argc, char* argv[])
+{
+	const int files = (argc > 1) ? atoi(argv[1]) : 10;
+	const std::size_t size = (std::size_t)((argc > 2) ? atoi(argv[2]) : 10) * 1024 * 1024;
+	const int level = (argc > 3) ? atoi(argv[3]) : 6;
+
+	BlabbleLogging::logdir = boost::filesystem::current_path().string() + "/LogCompressorBench.logs";
+	BlabbleLogging::setFilePaths();
+	BlabbleLogging::setLogNumber(files);
+	BlabbleLogging::setLogCompression(BlabbleLogging::compressionDeflate, level);
+
+	removeLogs(0);
+
+	const std::string log = syntheticLog(size);
+
+	printf("%d files of %zu MB, deflate level %d, %u hardware threads (seconds, wall clock)\n",
+		files, size / (1024 * 1024), level, std::thread::hardware_concurrency());
+
+	writeLogs(files, log);
+	const double single = benchTime([] {
+		BlabbleLogging::compressLogs(true);
+		BlabbleLogging::compressLogs(false);
+	}) / 1e9;
+
+	printf("%-16s %8.2f%s\n", "compressLogs", single, removeLogs(files) ? "" : "  !!! files left uncompressed");
+
+	for (unsigned int threads = 1; threads <= 4; ++threads)
+	{
+		writeLogs(files, log);
+		const double wall = benchTime([threads] {
+			BlabbleLogging::logcompressor_.Start(threads);
+			BlabbleLogging::logcompressor_.ScheduleUncompressed();
+			BlabbleLogging::logcompressor_.WaitIdle();
+			BlabbleLogging::logcompressor_.Stop();
+		}) / 1e9;
+
+		printf("%u %-14s %8.2f  x%.2f%s\n", threads, (threads == 1) ? "thread" : "threads", wall, single / wall,
+			removeLogs(files) ? "" : "  !!! files left uncompressed");
+	}
+
+	return 0;
+}
@@ -0,0 +1,143 @@
+/**
+*	REITEK: Threads logging at the same time (as the PJSIP threads do) through blabbleLog
+*
+*	The original blabbleLog took a global mutex, then the one of LogHandler::IsRunning, then the one
+*	of the queue, and allocated a task for each line; now the LogHandler is reached through an atomic
+*	pointer, and each line is copied into a pooled record of the queue of its log file.
+*
+*	Usage: LogContentionBench [lines per thread] [folder]
+*	(!!! NOTE: As in the plugin, logging starts within $HOME/Reitek/Contact/BrowserPlugin, then moves to folder)
+*/
+
+#include "BlabbleLogging.h"
+#include "BaselineLogging.h"
+#include "BenchCommon.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+
+static std::string folder;
+
+/**
+*	Time (ns) taken by the producers, and CPU time they used (the consumer thread is not counted)
+*/
+struct Result
+{
+	double wall;
+	double cpu;
+};
+
+static double threadCpuTime()
+{
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+*	Run threads producers, each one calling log(thread, line) lines times
+*/
+static Result runProducers(int threads, int lines, const std::function<void(int, const char*, int)>& log)
+{
+	std::atomic_int ready(0);
+	std::atomic_bool start(false);
+	std::atomic_llong cpu(0);
+	std::vector<std::thread> producers;
+
+	for (int t = 0; t < threads; ++t)
+	{
+		producers.push_back(std::thread([&, t] {
+			char line[128];
+
+			++ready;
+			while (!start.load())
+				std::this_thread::yield();
+
+			const double begin = threadCpuTime();
+
+			for (int i = 0; i < lines; ++i)
+			{
+				// The lines differ from each other, else they would be collapsed by the repeated lines filter
+				const int len = snprintf(line, sizeof(line), "thread %02d line %08d ....................................................", t, i);
+				log(t, line, len);
+			}
+
+			cpu += (long long)(threadCpuTime() - begin);
+		}));
+	}
+
+	while (ready.load() < threads)
+		std::this_thread::yield();
+
+	Result result;
+	result.wall = benchTime([&] {
+		start.store(true);
+
+		for (std::size_t t = 0; t < producers.size(); ++t)
+			producers[t].join();
+	});
+	result.cpu = (double)cpu.load();
+
+	return result;
+}
+
+static Result runBaseline(int threads, int lines)
+{
+	std::mutex loghandler_mutex;
+	BaselineLogging::LogHandler loghandler;
+
+	return runProducers(threads, lines, [&](int, const char* line, int) {
+		BaselineLogging::blabbleLog(loghandler_mutex, &loghandler, line);
+	});
+}
+
+static Result runCurrent(int threads, int lines)
+{
+	BlabbleLogging::init(true);
+	BlabbleLogging::setLogPath(folder);
+
+	// No line is dropped, nor waits for room in the queue: only the enqueue path is measured
+	BlabbleLogging::setQueueCapacity(BlabbleLogging::laneSIP, 0);
+
+	const Result result = runProducers(threads, lines, [](int, const char* line, int len) {
+		BlabbleLogging::blabbleLog(BlabbleLogging::levelInfo, line, len);
+	});
+
+	if (BlabbleLogging::getDroppedLines(BlabbleLogging::laneSIP) != 0)
+		printf("!!! lines dropped\n");
+
+	BlabbleLogging::deinit();
+
+	boost::filesystem::remove_all(folder);
+
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	const int lines = (argc > 1) ? atoi(argv[1]) : 20000;
+	folder = (argc > 2) ? argv[2] : "LogContentionBench.data";
+
+	printf("%d lines per thread, %u hardware threads\n", lines, std::thread::hardware_concurrency());
+	printf("%8s %18s %18s %18s %18s\n", "threads", "baseline wall", "current wall", "baseline cpu", "current cpu");
+
+	const int counts[] = { 1, 4, 8, 16 };
+
+	for (std::size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+	{
+		const int threads = counts[i];
+		const double total = (double)threads * lines;
+
+		const Result baseline = runBaseline(threads, lines);
+		const Result current = runCurrent(threads, lines);
+
+		// Time per line as seen by each thread (the threads log at the same time), and CPU time per line (ns)
+		printf("%8d %18.0f %18.0f %18.0f %18.0f\n", threads,
+			baseline.wall * threads / total, current.wall * threads / total, baseline.cpu / total, current.cpu / total);
+	}
+
+	return 0;
+}
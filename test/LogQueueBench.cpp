@@ -0,0 +1,182 @@
+/**
+*	REITEK: Producers pushing into a queue drained by a single consumer (as the LogHandler thread does)
+*
+*	- util::SimpleThreadSafeQueue: a mutex and a std::deque (through std::queue)
+*	- util::MpscRingQueue: no lock unless a thread has to wait (the ring of each lane of LogTaskQueue)
+*	- LogTaskQueue: the whole enqueue path of a log line (pooled record, copy of the line, lane of the queue)
+*
+*	Usage: LogQueueBench [items per thread]
+*/
+
+// LogTaskQueue is internal to the logging
+#include "BlabbleLogging.cpp"
+
+#include "BenchCommon.h"
+
+#include <cstdlib>
+
+/**
+*	Time (ns) taken by the producers, and CPU time they used (the consumer thread is not counted)
+*/
+struct Result
+{
+	double wall;
+	double cpu;
+};
+
+static double threadCpuTime()
+{
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+*	Run threads producers calling push(thread, item) items times, while consume() is called until it returns
+*	all the items; !!! NOTE: The consumer gives up after a while if items are lost (which is reported)
+*/
+static Result run(int threads, int items, const std::function<void(int, int)>& push, const std::function<std::size_t()>& consume)
+{
+	std::atomic_int ready(0);
+	std::atomic_bool start(false);
+	std::atomic_llong cpu(0);
+	std::vector<std::thread> producers;
+
+	for (int t = 0; t < threads; ++t)
+	{
+		producers.push_back(std::thread([&, t] {
+			++ready;
+			while (!start.load())
+				std::this_thread::yield();
+
+			const double begin = threadCpuTime();
+
+			for (int i = 0; i < items; ++i)
+				push(t, i);
+
+			cpu += (long long)(threadCpuTime() - begin);
+		}));
+	}
+
+	const std::size_t total = (std::size_t)threads * items;
+
+	std::thread consumer([&] {
+		std::size_t popped = 0;
+		int idle = 0;
+
+		while ((popped < total) && (idle < 100))
+		{
+			const std::size_t count = consume();
+
+			popped += count;
+			idle = (count > 0) ? 0 : idle + 1;
+		}
+
+		if (popped != total)
+			printf("!!! %zu items lost\n", total - popped);
+	});
+
+	while (ready.load() < threads)
+		std::this_thread::yield();
+
+	Result result;
+	result.wall = benchTime([&] {
+		start.store(true);
+
+		for (std::size_t t = 0; t < producers.size(); ++t)
+			producers[t].join();
+	});
+	result.cpu = (double)cpu.load();
+
+	consumer.join();
+
+	return result;
+}
+
+typedef std::pair<int, int> Item;
+
+static Result runDeque(int threads, int items)
+{
+	util::SimpleThreadSafeQueue<Item> queue;
+
+	return run(threads, items,
+		[&queue](int t, int i) { queue.push(Item(t, i)); },
+		[&queue] {
+			Item popped[64];
+			return queue.blocking_pop_batch(popped, 64, 10);
+		});
+}
+
+static Result runRing(int threads, int items)
+{
+	util::MpscRingQueue<Item> queue(BlabbleLogging::logQueueRingSize);
+
+	return run(threads, items,
+		[&queue](int t, int i) { queue.push(Item(t, i)); },
+		[&queue] {
+			Item popped[64];
+			return queue.blocking_pop_batch(popped, 64, 10);
+		});
+}
+
+static Result runLogTaskQueue(int threads, int items)
+{
+	using BlabbleLogging::LogTask;
+
+	BlabbleLogging::LogTaskQueue queue;
+
+	// As the ring: producers wait for room, instead of spilling or dropping lines
+	queue.setLimits(BlabbleLogging::laneSIP, BlabbleLogging::logQueueRingSize, BlabbleLogging::overflowBlock);
+
+	const char* line = "PJSIP log line .................................................................";
+	const std::size_t len = strlen(line);
+
+	return run(threads, items,
+		[&queue, line, len](int, int) {
+			LogTask* task = BlabbleLogging::logtaskpool_.acquire();
+			task->set(LogTask::writeLogSIP, line, len);
+			queue.push(task);
+		},
+		[&queue] {
+			unsigned long dropped[2];
+			std::size_t count = 0;
+
+			LogTask* task = queue.blocking_pop_all(10, dropped);
+			while (task != nullptr)
+			{
+				LogTask* next = task->next();
+				BlabbleLogging::logtaskpool_.release(task);
+				task = next;
+				++count;
+			}
+
+			return count;
+		});
+}
+
+int main(int argc, char* argv[])
+{
+	const int items = (argc > 1) ? atoi(argv[1]) : 200000;
+
+	printf("%d items per thread, %u hardware threads (ns/item: wall as seen by each thread, producer cpu)\n",
+		items, std::thread::hardware_concurrency());
+	printf("%8s %12s %12s %12s %12s %12s %12s\n", "threads", "deque wall", "ring wall", "task wall", "deque cpu", "ring cpu", "task cpu");
+
+	const int counts[] = { 1, 4, 8, 16 };
+
+	for (std::size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+	{
+		const int threads = counts[i];
+		const double total = (double)threads * items;
+
+		const Result deque = runDeque(threads, items);
+		const Result ring = runRing(threads, items);
+		const Result task = runLogTaskQueue(threads, items);
+
+		printf("%8d %12.0f %12.0f %12.0f %12.0f %12.0f %12.0f\n", threads,
+			deque.wall * threads / total, ring.wall * threads / total, task.wall * threads / total,
+			deque.cpu / total, ring.cpu / total, task.cpu / total);
+	}
+
+	return 0;
+}
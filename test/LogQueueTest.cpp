@@ -0,0 +1,282 @@
+/**
+*	REITEK: The lock-free ring queues, and the queue of the LogHandler thread built on them
+*
+*	- each producer's items are popped once, in order, with rings much smaller than the items pushed
+*	- the LogHandler queue spills the lines that don't fit into its ring, still in order
+*	- its overflow policies: drop the newest line, drop the oldest line (but not exit/setLogPath tasks), block
+*/
+
+// LogTaskQueue is internal to the logging
+#include "BlabbleLogging.cpp"
+
+#include "TestCommon.h"
+
+#include <cstdlib>
+
+using BlabbleLogging::LogTask;
+using BlabbleLogging::LogTaskQueue;
+
+/**
+*	An item pushed by a producer: its index, and its sequence number
+*/
+typedef std::pair<int, int> Item;
+
+/**
+*	Push items producers x count items through queue, popping them with consumers threads:
+*	check that each item is popped once, and that each consumer sees the items of a producer in order
+*/
+template <typename Queue> static void testRing(Queue& queue, int producers, int consumers, int count)
+{
+	std::vector<std::thread> threads;
+	std::vector<std::vector<int> > popped(producers, std::vector<int>(count, 0));
+	std::atomic_int left(producers * count);
+	std::atomic_int unordered(0);
+	std::mutex mutex;
+
+	for (int c = 0; c < consumers; ++c)
+	{
+		threads.push_back(std::thread([&] {
+			std::vector<int> last(producers, -1);
+			Item items[16];
+
+			while (left.load() > 0)
+			{
+				const std::size_t n = queue.blocking_pop_batch(items, 16, 10);
+
+				std::lock_guard<std::mutex> lock(mutex);
+
+				for (std::size_t i = 0; i < n; ++i)
+				{
+					if (items[i].second <= last[items[i].first])
+						++unordered;
+
+					last[items[i].first] = items[i].second;
+					++popped[items[i].first][items[i].second];
+				}
+
+				left -= (int)n;
+			}
+		}));
+	}
+
+	for (int p = 0; p < producers; ++p)
+	{
+		threads.push_back(std::thread([&queue, p, count] {
+			// Single and batched pushes
+			for (int i = 0; i < count; i += 4)
+			{
+				if (i % 8 == 0)
+				{
+					const Item items[] = { Item(p, i), Item(p, i + 1), Item(p, i + 2), Item(p, i + 3) };
+					queue.push_batch(items, items + 4);
+				}
+				else
+				{
+					for (int j = i; j < i + 4; ++j)
+						queue.push(Item(p, j));
+				}
+			}
+		}));
+	}
+
+	for (std::size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	int wrong = 0;
+	for (int p = 0; p < producers; ++p)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			if (popped[p][i] != 1)
+				++wrong;
+		}
+	}
+
+	TEST_CHECK(wrong == 0);
+	TEST_CHECK(unordered.load() == 0);
+	TEST_CHECK(queue.size() == 0);
+}
+
+static LogTask* makeTask(LogTask::Type type, int index)
+{
+	const std::string data = boost::lexical_cast<std::string>(index);
+
+	LogTask* task = BlabbleLogging::logtaskpool_.acquire();
+	task->set(type, data.data(), data.size());
+	return task;
+}
+
+/**
+*	Pop all the tasks of the queue: "L<index>" for lines, "P<index>" for setLogPath tasks
+*/
+static std::vector<std::string> popAll(LogTaskQueue& queue, unsigned long (&dropped)[2])
+{
+	std::vector<std::string> tasks;
+
+	LogTask* task = queue.blocking_pop_all(0, dropped);
+	while (task != nullptr)
+	{
+		LogTask* next = task->next();
+
+		tasks.push_back(((task->getType() == LogTask::setLogPath) ? "P" : "L") + task->getStrData());
+		BlabbleLogging::logtaskpool_.release(task);
+
+		task = next;
+	}
+
+	return tasks;
+}
+
+static std::vector<std::string> lines(int first, int last)
+{
+	std::vector<std::string> result;
+	for (int i = first; i <= last; ++i)
+		result.push_back("L" + boost::lexical_cast<std::string>(i));
+	return result;
+}
+
+static void testSpill()
+{
+	LogTaskQueue queue;
+	queue.setLimits(BlabbleLogging::laneSIP, 0, BlabbleLogging::overflowDropNewest);
+
+	// Three rings worth of lines, with nobody popping them
+	const int count = (int)(3 * BlabbleLogging::logQueueRingSize);
+	for (int i = 0; i < count; ++i)
+		queue.push(makeTask(LogTask::writeLogSIP, i));
+
+	TEST_CHECK(queue.size() == (std::size_t)count);
+
+	unsigned long dropped[2];
+
+	// The ring, then the spilled lines
+	TEST_CHECK(popAll(queue, dropped) == lines(0, count - 1));
+	TEST_CHECK(dropped[BlabbleLogging::laneSIP] == 0);
+	TEST_CHECK(queue.size() == 0);
+
+	// Once the spilled lines have been taken, the ring is used again
+	queue.push(makeTask(LogTask::writeLogSIP, count));
+
+	TEST_CHECK(!queue.pending(BlabbleLogging::laneAD) && queue.pending(BlabbleLogging::laneSIP));
+	TEST_CHECK(popAll(queue, dropped) == lines(count, count));
+}
+
+static void testDropNewest()
+{
+	LogTaskQueue queue;
+	queue.setLimits(BlabbleLogging::laneSIP, 10, BlabbleLogging::overflowDropNewest);
+
+	for (int i = 0; i < 15; ++i)
+		queue.push(makeTask(LogTask::writeLogSIP, i));
+
+	unsigned long dropped[2];
+	TEST_CHECK(popAll(queue, dropped) == lines(0, 9));
+	TEST_CHECK(dropped[BlabbleLogging::laneSIP] == 5);
+}
+
+static void testDropOldest()
+{
+	LogTaskQueue queue;
+	queue.setLimits(BlabbleLogging::laneAD, 10, BlabbleLogging::overflowDropOldest);
+
+	// The setLogPath task takes a place, but it is never dropped
+	queue.push(makeTask(LogTask::setLogPath, 0));
+
+	for (int i = 0; i < 15; ++i)
+		queue.push(makeTask(LogTask::writeLogAD, i));
+
+	std::vector<std::string> expected(1, "P0");
+	const std::vector<std::string> kept = lines(6, 14);
+	expected.insert(expected.end(), kept.begin(), kept.end());
+
+	unsigned long dropped[2];
+	TEST_CHECK(popAll(queue, dropped) == expected);
+	TEST_CHECK(dropped[BlabbleLogging::laneAD] == 6);
+
+	// Only setLogPath tasks left: the new line is dropped
+	queue.setLimits(BlabbleLogging::laneAD, 1, BlabbleLogging::overflowDropOldest);
+	queue.push(makeTask(LogTask::setLogPath, 1));
+	queue.push(makeTask(LogTask::writeLogAD, 15));
+
+	TEST_CHECK(popAll(queue, dropped) == std::vector<std::string>(1, "P1"));
+	TEST_CHECK(dropped[BlabbleLogging::laneAD] == 1);
+}
+
+static void testBlock()
+{
+	LogTaskQueue queue;
+	queue.setLimits(BlabbleLogging::laneSIP, 4, BlabbleLogging::overflowBlock);
+
+	const int count = 2000;
+
+	std::thread producer([&queue, count] {
+		for (int i = 0; i < count; ++i)
+			queue.push(makeTask(LogTask::writeLogSIP, i));
+	});
+
+	unsigned long dropped[2];
+	std::vector<std::string> popped;
+
+	while ((int)popped.size() < count)
+	{
+		const std::vector<std::string> tasks = popAll(queue, dropped);
+		TEST_CHECK(tasks.size() <= 4);
+		TEST_CHECK(dropped[BlabbleLogging::laneSIP] == 0);
+
+		popped.insert(popped.end(), tasks.begin(), tasks.end());
+	}
+
+	producer.join();
+
+	TEST_CHECK(popped == lines(0, count - 1));
+
+	// A producer waiting for room gives up when the queue is closed
+	queue.push(makeTask(LogTask::writeLogSIP, 0));
+	queue.setLimits(BlabbleLogging::laneSIP, 1, BlabbleLogging::overflowBlock);
+
+	std::thread blocked([&queue] {
+		queue.push(makeTask(LogTask::writeLogSIP, 1));
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	queue.close();
+	blocked.join();
+
+	TEST_CHECK(popAll(queue, dropped) == lines(0, 0));
+	TEST_CHECK(dropped[BlabbleLogging::laneSIP] == 1);
+}
+
+int main(int argc, char* argv[])
+{
+	// Pushed 4 at a time
+	const int count = ((argc > 1) ? atoi(argv[1]) : 100000) / 4 * 4;
+
+	{
+		util::MpscRingQueue<Item> queue(64);
+		testRing(queue, 4, 1, count);
+	}
+
+	{
+		util::MpmcRingQueue<Item> queue(64);
+		testRing(queue, 4, 3, count);
+	}
+
+	{
+		util::SpscRingQueue<Item> queue(64);
+		testRing(queue, 1, 1, count);
+	}
+
+	testSpill();
+	testDropNewest();
+	testDropOldest();
+	testBlock();
+
+	if (testFailures > 0)
+	{
+		std::cerr << testFailures << " checks failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "OK" << std::endl;
+	return 0;
+}
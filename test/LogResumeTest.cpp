@@ -0,0 +1,203 @@
+/**
+*	REITEK: logSenderIncremental resumes an interrupted upload from the manifest
+*
+*	The first upload fails on the second chunk of a file: the next one must send only the rest
+*	of that file (with a Content-Range header) and the files not sent yet, then the manifest;
+*	a third one must not send again any of the files already uploaded.
+*/
+
+#include "TestCommon.h"
+#include "TestHttpServer.h"
+#include "TestZipReader.h"
+
+#include <map>
+#include <set>
+#include <cstdio>
+#include <curl/curl.h>
+
+static const unsigned long long chunkSize = 1024 * 1024;
+
+static void writeLines(int count)
+{
+	static int next = 0;
+	char line[128];
+
+	for (int i = 0; i < count; ++i, ++next)
+	{
+		snprintf(line, sizeof(line), "resume test line %06d .........................................", next);
+		BlabbleLogging::blabbleLog(BlabbleLogging::levelInfo, line, 0);
+	}
+}
+
+/**
+*	Offset and size of the data of a request (from its Content-Range header, if any)
+*/
+static bool requestRange(const TestHttpRequest& request, unsigned long long& offset, unsigned long long& size)
+{
+	const std::string range = request.header("content-range");
+	if (range.empty())
+	{
+		offset = 0;
+		size = request.body.size();
+		return true;
+	}
+
+	unsigned long long last = 0;
+	return (sscanf(range.c_str(), "bytes %llu-%llu/%llu", &offset, &last, &size) == 3) &&
+		(last + 1 - offset == request.body.size());
+}
+
+static std::string fileName(const TestHttpRequest& request)
+{
+	return request.path.substr(request.path.rfind('/') + 1);
+}
+
+static std::string hexCrc(const std::string& data)
+{
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%lx", (unsigned long)crc32(0L, (const Bytef*)data.data(), (uInt)data.size()));
+	return buf;
+}
+
+int main()
+{
+	testResetLogDir();
+
+	curl_global_init(CURL_GLOBAL_ALL);
+
+	// Each rotated SIP log file is a bit bigger than a chunk (stored, so its zip file is too)
+	BlabbleLogging::setLogDimension(1);
+	BlabbleLogging::setLogNumber(10);
+	BlabbleLogging::setLogCompression(BlabbleLogging::compressionStore, 1);
+
+	BlabbleLogging::init(false);
+
+	writeLines(30000);
+
+	std::string error;
+
+	/*
+	 * First upload: the second chunk of the first file fails
+	 */
+
+	TestHttpServer server([](const TestHttpRequest& request) {
+		return (request.header("content-range").compare(0, 8, "bytes 0-") == 0 || request.header("content-range").empty()) ? 200 : 500;
+	});
+
+	TEST_CHECK(!testUpload(BlabbleLogging::logSenderIncremental, server.url("/up"), error));
+	TEST_CHECK(error == "HTTP 500");
+
+	std::map<std::string, std::string> received;	// Data received for each file (the chunks in order)
+	std::string interrupted;
+
+	std::vector<TestHttpRequest> requests = server.take();
+	TEST_CHECK(requests.size() == 2);
+
+	if (requests.size() == 2)
+	{
+		unsigned long long offset = 0, size = 0;
+
+		TEST_CHECK(fileName(requests[0]) == fileName(requests[1]));
+		TEST_CHECK(requestRange(requests[0], offset, size) && offset == 0 && requests[0].body.size() == chunkSize && size > chunkSize);
+		TEST_CHECK(requestRange(requests[1], offset, size) && offset == chunkSize);
+
+		interrupted = fileName(requests[0]);
+		received[interrupted] = requests[0].body;
+	}
+
+	// The manifest records the chunk uploaded
+	const std::string manifest = testReadFile(testLogDir() + "/npPlugin_upload.manifest");
+	TEST_CHECK(!interrupted.empty() && manifest.find("\t" + interrupted + "\t") != std::string::npos);
+	TEST_CHECK(manifest.find("\t" + std::to_string(chunkSize) + "\n") != std::string::npos);
+
+	/*
+	 * Second upload: the rest of the interrupted file, then the other files and the manifest
+	 */
+
+	server.setHandler(TestHttpServer::Handler());
+
+	TEST_CHECK(testUpload(BlabbleLogging::logSenderIncremental, server.url("/up"), error));
+
+	requests = server.take();
+	TEST_CHECK(!requests.empty() && requests.back().path == "/up/manifest");
+
+	std::set<std::string> sent;
+
+	for (std::size_t i = 0; i + 1 < requests.size(); ++i)
+	{
+		const TestHttpRequest& request = requests[i];
+		const std::string name = fileName(request);
+
+		unsigned long long offset = 0, size = 0;
+		TEST_CHECK(request.method == "PUT");
+		TEST_CHECK(requestRange(request, offset, size));
+
+		// Each file is sent from where its previous upload stopped, in order
+		TEST_CHECK(offset == received[name].size());
+		if (name == interrupted)
+			TEST_CHECK(offset == chunkSize);
+
+		received[name] += request.body;
+
+		if (received[name].size() == size)
+		{
+			// The whole file has been received
+			TEST_CHECK(request.header("x-log-crc32") == hexCrc(received[name]));
+			sent.insert(name);
+		}
+	}
+
+	TEST_CHECK(!interrupted.empty() && sent.count(interrupted) == 1);
+
+	// Every file is received as it is on disk, and listed by the manifest
+	if (!requests.empty())
+	{
+		const std::string& list = requests.back().body;
+
+		for (std::map<std::string, std::string>::const_iterator it = received.begin(); it != received.end(); ++it)
+		{
+			TEST_CHECK(sent.count(it->first) == 1);
+			TEST_CHECK(testReadFile(testLogDir() + "/" + it->first) == it->second);
+
+			std::vector<TestZipEntry> entries;
+			TEST_CHECK(readTestZip(it->second, entries, error) && entries.size() == 1);
+
+			const std::string line = it->first + "\t" + std::to_string(it->second.size()) + "\t" + hexCrc(it->second) + "\n";
+			TEST_CHECK(list.find(line) != std::string::npos);
+		}
+
+		TEST_CHECK(requests.back().header("x-log-crc32") == hexCrc(list));
+	}
+
+	// The 3 SIP log files (2 rotated by size, 1 by the first upload) and the AD ones rotated by the uploads
+	TEST_CHECK(testListLogs("PluginSIP_", ".zip").size() == 3);
+	TEST_CHECK(testListLogs("AgentDesktop_", ".zip").size() == 2);
+
+	/*
+	 * Third upload: only the AD log file rotated by it is new
+	 */
+
+	TEST_CHECK(testUpload(BlabbleLogging::logSenderIncremental, server.url("/up"), error));
+
+	requests = server.take();
+	TEST_CHECK(requests.size() == 2);
+
+	for (std::size_t i = 0; i < requests.size(); ++i)
+		TEST_CHECK(received.count(fileName(requests[i])) == 0);
+
+	TEST_CHECK(!requests.empty() && requests.back().path == "/up/manifest");
+	TEST_CHECK(requests.size() == 2 && fileName(requests[0]).compare(0, 13, "AgentDesktop_") == 0);
+
+	BlabbleLogging::deinit();
+
+	curl_global_cleanup();
+
+	if (testFailures > 0)
+	{
+		std::cerr << testFailures << " checks failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "LogResumeTest passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,78 @@
+/**
+*	REITEK: System calls (and time) needed to write a line into the SIP log file
+*
+*	The original writeLogSIPInternal checked the size of the log file (opening it), created the log
+*	folder, then opened, wrote and closed the file for each line; now the size is counted in memory
+*	and the file stays open (and with the LogHandler thread, lines are written in batches).
+*
+*	Usage: LogRotationBench [lines] [folder]
+*	(!!! NOTE: As in the plugin, logging starts within $HOME/Reitek/Contact/BrowserPlugin, then moves to folder)
+*/
+
+#include "BlabbleLogging.h"
+#include "BaselineLogging.h"
+#include "BenchCommon.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static std::string folder;
+
+/**
+*	The lines differ from each other, else they would be collapsed by the repeated lines filter
+*/
+static const char* line(int i)
+{
+	static char buf[128];
+	snprintf(buf, sizeof(buf), "PJSIP log line %08d ...............................................................", i);
+	return buf;
+}
+
+static void runBaseline(int lines)
+{
+	const std::string logdir = folder + "/baseline";
+	boost::filesystem::create_directories(logdir);
+
+	for (int i = 0; i < lines; ++i)
+		BaselineLogging::writeLogSIP(logdir, logdir + "/PluginSIP.log", 10, line(i));
+}
+
+static void runCurrent(int lines, bool async)
+{
+	BlabbleLogging::init(async);
+	BlabbleLogging::setLogPath(folder + (async ? "/async" : "/sync"));
+
+	for (int i = 0; i < lines; ++i)
+		BlabbleLogging::blabbleLog(BlabbleLogging::levelInfo, line(i), 0);
+
+	// Everything is written (and closed) by deinit
+	BlabbleLogging::deinit();
+}
+
+static void report(const char* name, const std::function<void(int)>& run, int lines)
+{
+	boost::filesystem::remove_all(folder);
+	const double syscalls = benchSyscallsPerUnit(run, lines);
+
+	boost::filesystem::remove_all(folder);
+	const double ns = benchTime([&run, lines] { run(lines); }) / lines;
+
+	printf("%-32s %10.2f syscalls/line %10.0f ns/line\n", name, syscalls, ns);
+}
+
+int main(int argc, char* argv[])
+{
+	const int lines = (argc > 1) ? atoi(argv[1]) : 20000;
+	folder = (argc > 2) ? argv[2] : "LogRotationBench.data";
+
+	printf("%d lines of %d bytes\n", lines, (int)strlen(line(0)));
+
+	report("baseline (stat/mkdir per line)", runBaseline, lines);
+	report("current, synchronous", [](int n) { runCurrent(n, false); }, lines);
+	report("current, LogHandler thread", [](int n) { runCurrent(n, true); }, lines);
+
+	boost::filesystem::remove_all(folder);
+
+	return 0;
+}
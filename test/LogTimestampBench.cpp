@@ -0,0 +1,79 @@
+/**
+*	REITEK: Formatting of the timestamps of the log lines, and of the dates of the rotated log files
+*
+*	The original code built a boost time_facet, a locale and an ostringstream for each timestamp;
+*	LogTimestamp caches the date and time up to the seconds, and writes into the caller's buffer.
+*
+*	Usage: LogTimestampBench [iterations]
+*/
+
+// LogTimestamp and the formatting functions are internal to the logging
+#include "BlabbleLogging.cpp"
+
+#include "BaselineLogging.h"
+#include "BenchCommon.h"
+
+#include <cstdlib>
+
+static std::size_t sink = 0;
+
+static void report(const char* name, const std::function<void()>& run, int iterations)
+{
+	const double ns = benchTime([&run, iterations] {
+		for (int i = 0; i < iterations; ++i)
+			run();
+	});
+
+	printf("%-40s %10.1f ns/op\n", name, ns / iterations);
+}
+
+int main(int argc, char* argv[])
+{
+	const int iterations = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+	// Same format (retry if the second changed meanwhile)
+	for (int retry = 0; retry < 3; ++retry)
+	{
+		char buf[BlabbleLogging::LogTimestamp::length];
+		BlabbleLogging::LogTimestamp timestamp;
+
+		const std::string baseline = BaselineLogging::createDateTime();
+		timestamp.format(buf);
+		const std::string current(buf, sizeof(buf));
+
+		if (baseline.compare(0, 22, current, 0, 22) == 0)
+		{
+			printf("baseline %s, current %s\n", baseline.c_str(), current.c_str());
+			break;
+		}
+	}
+
+	const char* data = "PJSIP log line ...............................................................";
+	const std::size_t len = strlen(data);
+
+	report("baseline createDateTime", [] { sink += BaselineLogging::createDateTime().size(); }, iterations);
+
+	BlabbleLogging::LogTimestamp timestamp;
+	report("LogTimestamp::format", [&timestamp] {
+		char buf[BlabbleLogging::LogTimestamp::length];
+		timestamp.format(buf);
+		sink += (std::size_t)buf[BlabbleLogging::LogTimestamp::length - 1];
+	}, iterations);
+
+	report("baseline line (createDateTime + data)", [data] {
+		const std::string str = BaselineLogging::createDateTime() + " " + boost::lexical_cast<std::string>(data);
+		sink += str.size();
+	}, iterations);
+
+	std::string batch;
+	report("formatLogSIP (into a reused batch)", [&batch, data, len] {
+		batch.clear();
+		BlabbleLogging::formatLogSIP(batch, data, len);
+		sink += batch.size();
+	}, iterations);
+
+	report("baseline createDateLog", [] { sink += BaselineLogging::createDateLog("/PluginSIP_").size(); }, iterations / 10);
+	report("createDateLog", [] { sink += BlabbleLogging::createDateLog("/PluginSIP_").size(); }, iterations / 10);
+
+	return (sink == 0) ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+/**
+*	REITEK: The upload archive of logSender past the limits of the zip fields (ZIP64 records)
+*
+*	A (sparse) 4 GB file between two small ones: the archive is streamed as sendZip does, keeping
+*	just its start and its end, whose headers must point to each other through the ZIP64 records.
+*/
+
+// LogArchiveStream is internal to the logging
+#include "BlabbleLogging.cpp"
+
+#include "TestCommon.h"
+#include "TestZipReader.h"
+
+using TestZip::get16;
+using TestZip::get32;
+
+static const boost::uintmax_t bigSize = 0x100000000ULL;
+
+/**
+*	Bytes kept from the start and from the end of the archive
+*/
+static const std::size_t keptSize = 1024 * 1024;
+
+static unsigned long long get64(const std::string& zip, std::size_t pos)
+{
+	return (unsigned long long)get32(zip, pos) | ((unsigned long long)get32(zip, pos + 4) << 32);
+}
+
+static void writeFile(const std::string& path, const std::string& data)
+{
+	std::ofstream out(path.c_str(), std::ios::binary);
+	out << data;
+}
+
+/**
+*	CRC-32 of size zero bytes
+*/
+static unsigned long zeroCrc32(boost::uintmax_t size)
+{
+	const std::vector<unsigned char> zeros(1024 * 1024, 0);
+	const unsigned long block = crc32(0L, &zeros[0], (uInt)zeros.size());
+
+	unsigned long crc = 0;
+	for (; size >= zeros.size(); size -= zeros.size())
+		crc = crc32_combine(crc, block, (z_off_t)zeros.size());
+
+	return crc32(crc, &zeros[0], (uInt)size);
+}
+
+int main()
+{
+	testResetLogDir();
+
+	const std::string dir = testLogDir();
+	const std::string small = "first small log file";
+	const std::string last = "last small log file";
+
+	writeFile(dir + "/a.log", small);
+	writeFile(dir + "/c.log", last);
+
+	{
+		std::ofstream out((dir + "/big.log").c_str(), std::ios::binary);
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::resize_file(dir + "/big.log", bigSize, ec);
+	if (ec)
+	{
+		std::cerr << "cannot create the big file: " << ec.message() << std::endl;
+		return 1;
+	}
+
+	boost::uintmax_t total = 0;
+	std::string head;
+	std::string tail;
+
+	{
+		BlabbleLogging::LogArchiveStream archive;
+
+		TEST_CHECK(archive.add(dir + "/a.log", "a.log"));
+		TEST_CHECK(archive.add(dir + "/big.log", "big.log"));
+		TEST_CHECK(archive.add(dir + "/c.log", "c.log"));
+
+		std::vector<char> buffer(1024 * 1024);
+		std::size_t n;
+
+		while ((n = archive.read(&buffer[0], buffer.size())) > 0)
+		{
+			if (head.size() < keptSize)
+				head.append(&buffer[0], std::min(n, keptSize - head.size()));
+
+			tail.append(&buffer[0], n);
+			if (tail.size() > 2 * keptSize)
+				tail.erase(0, tail.size() - keptSize);
+
+			total += n;
+		}
+
+		TEST_CHECK(!archive.failed());
+		TEST_CHECK(total == archive.size());
+	}
+
+	boost::filesystem::remove(dir + "/big.log", ec);
+
+	// Position of the archive offset pos in tail
+	const boost::uintmax_t tailStart = total - tail.size();
+
+	// End record: every field at its maximum but the entries (only 3)
+	const std::size_t end = tail.size() - 22;
+	TEST_CHECK(get32(tail, end) == 0x06054b50);
+	TEST_CHECK(get16(tail, end + 10) == 3);
+	TEST_CHECK(get32(tail, end + 16) == 0xFFFFFFFF);
+
+	// ZIP64 locator, then the ZIP64 end record it points to
+	const std::size_t locator = end - 20;
+	TEST_CHECK(get32(tail, locator) == 0x07064b50);
+	TEST_CHECK(get64(tail, locator + 8) == total - 22 - 20 - 56);
+
+	const std::size_t end64 = locator - 56;
+	TEST_CHECK(get32(tail, end64) == 0x06064b50);
+	TEST_CHECK(get64(tail, end64 + 4) == 44);
+	TEST_CHECK(get64(tail, end64 + 32) == 3);
+
+	const unsigned long long centralSize = get64(tail, end64 + 40);
+	const unsigned long long centralOffset = get64(tail, end64 + 48);
+	TEST_CHECK(centralOffset + centralSize == tailStart + end64);
+	TEST_CHECK(centralOffset > bigSize);
+
+	// Central directory: only the big entry has sizes in its extra field, only the last one its offset
+	std::size_t central = (std::size_t)(centralOffset - tailStart);
+	const char* names[] = { "a.log", "big.log", "c.log" };
+	unsigned long long offsets[3] = { 0, 0, 0 };
+	unsigned long crcs[3] = { 0, 0, 0 };
+
+	for (int i = 0; i < 3; ++i)
+	{
+		TEST_CHECK(get32(tail, central) == 0x02014b50);
+
+		const std::size_t nameSize = get16(tail, central + 28);
+		const std::size_t extraSize = get16(tail, central + 30);
+		const std::size_t extra = central + 46 + nameSize;
+
+		TEST_CHECK(tail.compare(central + 46, nameSize, names[i]) == 0);
+		crcs[i] = get32(tail, central + 16);
+		offsets[i] = get32(tail, central + 42);
+
+		if (i == 1)
+		{
+			TEST_CHECK(get32(tail, central + 20) == 0xFFFFFFFF);
+			TEST_CHECK(extraSize == 20);
+			TEST_CHECK((get16(tail, extra) == 1) && (get16(tail, extra + 2) == 16));
+			TEST_CHECK(get64(tail, extra + 4) == bigSize);
+			TEST_CHECK(get64(tail, extra + 12) == bigSize);
+		}
+		else if (i == 2)
+		{
+			TEST_CHECK(offsets[i] == 0xFFFFFFFF);
+			TEST_CHECK(extraSize == 12);
+			TEST_CHECK((get16(tail, extra) == 1) && (get16(tail, extra + 2) == 8));
+			offsets[i] = get64(tail, extra + 4);
+		}
+		else
+			TEST_CHECK(extraSize == 0);
+
+		central = extra + extraSize;
+	}
+
+	TEST_CHECK(central == end64);
+
+	// The first entry, as usual
+	TEST_CHECK(offsets[0] == 0);
+	TEST_CHECK(get32(head, 0) == 0x04034b50);
+	TEST_CHECK(get16(head, 28) == 0);
+	TEST_CHECK(head.compare(30 + 5, small.size(), small) == 0);
+	TEST_CHECK(crcs[0] == crc32(0L, (const Bytef*)small.data(), (uInt)small.size()));
+
+	// The big entry: its local header has both sizes too
+	const std::size_t big = (std::size_t)offsets[1];
+	TEST_CHECK(big == 30 + 5 + small.size());
+	TEST_CHECK(get32(head, big) == 0x04034b50);
+	TEST_CHECK(get16(head, big + 4) == 45);
+	TEST_CHECK(get32(head, big + 18) == 0xFFFFFFFF);
+	TEST_CHECK(get16(head, big + 28) == 20);
+	TEST_CHECK(get64(head, big + 30 + 7 + 4) == bigSize);
+	TEST_CHECK(crcs[1] == zeroCrc32(bigSize));
+
+	// The last entry, past 4 GB
+	TEST_CHECK(offsets[2] == big + 30 + 7 + 20 + bigSize);
+	const std::size_t local = (std::size_t)(offsets[2] - tailStart);
+	TEST_CHECK(get32(tail, local) == 0x04034b50);
+	TEST_CHECK(get16(tail, local + 28) == 0);
+	TEST_CHECK(tail.compare(local + 30 + 5, last.size(), last) == 0);
+	TEST_CHECK(local + 30 + 5 + last.size() == centralOffset - tailStart);
+	TEST_CHECK(crcs[2] == crc32(0L, (const Bytef*)last.data(), (uInt)last.size()));
+
+	if (testFailures > 0)
+	{
+		std::cerr << testFailures << " checks failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "OK" << std::endl;
+	return 0;
+}
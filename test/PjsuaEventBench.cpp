@@ -0,0 +1,237 @@
+/**
+*	REITEK: Latency of the PJSIP events with the threading models of the plugin (see the sipthreads and
+*	sippollbudget params in PjsuaManager)
+*
+*	For each model it measures how late the timers fire, the round trip of an OPTIONS request sent to
+*	the own UDP transport (answered by PJSUA), and the CPU time used while idle.
+*
+*	Usage: PjsuaEventBench [samples]
+*	(!!! NOTE: Only built when PJSIP is found by pkg-config, see CMakeLists.txt)
+*/
+
+#include <pjsua-lib/pjsua.h>
+
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+
+#define BENCH_TIMER_DELAY_MSEC		5
+#define BENCH_IDLE_MSEC				1000
+
+/**
+*	The completion of an event, signaled by the thread handling it
+*/
+class BenchEvent
+{
+public:
+	void reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		done_ = false;
+	}
+
+	void signal()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			done_ = true;
+			time_ = std::chrono::steady_clock::now();
+		}
+
+		condvar_.notify_all();
+	}
+
+	/**
+	*	The time of the signal (false if it was not signaled within 5 s)
+	*/
+	bool wait(std::chrono::steady_clock::time_point& time)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (!condvar_.wait_for(lock, std::chrono::seconds(5), [this] { return done_; }))
+			return false;
+
+		time = time_;
+		return true;
+	}
+
+private:
+	std::mutex mutex_;
+	std::condition_variable condvar_;
+	bool done_ = false;
+	std::chrono::steady_clock::time_point time_;
+};
+
+static BenchEvent event;
+
+static void onTimer(void* /* user_data */)
+{
+	event.signal();
+}
+
+static void onOptionsResponse(void* /* token */, pjsip_event* /* e */)
+{
+	event.signal();
+}
+
+static double processCpuTime()
+{
+	timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static double elapsedUsec(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+	return (double)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+static void printSamples(const char* name, std::vector<double>& samples)
+{
+	if (samples.empty())
+	{
+		printf("    %-18s no samples\n", name);
+		return;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	printf("    %-18s median %8.0f us  p99 %8.0f us  max %8.0f us\n", name,
+		samples[samples.size() / 2], samples[(samples.size() * 99) / 100], samples.back());
+}
+
+/**
+*	Run the measures with sipthreads worker threads, or (with 0) with a thread polling at most budget ms at a time
+*/
+static bool run(unsigned int sipthreads, unsigned int budget, int samples)
+{
+	if (sipthreads > 0)
+		printf("sipthreads %u\n", sipthreads);
+	else
+		printf("sipthreads 0, sippollbudget %u ms\n", budget);
+
+	if (pjsua_create() != PJ_SUCCESS)
+		return false;
+
+	pjsua_config cfg;
+	pjsua_logging_config log_cfg;
+	pjsua_media_config media_cfg;
+
+	pjsua_config_default(&cfg);
+	pjsua_logging_config_default(&log_cfg);
+	pjsua_media_config_default(&media_cfg);
+
+	cfg.thread_cnt = sipthreads;
+	log_cfg.console_level = 0;
+	log_cfg.level = 0;
+	media_cfg.thread_cnt = 0;
+
+	pjsua_transport_config transport_cfg;
+	pjsua_transport_config_default(&transport_cfg);
+	transport_cfg.bound_addr = pj_str((char*)"127.0.0.1");
+	transport_cfg.port = 0;
+
+	pjsua_transport_id transport_id = PJSUA_INVALID_ID;
+	pjsua_transport_info transport_info;
+
+	if ((pjsua_init(&cfg, &log_cfg, &media_cfg) != PJ_SUCCESS) ||
+		(pjsua_set_null_snd_dev() != PJ_SUCCESS) ||
+		(pjsua_transport_create(PJSIP_TRANSPORT_UDP, &transport_cfg, &transport_id) != PJ_SUCCESS) ||
+		(pjsua_transport_get_info(transport_id, &transport_info) != PJ_SUCCESS) ||
+		(pjsua_start() != PJ_SUCCESS))
+	{
+		pjsua_destroy();
+		return false;
+	}
+
+	// As PjsuaManager::PollSipEvents
+	std::atomic_bool stop(false);
+	std::thread poller;
+
+	if (sipthreads == 0)
+	{
+		poller = std::thread([&stop, budget] {
+			pj_thread_desc desc;
+			pj_thread_t *thread = NULL;
+
+			pj_bzero(desc, sizeof(desc));
+			pj_thread_register("bench_poll", desc, &thread);
+
+			while (!stop.load(std::memory_order_relaxed))
+				pjsua_handle_events(budget);
+		});
+	}
+
+	std::vector<double> timers;
+	std::vector<double> options;
+
+	char target[64];
+	snprintf(target, sizeof(target), "sip:127.0.0.1:%d", (int)transport_info.local_name.port);
+	pj_str_t target_uri = pj_str(target);
+
+	for (int i = 0; i < samples; ++i)
+	{
+		std::chrono::steady_clock::time_point fired;
+
+		// How late (after BENCH_TIMER_DELAY_MSEC) a timer fires
+		event.reset();
+		const std::chrono::steady_clock::time_point scheduled = std::chrono::steady_clock::now();
+
+		if ((pjsua_schedule_timer2(&onTimer, NULL, BENCH_TIMER_DELAY_MSEC) == PJ_SUCCESS) && event.wait(fired))
+			timers.push_back(elapsedUsec(scheduled, fired) - BENCH_TIMER_DELAY_MSEC * 1000);
+
+		// Round trip of an OPTIONS request to the own transport
+		pjsip_tx_data* tdata = NULL;
+
+		if (pjsip_endpt_create_request(pjsua_get_pjsip_endpt(), &pjsip_options_method, &target_uri, &target_uri, &target_uri,
+			NULL, NULL, -1, NULL, &tdata) != PJ_SUCCESS)
+			continue;
+
+		event.reset();
+		const std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+
+		if ((pjsip_endpt_send_request(pjsua_get_pjsip_endpt(), tdata, -1, NULL, &onOptionsResponse) == PJ_SUCCESS) &&
+			event.wait(fired))
+			options.push_back(elapsedUsec(sent, fired));
+	}
+
+	printSamples("timer lateness", timers);
+	printSamples("OPTIONS round trip", options);
+
+	// CPU time used with no events to handle
+	const double cpu = processCpuTime();
+	std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_IDLE_MSEC));
+	printf("    %-18s %8.2f ms CPU per s\n", "idle", (processCpuTime() - cpu) * 1000 / BENCH_IDLE_MSEC);
+
+	stop = true;
+	if (poller.joinable())
+		poller.join();
+
+	pjsua_destroy();
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	const int samples = (argc > 1) ? atoi(argv[1]) : 200;
+
+	printf("%d samples for each model, %u hardware threads\n", samples, std::thread::hardware_concurrency());
+
+	bool ok = true;
+
+	// PJSUA default (1 worker thread), then more workers, then the plugin polling with different budgets
+	ok = run(1, 0, samples) && ok;
+	ok = run(2, 0, samples) && ok;
+	ok = run(0, 1, samples) && ok;
+	ok = run(0, 10, samples) && ok;
+	ok = run(0, 100, samples) && ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+/**
+*	REITEK: Helpers shared by the logging tests (each test is a single source file)
+*/
+
+#ifndef H_TestCommon
+#define H_TestCommon
+
+#include "BlabbleLogging.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <future>
+#include <chrono>
+#include <cstdlib>
+
+#include "boost/filesystem.hpp"
+
+static int testFailures = 0;
+
+#define TEST_CHECK(cond)																	\
+	do {																					\
+		if (!(cond)) {																		\
+			std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+			++testFailures;																	\
+		}																					\
+	} while(0)
+
+/**
+*	Default log folder of the plugin (the tests run with their own HOME)
+*/
+inline std::string testLogDir()
+{
+	const char* home = getenv("HOME");
+	return std::string(home ? home : ".") + "/Reitek/Contact/BrowserPlugin";
+}
+
+/**
+*	Start from an empty log folder
+*/
+inline void testResetLogDir()
+{
+	boost::system::error_code ec;
+	boost::filesystem::remove_all(testLogDir(), ec);
+	boost::filesystem::create_directories(testLogDir(), ec);
+}
+
+inline std::string testReadFile(const std::string& path)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	std::ostringstream content;
+	content << in.rdbuf();
+	return content.str();
+}
+
+/**
+*	Files of the log folder whose name starts with prefix and ends with suffix
+*/
+inline std::vector<std::string> testListLogs(const std::string& prefix, const std::string& suffix)
+{
+	std::vector<std::string> names;
+
+	boost::system::error_code ec;
+	for (boost::filesystem::directory_iterator it(testLogDir(), ec), end; !ec && (it != end); it.increment(ec))
+	{
+		const std::string name = it->path().filename().string();
+		if ((name.compare(0, prefix.size(), prefix) == 0) && (name.size() >= suffix.size()) &&
+			(name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0))
+			names.push_back(name);
+	}
+
+	return names;
+}
+
+/**
+*	Run an upload (logSender or logSenderIncremental) and wait for its onComplete: false if it failed
+*/
+inline bool testUpload(bool (*send)(const std::string&, const BlabbleLogging::LogSenderCallbacks&), const std::string& url, std::string& error)
+{
+	std::promise<std::pair<bool, std::string> > result;
+
+	BlabbleLogging::LogSenderCallbacks callbacks;
+	callbacks.onComplete = [&result](bool success, const std::string& why) {
+		result.set_value(std::make_pair(success, why));
+	};
+
+	if (!send(url, callbacks))
+	{
+		error = "upload not started";
+		return false;
+	}
+
+	std::future<std::pair<bool, std::string> > done = result.get_future();
+	if (done.wait_for(std::chrono::seconds(60)) != std::future_status::ready)
+	{
+		// The upload thread still references result: it can't be left behind
+		std::cerr << "upload did not complete" << std::endl;
+		std::abort();
+	}
+
+	const std::pair<bool, std::string> outcome = done.get();
+	error = outcome.second;
+	return outcome.first;
+}
+
+#endif // H_TestCommon
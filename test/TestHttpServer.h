@@ -0,0 +1,222 @@
+/**
+*	REITEK: Loopback HTTP server receiving the log uploads of the tests
+*
+*	Each connection carries a single request (the response closes it); the handler
+*	chooses the status of the response, every request is recorded.
+*/
+
+#ifndef H_TestHttpServer
+#define H_TestHttpServer
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+struct TestHttpRequest
+{
+	std::string method;
+	std::string path;
+	std::map<std::string, std::string> headers;	// Lowercase names
+	std::string body;
+
+	std::string header(const std::string& name) const
+	{
+		std::map<std::string, std::string>::const_iterator it = headers.find(name);
+		return (it != headers.end()) ? it->second : std::string();
+	}
+};
+
+class TestHttpServer
+{
+public:
+	typedef std::function<int(const TestHttpRequest&)> Handler;
+
+	explicit TestHttpServer(const Handler& handler = Handler())
+		: handler_(handler), stop_(false)
+	{
+		socket_ = ::socket(AF_INET, SOCK_STREAM, 0);
+		if (socket_ < 0)
+			throw std::runtime_error("socket failed");
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+
+		socklen_t len = sizeof(addr);
+		if ((::bind(socket_, (sockaddr*)&addr, sizeof(addr)) != 0) ||
+			(::listen(socket_, 16) != 0) ||
+			(::getsockname(socket_, (sockaddr*)&addr, &len) != 0))
+		{
+			::close(socket_);
+			throw std::runtime_error("bind/listen failed");
+		}
+
+		port_ = ntohs(addr.sin_port);
+
+		thread_ = std::thread(&TestHttpServer::run, this);
+	}
+
+	~TestHttpServer()
+	{
+		stop_.store(true);
+		thread_.join();
+		::close(socket_);
+	}
+
+	std::string url(const std::string& path) const
+	{
+		return "http://127.0.0.1:" + std::to_string(port_) + path;
+	}
+
+	void setHandler(const Handler& handler)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		handler_ = handler;
+	}
+
+	/**
+	*	The requests received so far (and forget them)
+	*/
+	std::vector<TestHttpRequest> take()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		std::vector<TestHttpRequest> requests;
+		requests.swap(requests_);
+		return requests;
+	}
+
+private:
+	void run()
+	{
+		while (!stop_.load())
+		{
+			pollfd pfd = { socket_, POLLIN, 0 };
+			if (::poll(&pfd, 1, 50) <= 0)
+				continue;
+
+			const int conn = ::accept(socket_, NULL, NULL);
+			if (conn < 0)
+				continue;
+
+			serve(conn);
+			::close(conn);
+		}
+	}
+
+	void serve(int conn)
+	{
+		std::string data;
+		std::size_t end;
+
+		while ((end = data.find("\r\n\r\n")) == std::string::npos)
+		{
+			if (!receive(conn, data))
+				return;
+		}
+
+		TestHttpRequest request;
+		parseHead(data.substr(0, end), request);
+		data.erase(0, end + 4);
+
+		if (request.header("expect") == "100-continue")
+			sendAll(conn, "HTTP/1.1 100 Continue\r\n\r\n");
+
+		const std::size_t length = (std::size_t)strtoull(request.header("content-length").c_str(), NULL, 10);
+		while (data.size() < length)
+		{
+			if (!receive(conn, data))
+				break;
+		}
+		request.body = data.substr(0, length);
+
+		int status;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			status = handler_ ? handler_(request) : 200;
+			requests_.push_back(request);
+		}
+
+		sendAll(conn, "HTTP/1.1 " + std::to_string(status) + " Test\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+	}
+
+	static bool receive(int conn, std::string& data)
+	{
+		char buffer[64 * 1024];
+		const ssize_t n = ::recv(conn, buffer, sizeof(buffer), 0);
+		if (n <= 0)
+			return false;
+
+		data.append(buffer, (std::size_t)n);
+		return true;
+	}
+
+	static void sendAll(int conn, const std::string& data)
+	{
+		std::size_t sent = 0;
+		while (sent < data.size())
+		{
+			const ssize_t n = ::send(conn, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+			if (n <= 0)
+				return;
+			sent += (std::size_t)n;
+		}
+	}
+
+	static void parseHead(const std::string& head, TestHttpRequest& request)
+	{
+		std::size_t pos = head.find("\r\n");
+		const std::string line = head.substr(0, pos);
+
+		const std::size_t space = line.find(' ');
+		request.method = line.substr(0, space);
+		request.path = line.substr(space + 1, line.find(' ', space + 1) - space - 1);
+
+		while (pos != std::string::npos)
+		{
+			const std::size_t next = head.find("\r\n", pos + 2);
+			const std::string header = head.substr(pos + 2, (next == std::string::npos) ? std::string::npos : next - pos - 2);
+			pos = next;
+
+			const std::size_t colon = header.find(':');
+			if (colon == std::string::npos)
+				continue;
+
+			std::string name = header.substr(0, colon);
+			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+			std::size_t value = colon + 1;
+			while ((value < header.size()) && (header[value] == ' '))
+				++value;
+
+			request.headers[name] = header.substr(value);
+		}
+	}
+
+	Handler handler_;
+	int socket_;
+	unsigned short port_;
+	std::atomic_bool stop_;
+	std::thread thread_;
+	std::mutex mutex_;
+	std::vector<TestHttpRequest> requests_;
+};
+
+#endif // H_TestHttpServer
@@ -0,0 +1,140 @@
+/**
+*	REITEK: BlabbleLogging::zipLogFile for the tests (BlabbleLogZip.cpp needs ZipLib)
+*
+*	The log file is deflated with zlib if the codec is deflate, else stored uncompressed (bzip2
+*	included), into a zip file with the same layout ZipLib writes: the tests only look at what
+*	BlabbleLogging does with it, the benchmarks need the CPU time a codec takes
+*/
+
+#include "BlabbleLogging.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <zlib.h>
+
+namespace {
+
+	void put16(std::string& out, unsigned int value)
+	{
+		out += (char)(value & 0xFF);
+		out += (char)((value >> 8) & 0xFF);
+	}
+
+	void put32(std::string& out, unsigned long value)
+	{
+		put16(out, (unsigned int)(value & 0xFFFF));
+		put16(out, (unsigned int)((value >> 16) & 0xFFFF));
+	}
+
+	/**
+	*	Raw deflate, as stored within the zip entries
+	*/
+	bool deflateRaw(const std::string& in, int level, std::string& out)
+	{
+		z_stream stream = z_stream();
+		if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			return false;
+
+		out.resize(deflateBound(&stream, (uLong)in.size()));
+
+		stream.next_in = (Bytef*)in.data();
+		stream.avail_in = (uInt)in.size();
+		stream.next_out = (Bytef*)&out[0];
+		stream.avail_out = (uInt)out.size();
+
+		const int result = deflate(&stream, Z_FINISH);
+		out.resize(stream.total_out);
+		deflateEnd(&stream);
+
+		return result == Z_STREAM_END;
+	}
+}
+
+bool BlabbleLogging::zipLogFile(const std::string& zipPath, const std::string& logPath, const std::string& name,
+	LogCompression compression, int level, std::string& error)
+{
+	std::ifstream in(logPath.c_str(), std::ios::binary);
+	if (!in)
+	{
+		error = "cannot open " + logPath;
+		return false;
+	}
+
+	std::ostringstream content;
+	content << in.rdbuf();
+	const std::string data = content.str();
+
+	const unsigned long crc = crc32(0L, (const Bytef*)data.data(), (uInt)data.size());
+
+	const unsigned int method = (compression == compressionDeflate) ? 8 : 0;
+
+	std::string deflated;
+	if ((method == 8) && !deflateRaw(data, level, deflated))
+	{
+		error = "cannot deflate " + logPath;
+		return false;
+	}
+
+	const std::string& stored = (method == 8) ? deflated : data;
+
+	std::string zip;
+
+	// Local header
+	put32(zip, 0x04034b50);
+	put16(zip, (method == 8) ? 20 : 10);
+	put16(zip, 0);
+	put16(zip, method);
+	put16(zip, 0);
+	put16(zip, 0x21);
+	put32(zip, crc);
+	put32(zip, (unsigned long)stored.size());
+	put32(zip, (unsigned long)data.size());
+	put16(zip, (unsigned int)name.size());
+	put16(zip, 0);
+	zip += name;
+	zip += stored;
+
+	const std::size_t centralOffset = zip.size();
+
+	// Central directory header
+	put32(zip, 0x02014b50);
+	put16(zip, 10);
+	put16(zip, (method == 8) ? 20 : 10);
+	put16(zip, 0);
+	put16(zip, method);
+	put16(zip, 0);
+	put16(zip, 0x21);
+	put32(zip, crc);
+	put32(zip, (unsigned long)stored.size());
+	put32(zip, (unsigned long)data.size());
+	put16(zip, (unsigned int)name.size());
+	put16(zip, 0);
+	put16(zip, 0);
+	put16(zip, 0);
+	put16(zip, 0);
+	put32(zip, 0);
+	put32(zip, 0);
+	zip += name;
+
+	const std::size_t centralSize = zip.size() - centralOffset;
+
+	// End of central directory
+	put32(zip, 0x06054b50);
+	put16(zip, 0);
+	put16(zip, 0);
+	put16(zip, 1);
+	put16(zip, 1);
+	put32(zip, (unsigned long)centralSize);
+	put32(zip, (unsigned long)centralOffset);
+	put16(zip, 0);
+
+	std::ofstream out(zipPath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out.write(zip.data(), zip.size()) || !out.flush())
+	{
+		error = "cannot write " + zipPath;
+		return false;
+	}
+
+	return true;
+}
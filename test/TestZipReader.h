@@ -0,0 +1,158 @@
+/**
+*	REITEK: Zip reader of the tests, checking the layout of the archives written by the logging
+*
+*	The entries must follow each other from the start of the archive, then the central directory,
+*	then the end record (no comment); the local and central headers of each entry must agree, and
+*	its data must match its CRC-32 (only stored and deflated entries are supported).
+*/
+
+#ifndef H_TestZipReader
+#define H_TestZipReader
+
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+struct TestZipEntry
+{
+	std::string name;
+	unsigned int method;
+	unsigned long crc;
+	std::string data;
+};
+
+namespace TestZip {
+
+	inline unsigned long get16(const std::string& zip, std::size_t pos)
+	{
+		return (unsigned long)(unsigned char)zip[pos] | ((unsigned long)(unsigned char)zip[pos + 1] << 8);
+	}
+
+	inline unsigned long get32(const std::string& zip, std::size_t pos)
+	{
+		return get16(zip, pos) | (get16(zip, pos + 2) << 16);
+	}
+
+	inline bool inflateRaw(const std::string& in, std::size_t size, std::string& out)
+	{
+		out.resize(size);
+
+		z_stream stream = z_stream();
+		if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+			return false;
+
+		stream.next_in = (Bytef*)in.data();
+		stream.avail_in = (uInt)in.size();
+		stream.next_out = (Bytef*)&out[0];
+		stream.avail_out = (uInt)out.size();
+
+		const int result = inflate(&stream, Z_FINISH);
+		inflateEnd(&stream);
+
+		return (result == Z_STREAM_END) && (stream.total_out == size);
+	}
+}
+
+/**
+*	Read all the entries of the archive zip: false (and why in error) if it is not well formed
+*/
+inline bool readTestZip(const std::string& zip, std::vector<TestZipEntry>& entries, std::string& error)
+{
+	using TestZip::get16;
+	using TestZip::get32;
+
+	const std::size_t endSize = 22;
+
+	entries.clear();
+
+	if ((zip.size() < endSize) || (get32(zip, zip.size() - endSize) != 0x06054b50))
+	{
+		error = "no end of central directory record at the end of the archive";
+		return false;
+	}
+
+	const std::size_t end = zip.size() - endSize;
+	const unsigned long count = get16(zip, end + 10);
+	const unsigned long centralSize = get32(zip, end + 12);
+	const unsigned long centralOffset = get32(zip, end + 16);
+
+	if ((get16(zip, end + 8) != count) || (centralOffset + centralSize != end))
+	{
+		error = "the central directory does not end where the end record starts";
+		return false;
+	}
+
+	std::size_t central = centralOffset;
+	std::size_t local = 0;
+
+	for (unsigned long i = 0; i < count; ++i)
+	{
+		if ((central + 46 > end) || (get32(zip, central) != 0x02014b50))
+		{
+			error = "bad central directory header " + std::to_string(i);
+			return false;
+		}
+
+		TestZipEntry entry;
+		entry.method = (unsigned int)get16(zip, central + 10);
+		entry.crc = get32(zip, central + 16);
+
+		const unsigned long compressedSize = get32(zip, central + 20);
+		const unsigned long size = get32(zip, central + 24);
+		const unsigned long nameSize = get16(zip, central + 28);
+		const unsigned long offset = get32(zip, central + 42);
+
+		entry.name = zip.substr(central + 46, nameSize);
+		central += 46 + nameSize + get16(zip, central + 30) + get16(zip, central + 32);
+
+		if ((offset != local) || (local + 30 > centralOffset) || (get32(zip, local) != 0x04034b50))
+		{
+			error = "entry " + entry.name + " does not follow the previous one";
+			return false;
+		}
+
+		if ((get16(zip, local + 8) != entry.method) || (get32(zip, local + 14) != entry.crc) ||
+			(get32(zip, local + 18) != compressedSize) || (get32(zip, local + 22) != size) ||
+			(zip.compare(local + 30, get16(zip, local + 26), entry.name) != 0))
+		{
+			error = "the local and central headers of " + entry.name + " differ";
+			return false;
+		}
+
+		const std::size_t data = local + 30 + get16(zip, local + 26) + get16(zip, local + 28);
+		local = data + compressedSize;
+
+		if (local > centralOffset)
+		{
+			error = "the data of " + entry.name + " overlaps the central directory";
+			return false;
+		}
+
+		if (entry.method == 0)
+			entry.data = zip.substr(data, compressedSize);
+		else if ((entry.method != 8) || !TestZip::inflateRaw(zip.substr(data, compressedSize), size, entry.data))
+		{
+			error = "cannot extract " + entry.name;
+			return false;
+		}
+
+		if ((entry.data.size() != size) || (crc32(0L, (const Bytef*)entry.data.data(), (uInt)entry.data.size()) != entry.crc))
+		{
+			error = "bad CRC-32 for " + entry.name;
+			return false;
+		}
+
+		entries.push_back(entry);
+	}
+
+	if ((local != centralOffset) || (central != end))
+	{
+		error = "unexpected data between the entries and the central directory";
+		return false;
+	}
+
+	return true;
+}
+
+#endif // H_TestZipReader